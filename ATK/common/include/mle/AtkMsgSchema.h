@@ -0,0 +1,361 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkMsgSchema.h
+ * @ingroup MleATK
+ *
+ * This file contains typed schemas for encoding and decoding the
+ * parameters of wire messages.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_MSGSCHEMA_H_
+#define __ATK_MSGSCHEMA_H_
+
+// Include system header files.
+#include <string.h>
+#include <stdio.h>
+
+// Include Magic Lantern header files.
+#include <math/transfrm.h>
+
+// Include Authoring Toolkit header files.
+#include <mle/AtkWireMsg.h>
+
+/**
+ * A block of data, laid out as AtkWireMsg::addParam(void*, int) lays it
+ * out: its length followed by its bytes. An empty block adds nothing.
+ */
+struct AtkMsgBlob
+{
+    /** The data; a view into the message when it is unpacked. */
+    const void* m_data;
+    /** The length of the data, in bytes. */
+    int m_length;
+};
+
+/**
+ * How one type of field is laid out on the wire. Each layout is the one
+ * the matching AtkWireMsg::addParam() uses, so that messages built with
+ * a schema can be read by getParam() and the other way around.
+ *
+ * FIXED_SIZE is the number of bytes the field always takes, and
+ * getVariableSize() the number it takes beyond that for a value.
+ * scan() returns the offset following the field at offset, without
+ * checking fixed size fields against the length; it returns -1 if a
+ * variable size field doesn't fit.
+ */
+template <typename T> struct AtkMsgField;
+
+template <> struct AtkMsgField<int>
+{
+    typedef int Arg;
+    enum { FIXED_SIZE = sizeof(int), IS_FIXED = 1 };
+
+    static int getVariableSize(int)
+    { return(0); }
+
+    static char* pack(char* p, int i)
+    { memcpy(p, &i, sizeof(int)); return(p + sizeof(int)); }
+
+    static int scan(const char*, int offset, int)
+    { return(offset + sizeof(int)); }
+
+    static const char* unpack(const char* p, int &i)
+    { memcpy(&i, p, sizeof(int)); return(p + sizeof(int)); }
+};
+
+template <> struct AtkMsgField<const char*>
+{
+    typedef const char* Arg;
+    enum { FIXED_SIZE = 0, IS_FIXED = 0 };
+
+    static int getVariableSize(const char* s)
+    { return(s ? strlen(s) + 1 : 1); }
+
+    static char* pack(char* p, const char* s)
+	{
+		if (!s) s = "";
+		while ((*p++ = *s++)) ;
+		return(p);
+    }
+
+    static int scan(const char* data, int offset, int len)
+	{
+		if (offset >= len) return(-1);
+		const char* end = (const char*) memchr(data + offset, 0, len - offset);
+		return(end ? (end - data) + 1 : -1);
+    }
+
+    // The string is a view into the message.
+    static const char* unpack(const char* p, const char* &s)
+    { s = p; return(p + strlen(p) + 1); }
+};
+
+template <> struct AtkMsgField<MlTransform>
+{
+    typedef const MlTransform& Arg;
+    enum { FIXED_SIZE = sizeof(MlTransform), IS_FIXED = 1 };
+
+    static int getVariableSize(const MlTransform&)
+    { return(0); }
+
+    static char* pack(char* p, const MlTransform &t)
+    { memcpy(p, &t, sizeof(MlTransform)); return(p + sizeof(MlTransform)); }
+
+    static int scan(const char*, int offset, int)
+    { return(offset + sizeof(MlTransform)); }
+
+    static const char* unpack(const char* p, MlTransform &t)
+    { memcpy(&t, p, sizeof(MlTransform)); return(p + sizeof(MlTransform)); }
+};
+
+template <> struct AtkMsgField<AtkMsgBlob>
+{
+    typedef const AtkMsgBlob& Arg;
+    enum { FIXED_SIZE = 0, IS_FIXED = 0 };
+
+    static int getVariableSize(const AtkMsgBlob &b)
+    { return((b.m_data && b.m_length) ? sizeof(int) + b.m_length : 0); }
+
+    static char* pack(char* p, const AtkMsgBlob &b)
+	{
+		if (!b.m_data || !b.m_length) return(p);
+		memcpy(p, &b.m_length, sizeof(int));
+		memcpy(p + sizeof(int), b.m_data, b.m_length);
+		return(p + sizeof(int) + b.m_length);
+    }
+
+    static int scan(const char* data, int offset, int len)
+	{
+		if (offset > len - (int) sizeof(int)) return(-1);
+		int n;
+		memcpy(&n, data + offset, sizeof(int));
+		if (n <= 0 || n > len - offset - (int) sizeof(int)) return(-1);
+		return(offset + sizeof(int) + n);
+    }
+
+    // The data is a view into the message.
+    static const char* unpack(const char* p, AtkMsgBlob &b)
+	{
+		memcpy(&b.m_length, p, sizeof(int));
+		b.m_data = p + sizeof(int);
+		return(p + sizeof(int) + b.m_length);
+    }
+};
+
+/**
+ * Encodes and decodes a sequence of fields, one field at a time.
+ */
+template <typename... Fields> struct AtkMsgCodec;
+
+template <> struct AtkMsgCodec<>
+{
+    enum { FIXED_SIZE = 0, IS_FIXED = 1 };
+
+    static int getVariableSize()
+    { return(0); }
+
+    static char* pack(char* p)
+    { return(p); }
+
+    static int scan(const char*, int offset, int)
+    { return(offset); }
+
+    static const char* unpack(const char* p)
+    { return(p); }
+};
+
+template <typename F, typename... Rest> struct AtkMsgCodec<F, Rest...>
+{
+    typedef AtkMsgField<F> Field;
+    typedef AtkMsgCodec<Rest...> Next;
+
+    enum {
+        FIXED_SIZE = Field::FIXED_SIZE + Next::FIXED_SIZE,
+        IS_FIXED = Field::IS_FIXED && Next::IS_FIXED
+    };
+
+    static int getVariableSize(typename Field::Arg v, typename AtkMsgField<Rest>::Arg... rest)
+    { return(Field::getVariableSize(v) + Next::getVariableSize(rest...)); }
+
+    static char* pack(char* p, typename Field::Arg v, typename AtkMsgField<Rest>::Arg... rest)
+    { return(Next::pack(Field::pack(p, v), rest...)); }
+
+    static int scan(const char* data, int offset, int len)
+	{
+		offset = Field::scan(data, offset, len);
+		return((offset < 0) ? -1 : Next::scan(data, offset, len));
+    }
+
+    static const char* unpack(const char* p, F &v, Rest&... rest)
+    { return(Next::unpack(Field::unpack(p, v), rest...)); }
+};
+
+/**
+ * This class is a typed schema for the parameters of one kind of
+ * message.
+ *
+ * Schemas are declared with ATK_MSG_SCHEMA, which gives the schema its
+ * message name, for example
+ *
+ *     ATK_MSG_SCHEMA(AtkSetTransformMsg, "SetTransform", const char*, MlTransform);
+ *
+ * The fields may be int, const char*, MlTransform and AtkMsgBlob, and
+ * are laid out exactly as the matching addParam() calls lay them out,
+ * so that peers which build and read messages a parameter at a time
+ * still understand them.
+ *
+ * The size of the fixed size fields is known when the schema is
+ * compiled. pack() sizes the message once and writes every field in one
+ * pass, and unpack() checks the whole message against its length before
+ * reading any field; strings and blobs are unpacked as views into the
+ * message, valid for as long as it keeps its data.
+ *
+ * @param Name A type whose static get() returns the message name.
+ * @param Fields The types of the fields, in order.
+ */
+template <typename Name, typename... Fields>
+class AtkMsgSchema
+{
+  public:
+
+    typedef AtkMsgCodec<Fields...> Codec;
+
+    /** The number of bytes the fixed size fields take. */
+    enum { FIXED_SIZE = Codec::FIXED_SIZE };
+
+    /** Whether every message of this kind has the same size. */
+    enum { IS_FIXED = Codec::IS_FIXED };
+
+    /**
+	 * Get the name of messages of this kind.
+	 */
+    static const char* getName()
+    { return(Name::get()); }
+
+    /**
+	 * Check whether a message is of this kind.
+	 *
+	 * @param msg The message to check.
+	 *
+	 * @return Non-zero is returned if the message has this schema's name.
+	 */
+    static int isA(AtkWireMsg* msg)
+    { return(!strcmp(msg->m_msgName, getName())); }
+
+    /**
+	 * Get the number of bytes the fields take for a set of values.
+	 */
+    static int getSize(typename AtkMsgField<Fields>::Arg... values)
+    { return(FIXED_SIZE + (IS_FIXED ? 0 : Codec::getVariableSize(values...))); }
+
+    /**
+	 * Append the fields to a message.
+	 *
+	 * @param msg The message to add the parameters to.
+	 * @param values The value of each field.
+	 */
+    static void pack(AtkWireMsg* msg, typename AtkMsgField<Fields>::Arg... values)
+	{
+		int len = getSize(values...);
+		Codec::pack((char*) msg->extendMsgData(len), values...);
+    }
+
+    /**
+	 * Create a message of this kind holding a set of values.
+	 *
+	 * @param destObj The object to send the message to.
+	 * @param values The value of each field.
+	 *
+	 * @return The new message is returned; the caller deletes it.
+	 */
+    static AtkWireMsg* create(void* destObj, typename AtkMsgField<Fields>::Arg... values)
+	{
+		AtkWireMsg* msg = new AtkWireMsg(destObj, getName());
+		pack(msg, values...);
+		return(msg);
+    }
+
+    /**
+	 * Make a message one of this kind holding a set of values, reusing
+	 * its payload buffer.
+	 *
+	 * @param msg The message to reset.
+	 * @param destObj The object to send the message to.
+	 * @param values The value of each field.
+	 */
+    static void reset(AtkWireMsg* msg, void* destObj, typename AtkMsgField<Fields>::Arg... values)
+	{
+		msg->reset(destObj, getName());
+		pack(msg, values...);
+    }
+
+    /**
+	 * Read the fields from the current parameter of a message on.
+	 *
+	 * @param msg The message to read the parameters from.
+	 * @param values Set to the value of each field.
+	 *
+	 * @return 0 is returned on success; -1 is returned, and none of the
+	 * values are set, if the message doesn't hold the fields.
+	 */
+    static int unpack(AtkWireMsg* msg, Fields&... values)
+	{
+		const char* data = (const char*) msg->m_msgData;
+		int len = msg->getDataLength();
+		int end = data ? Codec::scan(data, msg->m_curParamOffset, len) : -1;
+		if (end < 0 || end > len)
+		{
+			printf("WM: unpack (%s) error curParamOffset: %d  dataLength: %d\n",
+				getName(), msg->m_curParamOffset, len);
+			return(-1);
+		}
+
+		Codec::unpack(data + msg->m_curParamOffset, values...);
+		msg->m_curParamOffset = end;
+		return(0);
+    }
+};
+
+/**
+ * Declare a schema for messages named NAME whose fields have the types
+ * that follow.
+ */
+#define ATK_MSG_SCHEMA(SCHEMA, NAME, ...) \
+    struct SCHEMA##Name { static const char* get() { return NAME; } }; \
+    typedef AtkMsgSchema<SCHEMA##Name, __VA_ARGS__> SCHEMA
+
+#endif /* __ATK_MSGSCHEMA_H_ */
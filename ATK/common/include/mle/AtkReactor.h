@@ -0,0 +1,319 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkReactor.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that multiplexes wires, file descriptors and
+ * timers in a single event loop.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_REACTOR_H_
+#define __ATK_REACTOR_H_
+
+#if defined(__linux__)
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+#include <mle/AtkBasicArray.h>
+
+/** Watch a file descriptor for input. */
+#define ATK_REACTOR_READ  0x1
+/** Watch a file descriptor for room to write. */
+#define ATK_REACTOR_WRITE 0x2
+/** The file descriptor has been closed or is in error. */
+#define ATK_REACTOR_ERROR 0x4
+
+/** The default number of messages delivered per wire in one dispatch. */
+#define ATK_REACTOR_MAX_MSGS_PER_DISPATCH 64
+
+// Class declarations
+class AtkWired;
+class AtkWireMsg;
+
+/**
+ * Callback for a complete message received on a wire.
+ *
+ * The callback is invoked with a <b>NULL</b> msg when the connection
+ * is lost, after which the wire is no longer watched.
+ */
+typedef void (*AtkReactorMsgCallback)(AtkWired* wired, AtkWireMsg* msg,
+	void* clientData);
+
+/**
+ * Callback for activity on a file descriptor.
+ *
+ * <b>events</b> is a mask of ATK_REACTOR_READ, ATK_REACTOR_WRITE
+ * and ATK_REACTOR_ERROR.
+ */
+typedef void (*AtkReactorFDCallback)(int fd, int events, void* clientData);
+
+/**
+ * Callback for an expired timer.
+ */
+typedef void (*AtkReactorTimerCallback)(int timerID, void* clientData);
+
+// An event source watched by the reactor.
+struct AtkReactorSource;
+
+MLE_DECLARE_ARRAY(AtkReactorSourceArray, AtkReactorSource*);
+
+/**
+ * This class multiplexes wires, file descriptors and timers with epoll.
+ *
+ * Wires added to the reactor are put into non-blocking mode, so a frame
+ * that arrives in pieces never stalls the caller; its message is delivered
+ * only once it is complete.  Wires that buffer their outbound messages
+ * are flushed at the end of every dispatch, and whatever the reader has
+ * no room for is written as it becomes writable.  A typical player loop
+ * adds its wire, the display connection and a frame timer, then calls
+ * <b>dispatch()</b> once per iteration or hands control to <b>run()</b>.
+ */
+class MLE_ATK_API AtkReactor
+{
+  public:
+
+    /**
+	 * The default constructor.
+	 */
+    AtkReactor();
+
+    /**
+	 * The destructor.
+	 *
+	 * Wires, file descriptors and timers that were added are not closed,
+	 * with the exception of the timers' own descriptors.
+	 */
+    virtual ~AtkReactor();
+
+    /**
+	 * Watch a wire for messages.
+	 *
+	 * @param wired The wired object whose wire is watched.
+	 * @param callback The function called with each complete message.
+	 * If <b>NULL</b>, the message is delivered to its destination object
+	 * as by <b>AtkWired::recvAndDeliverMsg()</b>.
+	 * @param clientData Data passed to the callback.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    int addWired(AtkWired* wired, AtkReactorMsgCallback callback = NULL,
+		void* clientData = NULL);
+
+    /**
+	 * Stop watching a wire.
+	 *
+	 * @param wired The wired object to stop watching.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the wire is
+	 * not watched, then a negative value will be returned.
+	 */
+    int removeWired(AtkWired* wired);
+
+    /**
+	 * Watch a file descriptor, such as the display connection.
+	 *
+	 * @param fd The file descriptor to watch.
+	 * @param callback The function called when the descriptor is ready.
+	 * @param clientData Data passed to the callback.
+	 * @param events A mask of ATK_REACTOR_READ and ATK_REACTOR_WRITE.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    int addFD(int fd, AtkReactorFDCallback callback, void* clientData = NULL,
+		int events = ATK_REACTOR_READ);
+
+    /**
+	 * Stop watching a file descriptor.
+	 *
+	 * @param fd The file descriptor to stop watching.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the descriptor
+	 * is not watched, then a negative value will be returned.
+	 */
+    int removeFD(int fd);
+
+    /**
+	 * Add a timer.
+	 *
+	 * @param interval The timer interval, in milliseconds.
+	 * @param callback The function called when the timer expires.
+	 * @param clientData Data passed to the callback.
+	 * @param repeat If non-zero the timer fires every <b>interval</b>
+	 * milliseconds; otherwise it fires once and is removed.
+	 *
+	 * @return Upon success, a timer identifier is returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    int addTimer(int interval, AtkReactorTimerCallback callback,
+		void* clientData = NULL, int repeat = 1);
+
+    /**
+	 * Remove a timer.
+	 *
+	 * @param timerID The identifier returned by <b>addTimer()</b>.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the timer
+	 * does not exist, then a negative value will be returned.
+	 */
+    int removeTimer(int timerID);
+
+    /**
+	 * Wait for events and dispatch them to their callbacks.
+	 *
+	 * Messages already queued on a watched wire are delivered without
+	 * waiting.
+	 *
+	 * @param timeout The time to wait, in milliseconds; a negative value
+	 * waits indefinitely.
+	 *
+	 * @return The number of events dispatched is returned, or a negative
+	 * value on error.
+	 */
+    int dispatch(int timeout = -1);
+
+    /**
+	 * Dispatch events until <b>stop()</b> is called or nothing is
+	 * left to watch.
+	 */
+    void run();
+
+    /**
+	 * Make <b>run()</b> return after the current dispatch.
+	 */
+    void stop() { m_running = 0; }
+
+    /**
+	 * Limit the number of messages delivered per wire in one dispatch,
+	 * so that a burst of messages cannot starve the other sources.
+	 *
+	 * @param max The maximum number of messages; <b>0</b> for no limit.
+	 */
+    void setMaxMsgsPerDispatch(int max) { m_maxMsgsPerDispatch = max; }
+
+    /**
+	 * Get the epoll file descriptor, so that the reactor itself can be
+	 * watched by another event loop.
+	 *
+	 * @return The file dscriptor is returned.
+	 */
+    int getFD() { return m_epollFD; }
+
+	/**
+	 * Override operator new.
+	 *
+	 * @param tSize The size, in bytes, to allocate.
+	 */
+	void* operator new(size_t tSize);
+
+	/**
+     * Override operator new array.
+     *
+     * @param tSize The size, in bytes, to allocate.
+     */
+	void* operator new[](size_t tSize);
+
+	/**
+	 * Override operator delete.
+	 *
+	 * @param p A pointer to the memory to delete.
+	 */
+    void  operator delete(void *p);
+
+	/**
+     * Override operator delete array.
+     *
+     * @param p A pointer to the memory to delete.
+     */
+	void  operator delete[](void* p);
+
+  protected:
+
+	/**
+	 * Register a source with epoll and the source list.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+	int addSource(AtkReactorSource* source, int events);
+
+	/**
+	 * Unregister a source; it is freed once no dispatch refers to it.
+	 */
+	void removeSource(int index);
+
+	/**
+	 * Find the index of the source of the given kind and descriptor.
+	 *
+	 * @return The index is returned, or <b>-1</b> if there is none.
+	 */
+	int findSource(int kind, int fd);
+
+	/**
+	 * Deliver the messages queued on a wire source.
+	 *
+	 * @return The number of messages delivered is returned.
+	 */
+	int deliverWireMsgs(AtkReactorSource* source);
+
+	/**
+	 * Watch, or stop watching, a wire's write file descriptor according to
+	 * whether the wire has buffered output pending.
+	 */
+	void updateWireOutput(AtkReactorSource* source);
+
+	/**
+	 * Free sources removed during a dispatch.
+	 */
+	void purgeSources();
+
+	/** The epoll file descriptor. */
+	int m_epollFD;
+	/** The watched sources. */
+	AtkReactorSourceArray m_sources;
+	/** Flag indicating whether <b>run()</b> should continue. */
+	int m_running;
+	/** The depth of dispatches in progress. */
+	int m_dispatching;
+	/** The maximum number of messages delivered per wire in one dispatch. */
+	int m_maxMsgsPerDispatch;
+};
+
+#endif /* __linux__ */
+
+#endif /* __ATK_REACTOR_H_ */
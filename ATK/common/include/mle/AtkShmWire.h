@@ -0,0 +1,270 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkShmWire.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that provides utility for sending and
+ * recieving messages through shared memory.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_SHMWIRE_H_
+#define __ATK_SHMWIRE_H_
+
+#if defined(__linux__)
+
+// Include Authoring Toolkit header files.
+#include <mle/AtkWire.h>
+
+/** The default size of each ring, in bytes; must be a power of two. */
+#define ATK_SHM_WIRE_RING_SIZE (1024 * 1024)
+/**
+ * The number of times to poll a ring before sleeping on its eventfd,
+ * on machines with more than one processor.
+ */
+#define ATK_SHM_WIRE_SPIN_COUNT 2000
+
+// The control block at the start of the shared region.
+struct AtkShmRegion;
+// The control block of one ring.
+struct AtkShmRing;
+
+/**
+ * This class sends and recieves messages through a pair of single
+ * producer, single consumer byte rings in a shared memory region.
+ *
+ * The region is a memfd created by one side with <b>createRegion()</b>
+ * and handed to the other side, together with two eventfds, across
+ * <b>exec()</b>.  Side 0 (the creator) writes ring 0 and reads ring 1;
+ * side 1 does the opposite.  Each side sleeps on its own eventfd, which
+ * is the wire's read file descriptor and so can be watched like a pipe,
+ * and is woken by the other side only when it has said it is going to
+ * sleep.  Frames have the same layout as on a pipe.
+ *
+ * Outbound buffering is not supported; the ring itself decouples the
+ * writer from the reader up to its size.
+ */
+class MLE_ATK_API AtkShmWire : public AtkWire
+{
+  public:
+
+    /**
+	 * Create and initialize a shared region.
+	 *
+	 * The memfd is inheritable so that it can be passed to a child.
+	 *
+	 * @param ringSize The size of each ring, in bytes; it is rounded up
+	 * to a power of two.
+	 *
+	 * @return The memfd is returned, or a negative value on error.
+	 */
+    static int createRegion(int ringSize = ATK_SHM_WIRE_RING_SIZE);
+
+    /**
+	 * Attach to a shared region.
+	 *
+	 * @param memFD The memfd holding the region.
+	 * @param recvEventFD The eventfd this side sleeps on.
+	 * @param sendEventFD The eventfd the other side sleeps on.
+	 * @param side <b>0</b> for the side that created the region,
+	 * <b>1</b> for the other.
+	 *
+	 * @return A pointer to the wire is returned, or <b>NULL</b> if the
+	 * region is not valid. On success the wire owns all three descriptors.
+	 */
+    static AtkShmWire* attach(int memFD, int recvEventFD, int sendEventFD,
+		int side = 1);
+
+    /**
+	 * The destructor.
+	 *
+	 * The other side sees end of file once it has read everything
+	 * that was sent.
+	 */
+    virtual ~AtkShmWire();
+
+    /**
+	 * Enable or disable non-blocking mode.
+	 *
+	 * @param onOff Non-zero to enable non-blocking mode, zero to disable it.
+	 *
+	 * @return <b>0</b> is always returned.
+	 */
+    virtual int setNonBlocking(int onOff);
+
+    /**
+	 * Outbound buffering is not supported.
+	 *
+	 * @return <b>0</b> if <b>onOff</b> is zero, otherwise <b>-1</b>.
+	 */
+    virtual int setSendBuffering(int onOff);
+
+    /**
+	 * A reader thread is not supported; reading the ring involves no
+	 * system calls to overlap.
+	 *
+	 * @return <b>-1</b> is always returned.
+	 */
+    virtual int startReaderThread(int queueSize = ATK_WIRE_READER_QUEUE_SIZE);
+
+    /**
+	 * A bulk lane is not supported; every message is written straight
+	 * into the ring, which waits only for room rather than on a reader
+	 * draining a pipe.
+	 */
+    virtual void setBulkThreshold(int threshold, int fragmentSize = ATK_WIRE_FRAGMENT_SIZE);
+
+    /**
+	 * Wait for data in the inbound ring.
+	 *
+	 * The ring is polled briefly before sleeping on the eventfd.
+	 *
+	 * @param timeout The time to wait, in milliseconds; a negative value
+	 * waits indefinitely.
+	 *
+	 * @return <b>1</b> if there may be data, <b>0</b> if the timeout
+	 * expired and a negative value on error.
+	 */
+    virtual int waitForInput(int timeout);
+
+  protected:
+
+    /**
+	 * A constructor that takes an attached region.
+	 */
+    AtkShmWire(int memFD, int recvEventFD, int sendEventFD,
+		AtkShmRegion* region, int regionSize, int side);
+
+	/**
+	 * Write a message frame into the outbound ring, waiting for room
+	 * as needed.
+	 */
+	virtual int writeFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers,
+		int numBuffers);
+
+	/**
+	 * Copy whatever the inbound ring holds into the receive buffer.
+	 *
+	 * @return The number of bytes copied is returned. <b>0</b> indicates
+	 * that the other side has gone, and <b>-1</b> with <b>errno</b> set to
+	 * <b>EAGAIN</b> that the ring is empty.
+	 */
+	virtual int fillRecvBuffer();
+
+	/**
+	 * Continue receiving a frame too large for the receive buffer,
+	 * copying straight from the inbound ring into the message.
+	 */
+	virtual int readPartialMsg();
+
+	/**
+	 * Copy bytes into the outbound ring.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+	int writeRing(const void* data, int len);
+
+	/**
+	 * Copy up to <b>len</b> bytes out of the inbound ring.
+	 *
+	 * @return The number of bytes copied is returned.
+	 */
+	int readRing(void* data, int len);
+
+	/**
+	 * Get the number of bytes waiting in the inbound ring.
+	 */
+	unsigned int getInboundBytes();
+
+	/**
+	 * Get the number of bytes of room in the outbound ring.
+	 */
+	unsigned int getOutboundSpace();
+
+	/**
+	 * Wait until there is room in the outbound ring.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the other side
+	 * has gone, then a negative value will be returned.
+	 */
+	int waitForSpace();
+
+	/**
+	 * Sleep on the inbound eventfd and consume its count.
+	 *
+	 * @return <b>1</b> if woken, <b>0</b> if the timeout expired and a
+	 * negative value on error.
+	 */
+	int waitForEvent(int timeout);
+
+	/**
+	 * Ask the other side for a wakeup when it next writes, for a reader
+	 * that is about to return to its event loop.
+	 *
+	 * @return <b>1</b> if data or end of file arrived meanwhile,
+	 * otherwise <b>0</b>.
+	 */
+	int armReader();
+
+	/**
+	 * Wake the other side.
+	 */
+	void signalPeer();
+
+	/** The memfd holding the shared region. */
+	int m_memFD;
+	/** The mapped shared region. */
+	AtkShmRegion* m_region;
+	/** The size of the mapped region, in bytes. */
+	int m_regionSize;
+	/** The ring this side writes. */
+	AtkShmRing* m_sendRing;
+	/** The ring this side reads. */
+	AtkShmRing* m_recvRing;
+	/** The data area of the outbound ring. */
+	char* m_sendData;
+	/** The data area of the inbound ring. */
+	char* m_recvData;
+	/** The size of each ring, in bytes. */
+	unsigned int m_ringSize;
+	/** The number of times to poll a ring before sleeping. */
+	int m_spinCount;
+};
+
+#endif /* __linux__ */
+
+#endif /* __ATK_SHMWIRE_H_ */
@@ -44,13 +44,149 @@
 #ifndef __ATK_WIRE_H_
 #define __ATK_WIRE_H_
 
+// Include system header files.
+#include <atomic>
+#include <thread>
+
 // Include Magic Lantern header files.
 #include <mle/mlDebug.h>
 #include <mle/mleatk_rehearsal.h>
+#include <mle/AtkBasicArray.h>
+#include <mle/AtkWireNameTable.h>
+#include <mle/AtkWireStats.h>
+
+/** The default size of the receive buffer, in bytes. */
+#define ATK_WIRE_RECV_BUFFER_SIZE 65536
+/** The initial size of the send buffer, in bytes. */
+#define ATK_WIRE_SEND_BUFFER_SIZE 65536
+/** The default high-water mark of the send buffer, in bytes. */
+#define ATK_WIRE_SEND_HIGH_WATER_MARK (1024 * 1024)
+
+/** The version of the wire protocol this side speaks. */
+#define ATK_WIRE_PROTOCOL_VERSION 2
+
+/** The name of the internal message that exchanges wire capabilities. */
+#define ATK_WIRE_OPTIONS_MSG_NAME "WireOptions"
+/** The name of the internal message that switches to compact headers. */
+#define ATK_WIRE_FRAMING_MSG_NAME "WireFraming"
+/** Capability: compressed payloads can be received. */
+#define ATK_WIRE_CAP_COMPRESS 0x1
+/** Capability: requests may carry correlation IDs, which replies echo. */
+#define ATK_WIRE_CAP_CORRELATE 0x2
+/** Capability: frames with compact headers can be received. */
+#define ATK_WIRE_CAP_COMPACT 0x4
+/** Capability: bulk messages can be received as fragments. */
+#define ATK_WIRE_CAP_FRAGMENT 0x8
+
+/** The default payload size of a bulk message fragment, in bytes. */
+#define ATK_WIRE_FRAGMENT_SIZE 16384
+/** The most bulk fragments written without waiting, between other frames. */
+#define ATK_WIRE_BULK_BURST 4
+/** The default largest payload, in bytes, a received message may expand to. */
+#define ATK_WIRE_MAX_MSG_SIZE (256 * 1024 * 1024)
+
+/** The longest encoded frame header, in bytes. */
+#define ATK_WIRE_MAX_HEADER_LENGTH 64
+
+/** The default capacity of the reader thread's message queue. */
+#define ATK_WIRE_READER_QUEUE_SIZE 4096
+
+/** The most descriptors accepted with a single read from a socket. */
+#define ATK_WIRE_MAX_PASSED_FDS 16
+
+/** High-water policy: flush, waiting for the reader, until there is room. */
+#define ATK_WIRE_HWM_BLOCK  0
+/** High-water policy: drop the message being sent. */
+#define ATK_WIRE_HWM_DROP   1
+/** High-water policy: buffer the message regardless of the mark. */
+#define ATK_WIRE_HWM_ACCEPT 2
+
+/** Read status: readFrame() returned a message. */
+#define ATK_WIRE_READ_MSG    1
+/** Read status: no complete frame has arrived yet. */
+#define ATK_WIRE_READ_EMPTY  0
+/** Read status: the read failed or the connection was lost. */
+#define ATK_WIRE_READ_ERROR -1
 
 // Class declarations
+class AtkWire;
 class AtkWireMsg;
+class AtkWireMsgQueue;
+class AtkWireRecorder;
 class AtkWired;
+class AtkWireBatch;
+
+/**
+ * A descriptor for a caller owned region of a message payload.
+ *
+ * An array of these is used to gather a payload from several buffers
+ * without first copying them into a single message buffer.
+ */
+struct AtkWireBuffer
+{
+    /** A pointer to the payload region. */
+    const void* m_data;
+    /** The length of the payload region, in bytes. */
+    int m_length;
+};
+
+/**
+ * A message held back to be coalesced with later ones.
+ *
+ * Held messages are keyed by their name together with two caller keys,
+ * and a later message with the same keys replaces the one held.
+ */
+struct AtkWireCoalescedMsg
+{
+    /** The hash of the message name and keys. */
+    unsigned int m_hash;
+    /** The key qualifying the message name; owns the storage of both keys. */
+    char* m_key;
+    /** The key qualifying the first one. */
+    char* m_subKey;
+    /** The latest message sent with the key. */
+    AtkWireMsg* m_msg;
+    /** The next held message, in the order the keys were first sent. */
+    AtkWireCoalescedMsg* m_next;
+};
+
+MLE_DECLARE_ARRAY(AtkWireFDArray, int);
+MLE_DECLARE_ARRAY(AtkWireIDArray, unsigned int);
+
+/**
+ * Counters for payload compression on a wire.
+ *
+ * The bytes saved in each direction are the raw bytes less the wire bytes.
+ */
+struct AtkWireCompressionStats
+{
+    /** The number of messages sent compressed. */
+    long long m_sentMsgs;
+    /** The payload bytes of those messages before compression. */
+    long long m_sentRawBytes;
+    /** The payload bytes of those messages as sent. */
+    long long m_sentWireBytes;
+    /** The number of compressed messages received. */
+    long long m_recvMsgs;
+    /** The payload bytes of those messages after decompression. */
+    long long m_recvRawBytes;
+    /** The payload bytes of those messages as received. */
+    long long m_recvWireBytes;
+};
+
+/**
+ * Callback invoked when a buffered send would exceed the high-water mark.
+ *
+ * @param wire The wire being sent on.
+ * @param msgName The name of the message being sent.
+ * @param pendingBytes The number of bytes waiting to be written.
+ * @param clientData The data registered with the callback.
+ *
+ * @return One of ATK_WIRE_HWM_BLOCK, ATK_WIRE_HWM_DROP or
+ * ATK_WIRE_HWM_ACCEPT.
+ */
+typedef int (*AtkWireHighWaterCallback)(AtkWire* wire, const char* msgName,
+	int pendingBytes, void* clientData);
 
 /**
  * This class is used for sending and recieving messages over the network.
@@ -84,6 +220,23 @@ class MLE_ATK_API AtkWire
 	 */
     virtual int sendMsg(void* destObj, const char* msgName, 
         void* msgData=0, int msgDataLen=0);
+
+    /**
+	 * Send a message whose payload is gathered from several buffers.
+	 *
+	 * The buffers are borrowed, not copied; the header and all of the
+	 * buffers are written to the wire in a single gather write.
+	 *
+	 * @param destObj The destination Object to send the message to.
+	 * @param msgName The name of the message.
+	 * @param buffers An array of payload buffers, written in order.
+	 * @param numBuffers The number of entries in <b>buffers</b>.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the message is
+	 * not sent successfully, then a negative value will be returned.
+	 */
+    virtual int sendMsg(void* destObj, const char* msgName,
+        const AtkWireBuffer* buffers, int numBuffers);
     
 	/**
 	 * Send a message.
@@ -94,6 +247,42 @@ class MLE_ATK_API AtkWire
 	 * not sent successfully, then a negative value will be returned.
 	 */
     virtual int sendMsg(AtkWireMsg* msg);
+
+	/**
+	 * Send a message on the bulk lane, whatever its size.
+	 *
+	 * Messages on the same lane arrive in the order they were sent. Use
+	 * this for a message that must not overtake a bulk message sent
+	 * before it.
+	 *
+	 * @param msg A pointer to the message package.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the message is
+	 * not sent successfully, then a negative value will be returned.
+	 */
+    virtual int sendBulkMsg(AtkWireMsg* msg);
+
+	/**
+	 * Send a message that only matters for its latest value.
+	 *
+	 * If the message can't be written right away, a copy is held until
+	 * the wire has room. Another message with the same name and keys
+	 * sent in the meantime replaces the held one, so a lagging reader sees
+	 * only the newest value and at most one message per key is held.
+	 * Held messages are written ahead of any other message sent, so the
+	 * order of messages with different names and keys is kept.
+	 *
+	 * @param msg A pointer to the message package.
+	 * @param key The key qualifying the message name, such as the name of
+	 * the actor the message is about.
+	 * @param subKey A key qualifying the first one, such as the name of a
+	 * property of the actor, or NULL.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the message is
+	 * not sent successfully, then a negative value will be returned.
+	 */
+    virtual int sendCoalescedMsg(AtkWireMsg* msg, const char* key,
+		const char* subKey = NULL);
     
 	/**
 	 * Recieve a message.
@@ -107,6 +296,10 @@ class MLE_ATK_API AtkWire
 	/**
 	 * Recieve a message from the read file descriptor.
 	 *
+	 * Frames are read through a receive buffer, so a single read may
+	 * supply several messages; this returns the next complete one and
+	 * leaves the rest buffered.
+	 *
 	 * @return If a message is successfully recieved, then a pointer
 	 * to a message package is returned. Otherwise, <b>NULL</b>
 	 * will be returned.
@@ -140,18 +333,503 @@ class MLE_ATK_API AtkWire
 	 */
     virtual AtkWireMsg* sendSyncMsg(AtkWired* wired, AtkWireMsg* msg);
 
+	/**
+	 * Send a request without waiting for its reply.
+	 *
+	 * Any number of requests may be outstanding at once; their replies
+	 * are collected with <b>waitForReply()</b>, <b>waitForReplies()</b> or
+	 * <b>waitForAnyReply()</b>, and every request must be waited for.
+	 * Once the other side has agreed to it, each request carries a
+	 * correlation ID that its reply echoes; until then replies are
+	 * matched to requests in the order they were sent.
+	 *
+	 * @param destObj The destination Object to send the message to.
+	 * @param msgName The name of the message.
+	 * @param msgData A pointer to the message payload.
+	 * @param msgDataLen The size of the message payload.
+	 *
+	 * @return Upon success, the ID of the request is returned.
+	 * Otherwise, <b>0</b> will be returned.
+	 */
+    virtual unsigned int sendRequest(void* destObj, const char* msgName,
+		void* msgData=0, int msgDataLen=0);
+
+	/**
+	 * Send a request without waiting for its reply.
+	 *
+	 * @param msg A pointer to the message package to send.
+	 *
+	 * @return Upon success, the ID of the request is returned.
+	 * Otherwise, <b>0</b> will be returned.
+	 */
+    virtual unsigned int sendRequest(AtkWireMsg* msg);
+
+	/**
+	 * Wait for the reply to a request.
+	 *
+	 * Synchronous messages from the other side are answered while
+	 * waiting, and other messages are queued.
+	 *
+	 * @param wired The object that synchronous messages with no
+	 * destination are delivered to.
+	 * @param id The ID returned by <b>sendRequest()</b>.
+	 *
+	 * @return Upon success, a pointer to the reply message package
+	 * is returned. Otherwise, <b>null</b> will be returned.
+	 */
+    virtual AtkWireMsg* waitForReply(AtkWired* wired, unsigned int id);
+
+	/**
+	 * Wait for the replies to several requests.
+	 *
+	 * @param wired The object that synchronous messages with no
+	 * destination are delivered to.
+	 * @param ids The IDs returned by <b>sendRequest()</b>.
+	 * @param numIDs The number of entries in <b>ids</b>.
+	 * @param replies Receives the reply to each request, or <b>NULL</b>
+	 * for one that failed.
+	 *
+	 * @return The number of replies received is returned.
+	 */
+    virtual int waitForReplies(AtkWired* wired, const unsigned int* ids,
+		int numIDs, AtkWireMsg** replies);
+
+	/**
+	 * Wait for the reply to whichever outstanding request is answered
+	 * first.
+	 *
+	 * @param wired The object that synchronous messages with no
+	 * destination are delivered to.
+	 * @param id Receives the ID of the request that was answered.
+	 *
+	 * @return Upon success, a pointer to the reply message package
+	 * is returned. If no request is outstanding or the connection is
+	 * lost, <b>null</b> will be returned.
+	 */
+    virtual AtkWireMsg* waitForAnyReply(AtkWired* wired, unsigned int* id);
+
+	/**
+	 * Get the number of requests whose replies have not arrived.
+	 */
+    int getNumPendingRequests() { return m_pendingIDs.getLength(); }
+
+    /**
+	 * Collect the replies sent from now on into a batch instead of
+	 * writing them, as is done while the members of a batch are
+	 * delivered.
+	 *
+	 * @param batch The batch to add replies to, or <b>NULL</b> to write
+	 * them again.
+	 *
+	 * @return The batch that was collecting replies before is returned.
+	 */
+    AtkWireBatch* setReplyBatch(AtkWireBatch* batch)
+    { AtkWireBatch* old = m_replyBatch; m_replyBatch = batch; return old; }
+
+    /**
+	 * Get the batch replies are being collected into, if any.
+	 */
+    AtkWireBatch* getReplyBatch() { return m_replyBatch; }
+
     /**
-     * Get the read file descriptor.
+	 * Collect the messages sent on the calling thread, through any wire,
+	 * into a batch instead of writing them. A worker thread does this so
+	 * that what it sends can be written, in order, by the thread that
+	 * owns the wire.
+	 *
+	 * @param batch The batch to collect the messages into, or <b>NULL</b>
+	 * to write them again.
+	 *
+	 * @return The batch that was collecting the thread's messages before
+	 * is returned.
+	 */
+    static AtkWireBatch* setThreadCapture(AtkWireBatch* batch);
+
+    /**
+	 * Check whether a synchronous message that arrived while waiting for
+	 * a reply is being delivered; it must be answered before the wait can
+	 * end.
+	 */
+    int isDeliveringSyncMsg() { return m_syncDeliveryDepth > 0; }
+
+    /**
+     * Get the file descriptor that becomes readable when messages arrive.
+	 *
+	 * This is the read file descriptor, unless a reader thread is
+	 * running; then it is a descriptor the thread signals, so watch it
+	 * only after the thread has been started.
+	 *
+	 * @return The file dscriptor is returned.
+	 */
+    int getFD() { return m_readerThread ? m_readerNotifyFD[0] : m_readFD; }
+
+    /**
+     * Get the write file descriptor.
 	 *
 	 * @return The file dscriptor is returned.
 	 */
-    int getFD() { return m_readFD; }
+    int getWriteFD() { return m_writeFD; }
 
     /**
 	 * Check to see if any messages are pending in the queue.
+	 *
+	 * @return The number of messages that have arrived but not been
+	 * received is returned; this takes constant time once frames have
+	 * been decoded.
 	 */
     virtual int getNumMsgs();
 
+    /**
+	 * Start a thread that reads and decodes frames in the background.
+	 *
+	 * The thread hands messages to the receiving thread through a
+	 * lock-free queue, so kernel reads and decoding overlap with whatever
+	 * the receiving thread is doing. <b>recvMsg()</b> and the other
+	 * receiving calls then take messages from the queue; they, and all
+	 * sending, must stay on a single thread. While the thread runs the
+	 * receive compression counters are updated by it.
+	 *
+	 * @param queueSize The most messages held in the queue; the reader
+	 * waits for room when it is full.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    virtual int startReaderThread(int queueSize = ATK_WIRE_READER_QUEUE_SIZE);
+
+    /**
+	 * Stop the reader thread; messages it has already queued can still
+	 * be received.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    virtual int stopReaderThread();
+
+    /**
+	 * Check to see if a reader thread is running.
+	 */
+    int hasReaderThread() { return (m_readerThread != NULL); }
+
+    /**
+	 * Put the read file descriptor into, or take it out of, non-blocking mode.
+	 *
+	 * In non-blocking mode <b>recvMsg()</b> never waits for data; a frame
+	 * that has only partly arrived is kept and completed by later reads.
+	 * Synchronous messages still wait for their reply.
+	 *
+	 * @param onOff Non-zero to enable non-blocking mode, zero to disable it.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    virtual int setNonBlocking(int onOff);
+
+    /**
+	 * Check to see if the wire is in non-blocking mode.
+	 */
+    int isNonBlocking() { return m_nonBlocking; }
+
+    /**
+	 * Read whatever is available on the read file descriptor without
+	 * waiting, and queue every message it completes.
+	 *
+	 * This is intended for use in non-blocking mode, when the read file
+	 * descriptor has been reported readable.
+	 *
+	 * @return The number of messages queued is returned, or a negative
+	 * value if the connection has been lost.
+	 */
+    virtual int pollMsgs();
+
+    /**
+	 * Wait for the read file descriptor to become readable.
+	 *
+	 * @param timeout The time to wait, in milliseconds; a negative value
+	 * waits indefinitely.
+	 *
+	 * @return <b>1</b> if the descriptor is readable, <b>0</b> if the
+	 * timeout expired and a negative value on error.
+	 */
+    virtual int waitForInput(int timeout);
+
+    /**
+	 * Check to see if a frame has only partly been received.
+	 */
+    int hasPartialMsg() { return (m_partialMsg != NULL); }
+
+    /**
+	 * Enable or disable buffering of outbound messages.
+	 *
+	 * While buffering, <b>sendMsg()</b> only appends the frame to the send
+	 * buffer and the write file descriptor is non-blocking; the buffer goes
+	 * out in as few writes as possible when <b>flush()</b> is called, for
+	 * instance once per rendered frame. Synchronous messages flush before
+	 * waiting for their reply. Disabling buffering flushes everything
+	 * pending.
+	 *
+	 * @param onOff Non-zero to enable buffering, zero to disable it.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    virtual int setSendBuffering(int onOff);
+
+    /**
+	 * Check to see if outbound messages are buffered.
+	 */
+    int isSendBuffering() { return m_sendBuffering; }
+
+    /**
+	 * Write buffered outbound messages.
+	 *
+	 * @param block If zero, write only what the reader has room for;
+	 * otherwise wait until everything has been written.
+	 *
+	 * @return The number of bytes still pending is returned, or a negative
+	 * value on error.
+	 */
+    virtual int flush(int block = 0);
+
+    /**
+	 * Get the number of buffered bytes waiting to be written.
+	 */
+    int getPendingBytes() { return (m_sendEnd - m_sendStart); }
+
+    /**
+	 * Set the payload size at which messages go on the bulk lane.
+	 *
+	 * A message on the interactive lane is written as soon as it is sent.
+	 * A message on the bulk lane is queued and written in fragments of at
+	 * most <b>fragmentSize</b> bytes, so that interactive messages sent
+	 * meanwhile go out between them instead of waiting for the whole of it;
+	 * the other side reassembles it. An interactive message may therefore
+	 * overtake a bulk message sent before it.
+	 *
+	 * Fragments are written a few at a time as messages are sent, while
+	 * waiting for input, and by <b>flush()</b>, which a reactor calls when
+	 * the wire can take more. Bulk messages are sent whole until the other
+	 * side has answered that it can reassemble them. The initial threshold
+	 * is taken from the MLE_ATK_BULK_THRESHOLD environment variable, if
+	 * set.
+	 *
+	 * @param threshold The threshold, in bytes; <b>0</b> puts every
+	 * message on the interactive lane.
+	 * @param fragmentSize The most payload bytes written in one fragment.
+	 */
+    virtual void setBulkThreshold(int threshold, int fragmentSize = ATK_WIRE_FRAGMENT_SIZE);
+
+    /**
+	 * Get the payload size at which messages go on the bulk lane.
+	 */
+    int getBulkThreshold() { return m_bulkThreshold; }
+
+    /**
+	 * Get the payload size of a bulk message fragment.
+	 */
+    int getFragmentSize() { return m_fragmentSize; }
+
+    /**
+	 * Set the largest payload a received message may claim once it is
+	 * decompressed or reassembled from bulk fragments. A message claiming
+	 * more is taken as a corrupt stream and the connection is lost.
+	 *
+	 * @param size The size, in bytes; <b>0</b> restores
+	 * ATK_WIRE_MAX_MSG_SIZE.
+	 */
+    void setMaxMsgSize(int size)
+	{ m_maxMsgSize = (size > 0) ? size : ATK_WIRE_MAX_MSG_SIZE; }
+
+    /**
+	 * Get the largest payload a received message may claim.
+	 */
+    int getMaxMsgSize() { return m_maxMsgSize; }
+
+    /**
+	 * Get the number of bulk payload bytes waiting to be written.
+	 */
+    long getPendingBulkBytes() { return m_bulkBytes; }
+
+    /**
+	 * Get the number of messages held back for coalescing.
+	 */
+    int getNumCoalesced() { return m_numCoalesced; }
+
+    /**
+	 * Get the number of held messages that were replaced by newer ones
+	 * before they could be written.
+	 */
+    long long getNumSuperseded() { return m_numSuperseded; }
+
+    /**
+	 * Check whether anything is buffered, held or queued to be written.
+	 */
+    int hasPendingOutput()
+    { return (m_sendEnd > m_sendStart || m_coalesceHead || m_bulkHead) ? 1 : 0; }
+
+    /**
+	 * Set the high-water mark of the send buffer.
+	 *
+	 * When a buffered send would take the pending bytes past the mark and
+	 * a non-blocking flush cannot make room, <b>callback</b> chooses what
+	 * happens to the message; without a callback the send waits for the
+	 * reader (ATK_WIRE_HWM_BLOCK). A dropped message makes <b>sendMsg()</b>
+	 * return <b>-5</b>.
+	 *
+	 * @param mark The high-water mark, in bytes.
+	 * @param callback The policy callback, or <b>NULL</b>.
+	 * @param clientData Data passed to the callback.
+	 */
+    void setHighWaterMark(int mark, AtkWireHighWaterCallback callback = NULL,
+		void* clientData = NULL);
+
+    /**
+	 * Get the high-water mark of the send buffer, in bytes.
+	 */
+    int getHighWaterMark() { return m_highWaterMark; }
+
+    /**
+	 * Set the payload size at which messages are passed out-of-band.
+	 *
+	 * A payload of at least <b>threshold</b> bytes is written into a
+	 * sealed memfd, which is passed over the socket with a small control
+	 * frame; the receiver maps it instead of copying it. This needs the
+	 * write file descriptor to be a Unix domain socket and the other side
+	 * to understand out-of-band frames; receiving them is always enabled.
+	 * The initial threshold is taken from the MLE_ATK_OOB_THRESHOLD
+	 * environment variable, if set.
+	 *
+	 * @param threshold The threshold, in bytes; <b>0</b> disables
+	 * out-of-band sends.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If out-of-band sends
+	 * are not possible on this wire, then a negative value will be returned.
+	 */
+    virtual int setOOBThreshold(int threshold);
+
+    /**
+	 * Get the payload size at which messages are passed out-of-band.
+	 *
+	 * @return The threshold, in bytes, is returned; <b>0</b> means that
+	 * out-of-band sends are disabled.
+	 */
+    int getOOBThreshold() { return m_oobThreshold; }
+
+    /**
+	 * Set the payload size at which messages are compressed.
+	 *
+	 * Compression is negotiated: the first message sent after enabling it
+	 * is preceded by an internal "WireOptions" message, and payloads are
+	 * compressed only once the other side has answered that it can
+	 * decompress them. A payload is sent raw if compressing it saves
+	 * little. Decompression is always enabled. The initial threshold is
+	 * taken from the MLE_ATK_COMPRESS_THRESHOLD environment variable,
+	 * if set.
+	 *
+	 * @param threshold The threshold, in bytes; <b>0</b> disables
+	 * compression.
+	 */
+    virtual void setCompressionThreshold(int threshold);
+
+    /**
+	 * Get the payload size at which messages are compressed.
+	 */
+    int getCompressionThreshold() { return m_compressThreshold; }
+
+    /**
+	 * Get the capabilities the other side has announced.
+	 *
+	 * @return A mask of ATK_WIRE_CAP_* values is returned; <b>0</b> until
+	 * the other side has announced any.
+	 */
+    int getPeerCapabilities() { return m_peerCaps; }
+
+    /**
+	 * Get the wire protocol version the other side has announced.
+	 *
+	 * @return The version is returned; <b>1</b> until the other side
+	 * has announced one.
+	 */
+    int getPeerVersion() { return m_peerVersion; }
+
+    /**
+	 * Enable or disable compact frame headers.
+	 *
+	 * The original header is a raw copy of the message fields: over 40
+	 * bytes, with a layout that depends on the size of a pointer. Compact
+	 * headers are a flags byte, a 16-bit message name ID and variable
+	 * length integers for the payload length and destination, so small
+	 * messages such as manipulations shrink to a fraction of their size.
+	 * They also carry the whole destination and the synchronous flag,
+	 * which the original header truncates and drops on 64-bit hosts.
+	 * Each side interns the names it sends, defining an ID the first time
+	 * it is used. Like compression this is negotiated: once the other
+	 * side has announced that it reads compact headers, an internal
+	 * "WireFraming" message marks the point from which this side sends
+	 * them. Compact headers are always read. The initial setting is taken
+	 * from the MLE_ATK_COMPACT_HEADERS environment variable, if set.
+	 *
+	 * @param onOff Non-zero to send compact headers once possible.
+	 */
+    virtual void setCompactHeaders(int onOff);
+
+    /**
+	 * Check to see if compact headers are wanted.
+	 */
+    int getCompactHeaders() { return m_compactHeaders; }
+
+    /**
+	 * Check to see if frames are being sent with compact headers.
+	 */
+    int isSendingCompactHeaders() { return m_sendCompact; }
+
+    /**
+	 * Record the messages sent and received on this wire.
+	 *
+	 * Messages are recorded as the application sees them: before they
+	 * are compressed or tagged on the way out, and after they are
+	 * reassembled on the way in. The wire takes ownership of the
+	 * recorder, deleting any it had before. It must not be changed while
+	 * a reader thread is running.
+	 *
+	 * @param recorder The recorder, or <b>NULL</b> to stop recording.
+	 */
+    virtual void setRecorder(AtkWireRecorder* recorder);
+
+    /**
+	 * Get the recorder, if there is one.
+	 */
+    AtkWireRecorder* getRecorder() { return m_recorder; }
+
+    /**
+	 * Count the messages sent and received on this wire, by name.
+	 *
+	 * Collection is off unless MLE_ATK_STATS is set, in which case the
+	 * counters are also printed when the process exits: to the file it
+	 * names, or to standard output if it is "-". Received messages are
+	 * stamped with when they came off the wire, so that whoever delivers
+	 * them can count how long they waited and how long they took.
+	 *
+	 * @param onOff Non-zero to start counting, zero to stop. The counters
+	 * are kept until they are reset.
+	 */
+    virtual void setStatsEnabled(int onOff);
+
+    /**
+	 * Check whether messages are being counted.
+	 */
+    int isStatsEnabled() { return m_statsEnabled.load(std::memory_order_relaxed); }
+
+    /**
+	 * Get the message counters.
+	 */
+    AtkWireStats* getStats() { return &m_stats; }
+
+    /**
+	 * Get the compression counters.
+	 */
+    const AtkWireCompressionStats& getCompressionStats() { return m_compressionStats; }
+
     /**
 	 * Check to see if the connection is lost.
 	 */
@@ -187,6 +865,363 @@ class MLE_ATK_API AtkWire
 
   protected:
 
+	/**
+	 * Write a message frame to the write file descriptor.
+	 *
+	 * The header of <b>msg</b> is written followed by each of the
+	 * payload buffers, using a single gather write where the platform
+	 * supports it. Partial writes are resumed until the entire frame
+	 * has been written.
+	 *
+	 * @param msg The message providing the frame header.
+	 * @param buffers An array of payload buffers.
+	 * @param numBuffers The number of entries in <b>buffers</b>.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the frame could
+	 * not be written, then a negative value will be returned.
+	 */
+	virtual int writeFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers,
+		int numBuffers);
+
+	/**
+	 * Append a message frame to the send buffer, applying the high-water
+	 * policy.
+	 *
+	 * @param msg The message providing the frame header.
+	 * @param buffers An array of payload buffers.
+	 * @param numBuffers The number of entries in <b>buffers</b>.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the frame was
+	 * dropped or could not be buffered, then a negative value will be
+	 * returned.
+	 */
+	virtual int bufferFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers,
+		int numBuffers);
+
+	/**
+	 * Encode a message frame, compressing its payload if that has been
+	 * negotiated, and write it.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the frame could
+	 * not be written, then a negative value will be returned.
+	 */
+	virtual int sendFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers,
+		int numBuffers);
+
+	/**
+	 * Decode what the frame flags say about a received message, and
+	 * consume internal messages.
+	 *
+	 * @return The message is returned, or <b>NULL</b> if it was consumed
+	 * or could not be decoded; in the latter case the connection is
+	 * marked lost.
+	 */
+	virtual AtkWireMsg* finishMsg(AtkWireMsg* msg);
+
+	/**
+	 * Replace the payload of a compressed message by its decompressed form.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+	virtual int decompressMsg(AtkWireMsg* msg);
+
+	/**
+	 * Get the capabilities this side announces.
+	 *
+	 * @return A mask of ATK_WIRE_CAP_* values is returned.
+	 */
+	virtual int getCapabilities();
+
+	/**
+	 * Announce this side's capabilities to the other side.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+	virtual int sendOptions();
+
+	/**
+	 * The body of the reader thread.
+	 */
+	virtual void readerLoop();
+
+	/**
+	 * Take the next message from the reader thread's queue.
+	 *
+	 * @param block If non-zero, wait for a message when none is queued.
+	 *
+	 * @return The message is returned, or <b>NULL</b> if none is queued
+	 * or the connection has been lost.
+	 */
+	AtkWireMsg* popReaderMsg(int block);
+
+	/**
+	 * Tell the receiving thread that the reader thread has queued
+	 * messages or stopped.
+	 *
+	 * @param force If non-zero, signal even if a signal is outstanding.
+	 */
+	void notifyReceiver(int force);
+
+	/**
+	 * Consume a capability announcement from the other side.
+	 *
+	 * @return <b>1</b> if the message was an announcement, and has been
+	 * deleted, otherwise <b>0</b>.
+	 */
+	int handleOptions(AtkWireMsg* msg);
+
+	/**
+	 * Send a request, tagging it if the other side can echo the tag.
+	 *
+	 * @return Upon success, the ID of the request is returned.
+	 * Otherwise, <b>0</b> will be returned.
+	 */
+	virtual unsigned int issueRequest(AtkWireMsg* msg);
+
+	/**
+	 * Encode the frame header of a message.
+	 *
+	 * @param msg The message providing the header fields.
+	 * @param header The buffer to receive the header; it must hold
+	 * ATK_WIRE_MAX_HEADER_LENGTH bytes.
+	 *
+	 * @return The length of the header is returned.
+	 */
+	int encodeHeader(AtkWireMsg* msg, char* header);
+
+	/**
+	 * Decode a frame header.
+	 *
+	 * @param buf The start of the frame.
+	 * @param avail The number of bytes available at <b>buf</b>.
+	 * @param msg The message to receive the header fields.
+	 * @param dataLen Set to the length of the payload.
+	 *
+	 * @return The length of the header is returned; <b>0</b> if the
+	 * header is incomplete and a negative value if it is malformed.
+	 */
+	int decodeHeader(const char* buf, int avail, AtkWireMsg* msg, int* dataLen);
+
+	/**
+	 * Switch the headers of the frames this side sends. An internal
+	 * "WireFraming" message, sent with the old headers, tells the other
+	 * side that the frames behind it use the new ones.
+	 *
+	 * @param compact Non-zero to send compact headers, or zero to send
+	 * the original ones.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+	virtual int switchHeaders(int compact);
+
+	/**
+	 * Write a frame on the lane it belongs to: queue it on the bulk lane,
+	 * or write it and then let some of the bulk lane follow.
+	 */
+	int writeLaneFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers);
+
+	/**
+	 * Copy a frame onto the end of the bulk lane.
+	 */
+	int queueBulkFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers);
+
+	/**
+	 * Write the next fragment of the message at the head of the bulk lane.
+	 * The first fragment's payload is led by the length of the whole.
+	 */
+	int writeBulkFragment();
+
+	/**
+	 * Write bulk fragments while nothing is buffered on the interactive lane.
+	 *
+	 * @param block If zero, write at most ATK_WIRE_BULK_BURST fragments,
+	 * and only while the write descriptor has room; otherwise write the
+	 * whole bulk lane.
+	 *
+	 * @return The number of bulk bytes still pending is returned, or a
+	 * negative value on error.
+	 */
+	long pumpBulk(int block);
+
+	/**
+	 * Write the messages held back for coalescing.
+	 *
+	 * @param block If zero, write them only while the write descriptor
+	 * has room; otherwise write them all.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+	int drainCoalesced(int block);
+
+	/**
+	 * Write what is in the send buffer.
+	 *
+	 * @return The number of bytes still pending is returned, or a negative
+	 * value on error.
+	 */
+	int flushSendBuffer(int block);
+
+	/**
+	 * Wait for a descriptor to have input, writing bulk fragments whenever
+	 * the write descriptor has room in the meantime.
+	 *
+	 * @return <b>1</b> if there is input, <b>0</b> if the timeout expired
+	 * and a negative value on error.
+	 */
+	int waitForFD(int fd, int timeout);
+
+	/**
+	 * Add a received fragment to the bulk message being reassembled.
+	 *
+	 * @return The whole message is returned once its last fragment has
+	 * arrived, otherwise <b>NULL</b>. If the fragment doesn't belong, the
+	 * connection is marked lost.
+	 */
+	AtkWireMsg* collectFragment(AtkWireMsg* msg);
+
+	/**
+	 * Read the next message while waiting for replies: replies are
+	 * stored, synchronous messages are answered and others are queued.
+	 *
+	 * @param wired The object that synchronous messages with no
+	 * destination are delivered to.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the connection
+	 * has been lost, then a negative value will be returned.
+	 */
+	virtual int collectReply(AtkWired* wired);
+
+	/**
+	 * Prepare to wait for replies: write any buffered requests, answer
+	 * queued synchronous messages and store queued replies.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+	int beginWaitForReply(AtkWired* wired);
+
+	/**
+	 * Deliver a synchronous message from the other side, so that its
+	 * reply echoes its correlation ID.
+	 */
+	void deliverSyncMsg(AtkWired* wired, AtkWireMsg* msg);
+
+	/**
+	 * Match a received reply to its request and keep it until it is
+	 * waited for.
+	 */
+	void storeReply(AtkWireMsg* reply);
+
+	/**
+	 * Remove a stored reply.
+	 *
+	 * @param id The ID of the request, or <b>0</b> for the earliest reply.
+	 *
+	 * @return The reply is returned, or <b>NULL</b> if none is stored.
+	 */
+	AtkWireMsg* takeReply(unsigned int id);
+
+	/**
+	 * Write a message frame with its payload passed out-of-band in a
+	 * sealed memfd.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the frame could
+	 * not be written, then a negative value will be returned.
+	 */
+	virtual int writeOOBFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers,
+		int numBuffers);
+
+	/**
+	 * Replace the control payload of an out-of-band message with a
+	 * mapping of the memfd that accompanied it.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+	virtual int mapOOBData(AtkWireMsg* msg);
+
+	/**
+	 * Read as much as is available from the read file descriptor into
+	 * the receive buffer, using a single read.
+	 *
+	 * @return The number of bytes read is returned. <b>0</b> indicates
+	 * end of file and a negative value indicates an error.
+	 */
+	virtual int fillRecvBuffer();
+
+	/**
+	 * Move any partly received frame to the front of the receive buffer.
+	 */
+	void compactRecvBuffer();
+
+	/**
+	 * Decode the next complete message held in the receive buffer,
+	 * skipping internal messages.
+	 *
+	 * @return A pointer to the decoded message is returned, or <b>NULL</b>
+	 * if the buffer does not hold a complete frame.
+	 */
+	virtual AtkWireMsg* decodeMsg();
+
+	/**
+	 * Decode the next complete frame held in the receive buffer, as it
+	 * arrived.
+	 *
+	 * @return A pointer to the decoded message is returned, or <b>NULL</b>
+	 * if the buffer does not hold a complete frame.
+	 */
+	virtual AtkWireMsg* decodeFrame();
+
+	/**
+	 * Read and decode the next complete frame.
+	 *
+	 * @param block If non-zero, wait for data when none is available;
+	 * otherwise return as soon as a read would block.
+	 * @param status If not <b>NULL</b>, set to <b>ATK_WIRE_READ_MSG</b>
+	 * when a message is returned, <b>ATK_WIRE_READ_EMPTY</b> when no
+	 * complete frame is available yet and <b>ATK_WIRE_READ_ERROR</b> when
+	 * the read failed or the connection has been lost.
+	 *
+	 * @return A pointer to the message is returned, or <b>NULL</b> if no
+	 * complete frame is available or the connection has been lost.
+	 */
+	virtual AtkWireMsg* readFrame(int block, int* status = NULL);
+
+	/**
+	 * Continue receiving a frame too large for the receive buffer,
+	 * reading its payload directly into the partial message.
+	 *
+	 * @return <b>1</b> if the frame is complete, <b>0</b> if the read
+	 * would block and a negative value on error.
+	 */
+	virtual int readPartialMsg();
+
+	/**
+	 * Decode every complete frame held in the receive buffer onto the
+	 * message queue.
+	 *
+	 * @return The number of messages queued is returned.
+	 */
+	int queueBufferedMsgs();
+
+	/**
+	 * Append a message to the tail of the message queue.
+	 *
+	 * @param msg The message to queue.
+	 */
+	void queueMsg(AtkWireMsg* msg);
+
+	/**
+	 * Remove the message at the head of the message queue.
+	 *
+	 * @return The message is returned, or <b>NULL</b> if the queue is empty.
+	 */
+	AtkWireMsg* dequeueMsg();
+
 	/** The read file descriptor. */
     int m_readFD;
 	/** The write file descriptor. */
@@ -195,8 +1230,136 @@ class MLE_ATK_API AtkWire
     AtkWireMsg* m_head;
 	/** The tail of the message queue. */
 	AtkWireMsg* m_tail;
-	/** Flag indicating whether network connection is lost. */
-    int m_lostConnection;
+	/** The number of messages on the message queue. */
+	int m_numQueued;
+	/** Flag indicating whether network connection is lost; the reader thread sets it too. */
+    std::atomic<int> m_lostConnection;
+	/** The receive buffer. */
+	char* m_recvBuf;
+	/** The size of the receive buffer, in bytes. */
+	int m_recvBufSize;
+	/** The offset of the first unconsumed byte in the receive buffer. */
+	int m_recvStart;
+	/** The offset one past the last valid byte in the receive buffer. */
+	int m_recvEnd;
+	/** Flag indicating whether the read file descriptor is non-blocking. */
+	int m_nonBlocking;
+	/** A frame too large for the receive buffer that is still arriving. */
+	AtkWireMsg* m_partialMsg;
+	/** The number of payload bytes of the partial frame received so far. */
+	int m_partialLen;
+	/** The payload size at which messages go on the bulk lane; 0 if never. */
+	int m_bulkThreshold;
+	/** The payload size of a bulk message fragment. */
+	int m_fragmentSize;
+	/** The largest payload a received message may claim. */
+	int m_maxMsgSize;
+	/** Flag indicating whether the message being sent must go on the bulk lane. */
+	int m_forceBulk;
+	/** The frames queued on the bulk lane, linked through m_next. */
+	AtkWireMsg* m_bulkHead;
+	/** The last frame queued on the bulk lane. */
+	AtkWireMsg* m_bulkTail;
+	/** The number of payload bytes of the head bulk frame already written. */
+	int m_bulkOffset;
+	/** The number of bulk payload bytes not yet written. */
+	long m_bulkBytes;
+	/** The bulk message being reassembled from fragments, if any. */
+	AtkWireMsg* m_fragMsg;
+	/** The number of its payload bytes received so far. */
+	int m_fragLen;
+	/** The messages held back for coalescing. */
+	AtkWireCoalescedMsg* m_coalesceHead;
+	/** The last message held back for coalescing. */
+	AtkWireCoalescedMsg* m_coalesceTail;
+	/** The number of messages held back for coalescing. */
+	int m_numCoalesced;
+	/** The number of payload bytes of the held messages. */
+	long m_coalescedBytes;
+	/** The number of held messages replaced before being written. */
+	long long m_numSuperseded;
+	/** Flag indicating whether the held messages are being written. */
+	int m_drainingCoalesced;
+	/** Flag indicating whether outbound messages are buffered. */
+	int m_sendBuffering;
+	/** The send buffer. */
+	char* m_sendBuf;
+	/** The size of the send buffer, in bytes. */
+	int m_sendBufSize;
+	/** The offset of the first unwritten byte in the send buffer. */
+	int m_sendStart;
+	/** The offset one past the last buffered byte in the send buffer. */
+	int m_sendEnd;
+	/** The high-water mark of the send buffer, in bytes. */
+	int m_highWaterMark;
+	/** The high-water policy callback. */
+	AtkWireHighWaterCallback m_highWaterCallback;
+	/** The data passed to the high-water policy callback. */
+	void* m_highWaterData;
+	/** The payload size at which messages are passed out-of-band. */
+	int m_oobThreshold;
+	/** Flag indicating whether the read file descriptor is a Unix socket. */
+	int m_readIsSocket;
+	/** Flag indicating whether the write file descriptor is a Unix socket. */
+	int m_writeIsSocket;
+	/** Descriptors received for out-of-band frames, in arrival order. */
+	AtkWireFDArray m_passedFDs;
+	/** The payload size at which messages are compressed. */
+	int m_compressThreshold;
+	/** The capabilities the other side has announced. */
+	int m_peerCaps;
+	/** Flag indicating whether this side has announced its capabilities. */
+	int m_sentOptions;
+	/** The compression counters. */
+	AtkWireCompressionStats m_compressionStats;
+	/** The ID given to the next request. */
+	unsigned int m_nextCorrelationID;
+	/** The ID the next reply echoes; that of the request being handled. */
+	unsigned int m_replyCorrelationID;
+	/** The batch that replies are collected into; NULL if they are written. */
+	AtkWireBatch* m_replyBatch;
+	/** The number of nested deliveries of synchronous messages. */
+	int m_syncDeliveryDepth;
+	/** The IDs of requests whose replies have not arrived, in send order. */
+	AtkWireIDArray m_pendingIDs;
+	/** The head of the list of replies that have not been waited for. */
+	AtkWireMsg* m_replyHead;
+	/** The tail of the list of replies that have not been waited for. */
+	AtkWireMsg* m_replyTail;
+	/** The background reader thread, if one is running. */
+	std::thread* m_readerThread;
+	/** The messages the reader thread has decoded. */
+	AtkWireMsgQueue* m_readerQueue;
+	/** The pipe the reader thread signals the receiving thread on. */
+	int m_readerNotifyFD[2];
+	/** The pipe used to wake the reader thread so that it stops. */
+	int m_readerWakeFD[2];
+	/** The read file descriptor flags to restore when the reader stops. */
+	int m_readerSavedFlags;
+	/** Flag asking the reader thread to stop. */
+	std::atomic<int> m_readerStop;
+	/** Flag set by the reader thread once it has stopped reading. */
+	std::atomic<int> m_readerDone;
+	/** Flag indicating whether a signal is outstanding on the notify pipe. */
+	std::atomic<int> m_readerNotified;
+	/** The wire protocol version the other side has announced. */
+	int m_peerVersion;
+	/** Flag indicating whether compact headers are wanted. */
+	int m_compactHeaders;
+	/** Flag indicating whether frames are sent with compact headers. */
+	int m_sendCompact;
+	/** Flag indicating whether frames arrive with compact headers. */
+	int m_recvCompact;
+	/** The IDs of the message names this side sends. */
+	AtkWireNameTable m_sendNames;
+	/** The IDs of the message names the other side sends. */
+	AtkWireNameTable m_recvNames;
+	/** The recorder of the messages crossing the wire, if any. */
+	AtkWireRecorder* m_recorder;
+	/** The message counters. */
+	AtkWireStats m_stats;
+	/** Whether messages are being counted. */
+	std::atomic<int> m_statsEnabled;
 };
 
 #endif /* __ATK_WIRE_H_ */
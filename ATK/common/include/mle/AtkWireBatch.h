@@ -0,0 +1,179 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireBatch.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that packs many messages into the payload
+ * of one.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIREBATCH_H_
+#define __ATK_WIREBATCH_H_
+
+#include <mle/mleatk_rehearsal.h>
+#include <mle/AtkWire.h>
+
+/** The name of a message whose payload holds other messages. */
+#define ATK_WIRE_BATCH_MSG_NAME "Batch"
+
+class AtkWireMsg;
+
+/**
+ * This class packs a sequence of messages into the payload of a single
+ * "Batch" message, so that a long run of small commands costs one frame
+ * and one dispatch on the other side.
+ *
+ * Each member is laid out as whether it waits for a reply (an int), its
+ * name (a string) and the length of its payload (an int), followed by
+ * the payload itself. The members of a batch all go to the batch's
+ * destination, and are delivered in order by <b>AtkWired::deliverMsg()</b>.
+ *
+ * If any member waits for a reply the batch does too, and is sent with
+ * <b>AtkWire::sendSyncMsg()</b>. The other side then answers with one
+ * reply whose payload is itself packed like a batch: a "Reply" member for
+ * each reply the members sent, in order, with an empty one for a member
+ * that waited but wasn't answered. A batch none of whose members wait
+ * gets no reply.
+ */
+class MLE_ATK_API AtkWireBatch
+{
+  public:
+
+    /**
+	 * The constructor.
+	 *
+	 * @param destObj The object to send the batch to.
+	 * @param msgName The name of the batch message.
+	 */
+    AtkWireBatch(void* destObj = 0, const char* msgName = ATK_WIRE_BATCH_MSG_NAME);
+
+    /**
+	 * The destructor.
+	 */
+    ~AtkWireBatch();
+
+    /**
+	 * Add a message to the batch; its name, payload and whether it waits
+	 * for a reply are copied.
+	 *
+	 * @param msg The message to add.
+	 */
+    void add(AtkWireMsg* msg);
+
+    /**
+	 * Add a message to the batch.
+	 *
+	 * @param msgName The name of the message.
+	 * @param msgData The payload of the message.
+	 * @param msgDataLen The length of the payload, in bytes.
+	 * @param waitForReply Whether the message waits for a reply.
+	 */
+    void add(const char* msgName, const void* msgData, int msgDataLen,
+		int waitForReply = 0);
+
+    /**
+	 * Add a message whose payload is gathered from several buffers.
+	 *
+	 * @param msgName The name of the message.
+	 * @param buffers The payload regions, in order.
+	 * @param numBuffers The number of regions.
+	 * @param waitForReply Whether the message waits for a reply.
+	 */
+    void addBuffers(const char* msgName, const AtkWireBuffer* buffers, int numBuffers,
+		int waitForReply = 0);
+
+    /**
+	 * Get the number of messages in the batch.
+	 */
+    int getNumMsgs() { return m_numMsgs; }
+
+    /**
+	 * Get the number of messages in the batch that wait for a reply.
+	 */
+    int getNumSyncMsgs() { return m_numSyncMsgs; }
+
+    /**
+	 * Get the batch message, which waits for a reply if any of its
+	 * members do. It belongs to the batch and stays valid until the batch
+	 * is cleared or deleted.
+	 */
+    AtkWireMsg* getMsg() { return m_msg; }
+
+    /**
+	 * Empty the batch, keeping its buffer for the next messages.
+	 */
+    void clear();
+
+    /**
+	 * Read the next member of a batch message from its current parameter
+	 * on. The member borrows the batch's payload, so it is valid only as
+	 * long as the batch message is.
+	 *
+	 * @param batch The batch message.
+	 * @param msg Set to the member's destination, name, payload and
+	 * whether it waits for a reply.
+	 *
+	 * @return 1 is returned if a member was read, 0 if there are no more,
+	 * and -1 if the rest of the batch is malformed.
+	 */
+    static int getNext(AtkWireMsg* batch, AtkWireMsg* msg);
+
+	/**
+	 * Override operator new.
+	 *
+	 * @param tSize The size, in bytes, to allocate.
+	 */
+	void* operator new(size_t tSize);
+
+	/**
+	 * Override operator delete.
+	 *
+	 * @param p A pointer to the memory to delete.
+	 */
+    void  operator delete(void *p);
+
+  protected:
+
+	/** The batch message. */
+    AtkWireMsg* m_msg;
+	/** The number of messages in the batch. */
+    int m_numMsgs;
+	/** The number of those that wait for a reply. */
+    int m_numSyncMsgs;
+};
+
+#endif /* __ATK_WIREBATCH_H_ */
@@ -0,0 +1,98 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireCompressor.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that provides a fast block compressor for
+ * message payloads.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIRECOMPRESSOR_H_
+#define __ATK_WIRECOMPRESSOR_H_
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+
+/**
+ * This class compresses and decompresses blocks of bytes.
+ *
+ * The format is a simple LZ77 variant in the style of LZF: a stream of
+ * literal runs of up to 32 bytes and back references of 3 to 264 bytes
+ * within the previous 8 KB.  It favours speed over ratio, which suits
+ * the repetitive text of workprints.
+ */
+class MLE_ATK_API AtkWireCompressor
+{
+  public:
+
+    /**
+	 * Get the largest size a block can compress to.
+	 *
+	 * @param length The length of the uncompressed block, in bytes.
+	 *
+	 * @return The bound, in bytes, is returned.
+	 */
+    static int getMaxCompressedLength(int length);
+
+    /**
+	 * Compress a block.
+	 *
+	 * @param in The block to compress.
+	 * @param inLength The length of the block, in bytes.
+	 * @param out The buffer to receive the compressed block.
+	 * @param outLength The size of the buffer, in bytes.
+	 *
+	 * @return The length of the compressed block is returned, or <b>0</b>
+	 * if it does not fit in the buffer.
+	 */
+    static int compress(const void* in, int inLength, void* out, int outLength);
+
+    /**
+	 * Decompress a block.
+	 *
+	 * @param in The compressed block.
+	 * @param inLength The length of the compressed block, in bytes.
+	 * @param out The buffer to receive the decompressed block.
+	 * @param outLength The size of the buffer, in bytes.
+	 *
+	 * @return The length of the decompressed block is returned, or a
+	 * negative value if the block is corrupt or does not fit in the buffer.
+	 */
+    static int decompress(const void* in, int inLength, void* out, int outLength);
+};
+
+#endif /* __ATK_WIRECOMPRESSOR_H_ */
@@ -46,6 +46,10 @@
 
 // Include Authoring Toolkit header fiels.
 #include <mle/AtkBasicArray.h>
+#include <mle/AtkWireNameTable.h>
+
+// The name of the wire func DSO index in the DSO directory.
+#define ATK_WIREFUNC_INDEX_NAME "wirefuncs.idx"
 
 // Declare classes.
 class AtkWired;
@@ -82,48 +86,58 @@ class CLASS : public AtkWireFunc {                       \
 	virtual AtkWireMsg* recvMsg(AtkWired*, AtkWireMsg*); \
 };
 
+// The SOURCE macros also register the class by way of a static
+// AtkWireFuncRegistrar, so that it is known as soon as the program or
+// the DSO holding it is loaded.
+
 #define ATK_WIREFUNC_SOURCE(CLASS, NAME)          \
-    CLASS##::CLASS##() { name = NAME; }           \
+    CLASS::CLASS() { m_name = (char*) NAME; }     \
                                                   \
-    AtkWireFunc* CLASS##::createObj()             \
+    AtkWireFunc* CLASS::createObj()               \
 	{                                             \
 		return(new CLASS);                        \
 	}                                             \
 					                              \
-    void CLASS##::initClass(void)                 \
+    void CLASS::initClass(void)                   \
 	{                                             \
 		AtkWireFunc::addToArray(NAME, createObj); \
-    }
+    }                                             \
+                                                  \
+    static AtkWireFuncRegistrar CLASS##Registrar(NAME, CLASS::createObj);
 
 #define ATK_WIREFUNC_SYNC_SOURCE(CLASS, NAME)     \
-    CLASS##::CLASS##()                            \
+    CLASS::CLASS()                                \
 	{                                             \
-		m_name = NAME;                            \
+		m_name = (char*) NAME;                    \
 		m_sendSynced = 1;                         \
 	}                                             \
 					                              \
-    AtkWireFunc* CLASS##::createObj()             \
+    AtkWireFunc* CLASS::createObj()               \
 	{                                             \
 		return(new CLASS);                        \
 	}                                             \
 					                              \
-    void CLASS##::initClass(void)                 \
+    void CLASS::initClass(void)                   \
 	{                                             \
 		AtkWireFunc::addToArray(NAME, createObj); \
-    }
+    }                                             \
+                                                  \
+    static AtkWireFuncRegistrar CLASS##Registrar(NAME, CLASS::createObj);
 
 #define ATK_WIREFUNC_RECV_SOURCE(CLASS, NAME)         \
-    CLASS##::CLASS##() { name = NAME; }               \
+    CLASS::CLASS() { m_name = (char*) NAME; }         \
                                                       \
-    AtkWireFunc* CLASS##::createObj()                 \
+    AtkWireFunc* CLASS::createObj()                   \
 	{                                                 \
 	    return(new CLASS);                            \
 	}                                                 \
 					                                  \
-    void CLASS##::initClass(void)                     \
+    void CLASS::initClass(void)                       \
 	{                                                 \
 	    AtkWireFunc::addToRecvArray(NAME, createObj); \
-    }
+    }                                                 \
+                                                      \
+    static AtkWireFuncRegistrar CLASS##Registrar(NAME, CLASS::createObj, 1);
 
 
 
@@ -135,10 +149,103 @@ struct AtkCreateWireFunc
 {
     char* name;
     AtkCreateFunc createFunc;
+    // The hash of the name, from atkHashString().
+    unsigned int hash;
+    // The instance find() hands out, made the first time it is asked for.
+    AtkWireFunc* instance;
 };
 
 MLE_DECLARE_ARRAY(AtkCreateWireFuncArray, AtkCreateWireFunc*);
 
+/**
+ * This class is a hash table of values keyed by name, used to look up
+ * wire funcs in constant time.
+ *
+ * Slots are open addressed and keep the hash of their name, so that a
+ * lookup compares strings only when the hashes match. The table holds
+ * on to the names it is given rather than copying them.
+ *
+ * Its constructor is constant, so that a static table is ready before
+ * any static initializer uses it.
+ */
+class MLE_ATK_API AtkWireFuncTable
+{
+  public:
+
+    constexpr AtkWireFuncTable() : m_slots(0), m_slotMask(-1), m_count(0) {}
+
+    ~AtkWireFuncTable();
+
+    /**
+	 * Find the value for a name.
+	 *
+	 * @param name The name.
+	 * @param hash The hash of the name, from <b>atkHashString()</b>.
+	 *
+	 * @return The value is returned, or <b>NULL</b> if the name isn't in
+	 * the table.
+	 */
+    void* find(const char* name, unsigned int hash);
+
+    /**
+	 * Set the value for a name, replacing any it had.
+	 *
+	 * @param name The name, which must stay valid while it is in the table.
+	 * @param hash The hash of the name, from <b>atkHashString()</b>.
+	 * @param value The value.
+	 *
+	 * @return The value the name had is returned, or <b>NULL</b> if it
+	 * had none.
+	 */
+    void* set(const char* name, unsigned int hash, void* value);
+
+    /**
+	 * Remove every name from the table.
+	 */
+    void clear();
+
+    /**
+	 * Get the number of names in the table.
+	 */
+    int getCount() { return m_count; }
+
+    /**
+	 * Get the number of slots, for walking the table with <b>getValue()</b>.
+	 */
+    int getNumSlots() { return m_slotMask + 1; }
+
+    /**
+	 * Get the value in a slot, or <b>NULL</b> if the slot is empty.
+	 */
+    void* getValue(int slot) { return m_slots[slot].m_value; }
+
+  protected:
+
+    struct Slot
+	{
+		unsigned int m_hash;
+		const char* m_name;
+		void* m_value;
+    };
+
+	/**
+	 * Get the slot that holds, or would hold, a name.
+	 */
+	int findSlot(const char* name, unsigned int hash);
+
+	/**
+	 * Double the number of slots.
+	 */
+	void grow();
+
+	/** The slots; NULL until the first name is set. */
+	Slot* m_slots;
+	/** The number of slots less one; the count is a power of two. */
+	int m_slotMask;
+	/** The number of slots in use. */
+	int m_count;
+};
+
 
 typedef void (*RecvCallback)(void*, AtkWireMsg*);
 
@@ -147,12 +254,17 @@ class AtkWireFunc
   public:
     // Constructor/Destructor
     AtkWireFunc();
-    ~AtkWireFunc();
+    virtual ~AtkWireFunc();
 
-    // Find wire func from list.
+    // Find wire func from list; every lookup of a name gets the same
+    // instance.
     static AtkWireFunc* find(const char* name, int fRecv = 0);
     static AtkWireFunc* findInArray(const char* name, int fRecv);
 
+    // Create a new instance of a wire func, loading it if need be, for
+    // a caller that keeps its own; NULL if there is no such wire func.
+    static AtkWireFunc* create(const char* name, int fRecv = 0);
+
     static AtkWireFunc* findRecv(const char* name);
 
     // Adding to array.
@@ -181,6 +293,39 @@ class AtkWireFunc
     // Printing wirefuncs.
     static void printWireFuncs(int recv=0);
 
+    // The directory wire func DSOs are loaded from; MLE_ATK_WIREFUNC_PATH
+    // overrides the default.
+    static const char* getDsoPath();
+
+    // Write an index of the wire func DSOs in dsoPath, one "name path"
+    // line each, to indexPath; the defaults are getDsoPath() and the
+    // ATK_WIREFUNC_INDEX_NAME file in it.  Returns the number of DSOs
+    // indexed, or -1 on error.
+    static int writeIndex(const char* indexPath = NULL, const char* dsoPath = NULL);
+
+    // Read an index written by writeIndex(), so that wire funcs are
+    // loaded from the DSOs it names.  Returns the number of DSOs read, or
+    // -1 if the index can't be read.
+    static int readIndex(const char* indexPath = NULL);
+
+    // Load and register every wire func in the index, or in getDsoPath()
+    // if there is no index, so that none is loaded on first use.  With
+    // background set the loading is done on a thread and this returns at
+    // once.  Returns the number of DSOs to load, or -1 on error.
+    static int preload(const char* indexPath = NULL, int background = 1);
+
+    // Wait for a background preload to finish.
+    static void waitForPreload();
+
+    // A count that changes whenever a wire func is registered or a
+    // preload finishes, so that a caller remembering that a name had no
+    // wire func knows when to look again.
+    static unsigned int getGeneration();
+
+    // Print how long each DSO and the preload as a whole take to load;
+    // MLE_ATK_WIREFUNC_TIMING turns this on.
+    static void setLoadTiming(int enable);
+
 	/**
 	 * Override operator new.
 	 *
@@ -217,10 +362,40 @@ class AtkWireFunc
     char* m_name;
     int m_sendSynced;
 
-    // Add a function to list.
-    // Array of create funcs.
-    static AtkCreateWireFuncArray g_wireFuncs;
-    static AtkCreateWireFuncArray g_recvWireFuncs;
+    // Find the entry for a name, loading its DSO if need be.
+    static AtkCreateWireFunc* findEntry(const char* name, int fRecv);
+
+    // Load the DSO for a wire func and initialize its class.
+    static int loadDso(const char* name, const char* path);
+
+    // Add the wire func DSOs in a directory to the index.
+    static int indexDsos(const char* dsoPath);
+
+    // Load every DSO in the index that isn't loaded yet.
+    static void preloadAll();
+
+    // Add a function to a table.
+    static void addToTable(AtkWireFuncTable& table, const char* name,
+		AtkCreateFunc createFunc);
+
+    // Tables of create funcs, keyed by name.
+    static AtkWireFuncTable g_wireFuncs;
+    static AtkWireFuncTable g_recvWireFuncs;
+};
+
+/**
+ * Registers a wire func class as it is constructed; the SOURCE macros
+ * declare a static one for each class.
+ */
+class AtkWireFuncRegistrar
+{
+  public:
+
+    AtkWireFuncRegistrar(const char* name, AtkCreateFunc createFunc, int fRecv = 0)
+	{
+		if (fRecv) AtkWireFunc::addToRecvArray(name, createFunc);
+		else AtkWireFunc::addToArray(name, createFunc);
+	}
 };
 
 #endif /* __ATK_WIREFUNC_H_ */
@@ -43,6 +43,9 @@
 #ifndef __ATK_WIREMSG_H_
 #define __ATK_WIREMSG_H_
 
+// Include system header files.
+#include <stdint.h>
+
 // Include Magic Lantern header files.
 #include <mle/mleatk_rehearsal.h>
 
@@ -50,6 +53,25 @@
 
 #define REPLY_MSG_NAME "Reply"
 
+// The last byte of the name field carries frame flags.  Peers that don't
+// know about flags always send it as zero, since it terminates the name.
+#define ATK_WIRE_MSG_FLAGS_INDEX (MAX_MSG_NAME_LEN - 1)
+
+// The payload was passed out-of-band as a memfd.
+#define ATK_WIRE_MSG_FLAG_OOB 0x01
+// The payload is compressed.
+#define ATK_WIRE_MSG_FLAG_COMPRESSED 0x02
+// The payload is followed by a correlation ID.
+#define ATK_WIRE_MSG_FLAG_CORRELATED 0x04
+// The payload is one fragment of a bulk message.
+#define ATK_WIRE_MSG_FLAG_FRAGMENT 0x08
+
+// How the message data is held.
+#define ATK_WIRE_MSG_DATA_OWNED    0
+#define ATK_WIRE_MSG_DATA_BORROWED 1
+#define ATK_WIRE_MSG_DATA_MAPPED   2
+#define ATK_WIRE_MSG_DATA_POOLED   3
+
 class MlTransform;
 
 
@@ -67,11 +89,18 @@ class MLE_ATK_API AtkWireMsg
 
     virtual void setDestObj(void* destObj);
 
+    // The destination is the handle of a wired, carried in m_destObj;
+    // see AtkWired::getHandle().
+    unsigned int getDestHandle() { return (unsigned int) (uintptr_t) m_destObj; }
+
     // Getting start address and length
     virtual void* getStartAddress();
 
     virtual int getHeaderLength();
 
+    // The length of the header of every frame on the wire.
+    static int getFrameHeaderLength();
+
     virtual int getDataLength();
 
     // alloc buffer and copy data
@@ -79,6 +108,59 @@ class MLE_ATK_API AtkWireMsg
 
     virtual void setMsgData(void* msgData, int msgDataLen);
 
+    // Borrow caller owned data as the payload without copying it; the
+    // data must remain valid for as long as the message uses it.
+    virtual void setMsgDataRef(void* msgData, int msgDataLen);
+
+    int isMsgDataBorrowed() { return (m_dataOwnership == ATK_WIRE_MSG_DATA_BORROWED); }
+
+    // Take ownership of a mapping as the payload; it is unmapped when
+    // the message is done with it.
+    virtual void setMsgDataMapped(void* msgData, int msgDataLen);
+
+    int getMsgDataOwnership() { return m_dataOwnership; }
+
+    // Take ownership of a buffer allocated with mlMalloc() as the payload.
+    virtual void adoptMsgData(void* msgData, int msgDataLen);
+
+    // Take ownership of a buffer allocated with AtkWirePool::alloc() as
+    // the payload.
+    virtual void adoptPooledMsgData(void* msgData, int msgDataLen);
+
+    // Drop the end of the payload so that msgDataLen bytes remain.
+    virtual void truncateMsgData(int msgDataLen);
+
+    // Make room for a payload of msgDataLen bytes in all, so that adding
+    // parameters up to that size doesn't grow the buffer again.
+    virtual void reserveMsgData(int msgDataLen);
+
+    // The payload size the buffer has room for without growing.
+    int getMsgDataCapacity() { return m_dataCapacity; }
+
+    // Empty the payload, keeping the buffer for the next parameters.
+    virtual void clearMsgData();
+
+    // Make the message a new, empty one, keeping the payload buffer, so
+    // that one message can be built and sent over and over.
+    virtual void reset(void* destObj = 0, const char* msgName = 0, int waitForReply = 0);
+
+    // Frame flags; a name that is sent with flags must be no longer than
+    // MAX_MSG_NAME_LEN - 2 characters.
+    int getMsgFlags() { return (unsigned char) m_msgName[ATK_WIRE_MSG_FLAGS_INDEX]; }
+
+    void setMsgFlags(int flags);
+
+    // The ID that pairs a request with its reply; 0 if there is none.
+    unsigned int getCorrelationID() { return m_correlationID; }
+
+    void setCorrelationID(unsigned int id) { m_correlationID = id; }
+
+    // When the message came off the wire, from AtkWireStats::now(); 0 if
+    // it didn't or the wire isn't collecting stats.
+    long long getRecvTime() { return m_recvTime; }
+
+    void setRecvTime(long long time) { m_recvTime = time; }
+
     // a  or sync message reply msg
     // Note: naming a little confusing - a reply message is something the 
     // other side sends to you as a result of a sync message, a sync message
@@ -119,8 +201,24 @@ class MLE_ATK_API AtkWireMsg
 
     virtual int getParam(float f[3]);
 
+    // Views of the parameters in place; nothing is copied, and the views
+    // are valid for as long as the message keeps its data.  Each returns
+    // the length of the parameter, or -1 if the rest of the message
+    // doesn't hold one.
+
+    // A string, without its terminator in the length.
+    virtual int getParamView(const char* &s);
+
+    // Data added with addParam(void*, int).
+    virtual int getParamView(const void* &data);
+
+    // A string array added with addParam(const char**); strs points at the
+    // first string, each follows the one before and an empty one ends
+    // them.  The number of strings is returned.
+    virtual int getParamArrayView(const char* &strs);
+
 	/**
-	 * Override operator new.
+	 * Override operator new; messages come from the wire pool.
 	 *
 	 * @param tSize The size, in bytes, to allocate.
 	 */
@@ -158,7 +256,7 @@ class MLE_ATK_API AtkWireMsg
     int m_totalMsgLen;
 	/** The name of the message. */
     char m_msgName[MAX_MSG_NAME_LEN];
-	/** The object to send the message to. */
+	/** The handle of the object to send the message to; 0 for the receiver. */
     void* m_destObj;
 	/** Flag indicating whether to wait for the reply. */
     char m_waitForReply;
@@ -168,6 +266,34 @@ class MLE_ATK_API AtkWireMsg
     AtkWireMsg* m_next;
 	/** The current parameter offset. */
     int m_curParamOffset;
+	/** How the message data is held; one of the ATK_WIRE_MSG_DATA_* values. */
+    char m_dataOwnership;
+	/** The ID that pairs a request with its reply. */
+    unsigned int m_correlationID;
+	/** When the message was received, in nanoseconds; 0 if unknown. */
+    long long m_recvTime;
+
+  protected:
+
+    // Schemas and batches write straight into the message data.
+    template <typename Name, typename... Fields> friend class AtkMsgSchema;
+    friend class AtkWireBatch;
+
+    // Grow the message data by len bytes and return a pointer to the
+    // newly appended region; data that isn't owned is copied first.
+    void* extendMsgData(int len);
+
+    // Make the owned buffer hold at least len payload bytes, growing it
+    // geometrically so that appending is amortized constant time.
+    void growMsgData(int len);
+
+    // Release the message data, unmapping it if it is a mapping.
+    void freeMsgData();
+
+	/** The length of the mapping, when the message data is mapped. */
+    int m_mappedLen;
+	/** The size of the owned message data buffer; 0 if it isn't owned. */
+    int m_dataCapacity;
 };
 
 #endif /* __ATK_WIREMSG_H_ */
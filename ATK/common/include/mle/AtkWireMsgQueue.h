@@ -0,0 +1,142 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireMsgQueue.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that provides a lock-free queue for handing
+ * messages from one thread to another.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIREMSGQUEUE_H_
+#define __ATK_WIREMSGQUEUE_H_
+
+// Include system header files.
+#include <atomic>
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+
+// Declare classes.
+class AtkWireMsg;
+
+/** The size of a cache line, in bytes. */
+#define ATK_WIRE_CACHE_LINE_SIZE 64
+
+/**
+ * This class is a bounded, lock-free queue of messages with a single
+ * producer thread and a single consumer thread.
+ *
+ * Each index is written by only one of the threads and lives on its own
+ * cache line, so neither thread ever waits on the other.
+ */
+class MLE_ATK_API AtkWireMsgQueue
+{
+  public:
+
+    /**
+	 * A constructor that specifies the capacity.
+	 *
+	 * @param capacity The most messages the queue holds; it is rounded
+	 * up to a power of two.
+	 */
+    AtkWireMsgQueue(int capacity);
+
+    /**
+	 * The destructor; messages still queued are deleted.
+	 */
+    virtual ~AtkWireMsgQueue();
+
+    /**
+	 * Append a message; called by the producer only.
+	 *
+	 * @param msg The message to append.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the queue is
+	 * full, then <b>-1</b> will be returned.
+	 */
+    int push(AtkWireMsg* msg);
+
+    /**
+	 * Remove the oldest message; called by the consumer only.
+	 *
+	 * @return The message is returned, or <b>NULL</b> if the queue is empty.
+	 */
+    AtkWireMsg* pop();
+
+    /**
+	 * Get the number of queued messages, from either thread.
+	 */
+    int getCount()
+	{
+		return (int) (m_tail.load(std::memory_order_acquire) -
+			m_head.load(std::memory_order_acquire));
+	}
+
+    /**
+	 * Get the most messages the queue holds.
+	 */
+    int getCapacity() { return m_mask + 1; }
+
+	/**
+	 * Override operator new.
+	 *
+	 * @param tSize The size, in bytes, to allocate.
+	 */
+	void* operator new(size_t tSize);
+
+	/**
+	 * Override operator delete.
+	 *
+	 * @param p A pointer to the memory to delete.
+	 */
+    void  operator delete(void *p);
+
+  protected:
+
+	/** The message slots. */
+	AtkWireMsg** m_slots;
+	/** The number of slots less one. */
+	int m_mask;
+	/** The index of the next message to pop; written by the consumer. */
+	alignas(ATK_WIRE_CACHE_LINE_SIZE) std::atomic<unsigned int> m_head;
+	/** The index of the next slot to push into; written by the producer. */
+	alignas(ATK_WIRE_CACHE_LINE_SIZE) std::atomic<unsigned int> m_tail;
+	/** Keeps the producer index off the line of whatever follows. */
+	char m_pad[ATK_WIRE_CACHE_LINE_SIZE - sizeof(std::atomic<unsigned int>)];
+};
+
+#endif /* __ATK_WIREMSGQUEUE_H_ */
@@ -0,0 +1,162 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireNameTable.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that maps message names to compact numeric
+ * IDs.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIRENAMETABLE_H_
+#define __ATK_WIRENAMETABLE_H_
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+#include <mle/AtkWireMsg.h>
+
+/** The largest name ID; IDs run from 1, and 0 means no ID. */
+#define ATK_WIRE_MAX_NAME_ID 0xFFFF
+
+/**
+ * Hash a string with 32-bit FNV-1a.
+ *
+ * @param s The string to hash.
+ *
+ * @return The hash is returned.
+ */
+MLE_ATK_API unsigned int atkHashString(const char* s);
+
+/**
+ * This class maps message names to the IDs that stand in for them on a
+ * wire using compact headers.
+ *
+ * The sending side interns names, handing out IDs in order of first use;
+ * the receiving side defines each ID as its name first arrives. Lookups
+ * in either direction take constant time.
+ */
+class MLE_ATK_API AtkWireNameTable
+{
+  public:
+
+    AtkWireNameTable();
+
+    virtual ~AtkWireNameTable();
+
+    /**
+	 * Get the ID of a name, giving it the next ID if it has none.
+	 *
+	 * @param name The name.
+	 * @param added Set to non-zero if the name was given an ID by this call.
+	 *
+	 * @return The ID is returned, or <b>0</b> if the table is full.
+	 */
+    int intern(const char* name, int* added);
+
+    /**
+	 * Get the ID of a name.
+	 *
+	 * @return The ID is returned, or <b>0</b> if the name has none.
+	 */
+    int find(const char* name);
+
+    /**
+	 * Give a name the ID the other side chose for it.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the ID is out of
+	 * range, then <b>-1</b> will be returned.
+	 */
+    int define(int id, const char* name);
+
+    /**
+	 * Get the name with an ID.
+	 *
+	 * @return The name is returned, or <b>NULL</b> if the ID is not defined.
+	 */
+    const char* lookup(int id)
+	{
+		return (id > 0 && id <= m_numNames && m_names[id - 1][0]) ? m_names[id - 1] : NULL;
+	}
+
+    /**
+	 * Get the number of IDs handed out or defined.
+	 */
+    int getCount() { return m_numNames; }
+
+    /**
+	 * Forget every name.
+	 */
+    void clear();
+
+	/**
+	 * Override operator new.
+	 *
+	 * @param tSize The size, in bytes, to allocate.
+	 */
+	void* operator new(size_t tSize);
+
+	/**
+	 * Override operator delete.
+	 *
+	 * @param p A pointer to the memory to delete.
+	 */
+    void  operator delete(void *p);
+
+  protected:
+
+	/**
+	 * Get the hash slot that holds, or would hold, a name.
+	 */
+	int findSlot(const char* name, unsigned int hash);
+
+	/**
+	 * Rebuild the hash slots with room for at least <b>count</b> names.
+	 */
+	void rehash(int count);
+
+	/** The names, indexed by ID less one. */
+	char (*m_names)[MAX_MSG_NAME_LEN];
+	/** The number of entries in <b>m_names</b> in use. */
+	int m_numNames;
+	/** The number of entries <b>m_names</b> has room for. */
+	int m_maxNames;
+	/** The hash slots, each holding an ID or 0 if empty. */
+	unsigned short* m_slots;
+	/** The number of hash slots less one; the count is a power of two. */
+	int m_slotMask;
+};
+
+#endif /* __ATK_WIRENAMETABLE_H_ */
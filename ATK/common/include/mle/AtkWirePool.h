@@ -0,0 +1,138 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWirePool.h
+ * @ingroup MleATK
+ *
+ * This file contains a size-classed pool for wire messages and their
+ * payload buffers.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIREPOOL_H_
+#define __ATK_WIREPOOL_H_
+
+// Include system header files.
+#include <stddef.h>
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+
+/** The number of block size classes; the smallest block is 32 bytes. */
+#define ATK_WIRE_POOL_NUM_CLASSES 12
+/** The largest block kept by the pool; larger ones come from the heap. */
+#define ATK_WIRE_POOL_MAX_BLOCK (32 << (ATK_WIRE_POOL_NUM_CLASSES - 1))
+/** The most bytes of free blocks each size class keeps for reuse. */
+#define ATK_WIRE_POOL_CLASS_BYTES (1 << 20)
+
+/**
+ * Counters for the wire pool.
+ */
+struct AtkWirePoolStats
+{
+    /** The number of blocks handed out. */
+    long long m_allocs;
+    /** The number of those that reused a free block. */
+    long long m_reused;
+    /** The number of blocks that had to come from the heap. */
+    long long m_heapAllocs;
+    /** The number of bytes in free blocks kept for reuse. */
+    long long m_freeBytes;
+};
+
+/**
+ * This class recycles the memory of wire messages and their payloads.
+ *
+ * Blocks are rounded up to a power of two size class, and a released
+ * block is kept on its class's free list for the next request of that
+ * class, so that steady traffic runs without touching the heap. Each
+ * class keeps at most ATK_WIRE_POOL_CLASS_BYTES of free blocks, and
+ * blocks larger than ATK_WIRE_POOL_MAX_BLOCK are not kept at all.
+ *
+ * The pool is shared by all wires, since a message may be allocated on
+ * one thread or wire and deleted on another. Each class's free list is
+ * guarded by its own spin lock.
+ */
+class MLE_ATK_API AtkWirePool
+{
+  public:
+
+    /**
+	 * Allocate a block.
+	 *
+	 * @param size The size, in bytes, to allocate.
+	 *
+	 * @return A pointer to the block is returned.
+	 */
+    static void* alloc(size_t size);
+
+    /**
+	 * Release a block from <b>alloc()</b> or <b>resize()</b>.
+	 *
+	 * @param p A pointer to the block, or NULL.
+	 */
+    static void release(void* p);
+
+    /**
+	 * Resize a block, keeping its contents. A block with room for the
+	 * new size is returned as is.
+	 *
+	 * @param p A pointer to the block, or NULL to allocate one.
+	 * @param size The size, in bytes, needed.
+	 *
+	 * @return A pointer to the resized block is returned.
+	 */
+    static void* resize(void* p, size_t size);
+
+    /**
+	 * Get the number of bytes a block has room for, which may be more
+	 * than was asked for.
+	 */
+    static size_t getCapacity(void* p);
+
+    /**
+	 * Return every free block to the heap.
+	 */
+    static void trim();
+
+    /**
+	 * Get the pool's counters.
+	 *
+	 * @param stats The structure to fill in.
+	 */
+    static void getStats(AtkWirePoolStats* stats);
+};
+
+#endif /* __ATK_WIREPOOL_H_ */
@@ -0,0 +1,206 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireRecorder.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that records the messages crossing a wire
+ * to a log, for replay.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIRERECORDER_H_
+#define __ATK_WIRERECORDER_H_
+
+// Include system header files.
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+#include <mle/AtkWire.h>
+
+// Declare classes.
+class AtkWireMsg;
+
+/** The magic number that starts a wire log. */
+#define ATK_WIRE_LOG_MAGIC "MLEWLOG"
+/** The version of the wire log format. */
+#define ATK_WIRE_LOG_VERSION 1
+
+/** A record of a message that was received. */
+#define ATK_WIRE_LOG_RECV 0
+/** A record of a message that was sent. */
+#define ATK_WIRE_LOG_SEND 1
+
+/**
+ * The header of a wire log.
+ */
+struct AtkWireLogHeader
+{
+    /** The magic number, ATK_WIRE_LOG_MAGIC. */
+    char m_magic[8];
+    /** The version of the format, ATK_WIRE_LOG_VERSION. */
+    int m_version;
+    /** Unused; zero. */
+    int m_reserved;
+};
+
+/**
+ * The header of a record in a wire log. It is followed by the message
+ * name, without a terminator, and the message data, padded so that the
+ * next record starts on an eight byte boundary. Logs are written in the
+ * byte order of the host, so that a mapped log can be read in place.
+ */
+struct AtkWireLogRecord
+{
+    /** The time of the record, in nanoseconds since recording started. */
+    int64_t m_time;
+    /** The object the message was sent to. */
+    uint64_t m_destObj;
+    /** The length of the message data, in bytes. */
+    int m_dataLength;
+    /** ATK_WIRE_LOG_RECV or ATK_WIRE_LOG_SEND. */
+    unsigned char m_direction;
+    /** Non-zero if the sender waited for a reply. */
+    unsigned char m_sync;
+    /** The length of the message name, in bytes. */
+    unsigned char m_nameLength;
+    /** Unused; zero. */
+    unsigned char m_reserved;
+};
+
+/**
+ * Get the length of a log record, including its padding.
+ */
+#define ATK_WIRE_LOG_RECORD_LENGTH(nameLength, dataLength) \
+	((((int) sizeof(AtkWireLogRecord) + (nameLength) + (dataLength)) + 7) & ~7)
+
+/**
+ * This class appends the messages sent and received on a wire to a log,
+ * each stamped with the time it crossed the wire.
+ *
+ * Records may come from the sending thread and a reader thread at once,
+ * so they are serialized.
+ *
+ * @see AtkWireReplayer
+ */
+class MLE_ATK_API AtkWireRecorder
+{
+  public:
+
+	/**
+	 * Open a log for recording.
+	 *
+	 * @param filename The name of the log file; it is truncated.
+	 *
+	 * @return A pointer to the recorder is returned. If the log could not
+	 * be created, then <b>NULL</b> will be returned.
+	 */
+    static AtkWireRecorder* open(const char* filename);
+
+    virtual ~AtkWireRecorder();
+
+	/**
+	 * Record a message whose data is gathered from buffers.
+	 *
+	 * @param direction ATK_WIRE_LOG_RECV or ATK_WIRE_LOG_SEND.
+	 * @param msg The message providing the header fields.
+	 * @param buffers The pieces of the message data.
+	 * @param numBuffers The number of buffers.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    virtual int record(int direction, AtkWireMsg* msg,
+		const AtkWireBuffer* buffers, int numBuffers);
+
+	/**
+	 * Record a message.
+	 *
+	 * @param direction ATK_WIRE_LOG_RECV or ATK_WIRE_LOG_SEND.
+	 * @param msg The message.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    virtual int record(int direction, AtkWireMsg* msg);
+
+	/**
+	 * Write out any records still buffered.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. Otherwise, a
+	 * negative value will be returned.
+	 */
+    virtual int flush();
+
+	/**
+	 * Get the number of records written.
+	 */
+    int getNumRecords() { return m_numRecords; }
+
+	/**
+	 * Override operator new.
+	 *
+	 * @param tSize The size, in bytes, to allocate.
+	 */
+	void* operator new(size_t tSize);
+
+	/**
+	 * Override operator delete.
+	 *
+	 * @param p A pointer to the memory to delete.
+	 */
+    void  operator delete(void *p);
+
+  protected:
+
+    AtkWireRecorder(FILE* fp);
+
+	/** The log file. */
+	FILE* m_fp;
+	/** The time recording started. */
+	std::chrono::steady_clock::time_point m_startTime;
+	/** Serializes records from different threads. */
+	std::mutex m_lock;
+	/** The number of records written. */
+	int m_numRecords;
+	/** Set once a write has failed; nothing more is recorded. */
+	int m_failed;
+};
+
+#endif /* __ATK_WIRERECORDER_H_ */
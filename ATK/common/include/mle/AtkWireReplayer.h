@@ -0,0 +1,198 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireReplayer.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that replays a wire log to a wired object,
+ * timing how long each message takes to handle.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIREREPLAYER_H_
+#define __ATK_WIREREPLAYER_H_
+
+// Include system header files.
+#include <stdint.h>
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+#include <mle/AtkWireMsg.h>
+#include <mle/AtkWireNameTable.h>
+
+// Declare classes.
+class AtkWired;
+
+/** Replay messages with the spacing they were recorded with. */
+#define ATK_WIRE_REPLAY_ORIGINAL 0
+/** Replay messages back to back. */
+#define ATK_WIRE_REPLAY_MAXIMUM 1
+
+/**
+ * The handling times of the replayed messages with one name, in
+ * nanoseconds.
+ */
+struct AtkWireReplayStats
+{
+    /** The name of the messages. */
+    char m_msgName[MAX_MSG_NAME_LEN];
+    /** The number of messages replayed. */
+    int m_count;
+    /** The total time spent handling them. */
+    int64_t m_totalTime;
+    /** The shortest time spent handling one. */
+    int64_t m_minTime;
+    /** The longest time spent handling one. */
+    int64_t m_maxTime;
+};
+
+/**
+ * This class replays the messages received in a log written by
+ * AtkWireRecorder, delivering each to a wired object.
+ *
+ * The log is mapped, where the platform allows, and messages are built
+ * around the data in place. The time spent in deliverMsg() is measured
+ * for every message, so that repeated replays of the same log benchmark
+ * the whole dispatch path.
+ *
+ * @see AtkWireRecorder
+ */
+class MLE_ATK_API AtkWireReplayer
+{
+  public:
+
+	/**
+	 * Open a log for replay.
+	 *
+	 * @param filename The name of the log file.
+	 *
+	 * @return A pointer to the replayer is returned. If the log could not
+	 * be read or is not a wire log, then <b>NULL</b> will be returned.
+	 */
+    static AtkWireReplayer* open(const char* filename);
+
+    virtual ~AtkWireReplayer();
+
+	/**
+	 * Replay the received messages in the log. Internal wire messages
+	 * and the messages that were sent are skipped.
+	 *
+	 * @param wired The object to deliver the messages to.
+	 * @param speed ATK_WIRE_REPLAY_ORIGINAL or ATK_WIRE_REPLAY_MAXIMUM.
+	 *
+	 * @return The number of messages delivered is returned. If the log
+	 * is corrupt, then a negative value will be returned; the messages
+	 * before the damage will have been delivered.
+	 */
+    virtual int replay(AtkWired* wired, int speed = ATK_WIRE_REPLAY_ORIGINAL);
+
+	/**
+	 * Get the number of message names with statistics.
+	 */
+    int getNumStats() { return m_numStats; }
+
+	/**
+	 * Get the statistics for a message name.
+	 *
+	 * @param index The index of the statistics, from 0 to one less
+	 * than getNumStats().
+	 */
+    AtkWireReplayStats* getStats(int index) { return &m_stats[index]; }
+
+	/**
+	 * Get the time the last replay took, in nanoseconds.
+	 */
+    int64_t getElapsedTime() { return m_elapsedTime; }
+
+	/**
+	 * Get the longest a message was delivered behind its recorded time
+	 * during the last replay at the original speed, in nanoseconds.
+	 */
+    int64_t getMaxLag() { return m_maxLag; }
+
+	/**
+	 * Print the statistics of the last replay.
+	 */
+    virtual void printStats();
+
+	/**
+	 * Override operator new.
+	 *
+	 * @param tSize The size, in bytes, to allocate.
+	 */
+	void* operator new(size_t tSize);
+
+	/**
+	 * Override operator delete.
+	 *
+	 * @param p A pointer to the memory to delete.
+	 */
+    void  operator delete(void *p);
+
+  protected:
+
+    AtkWireReplayer(char* log, long logLength, int mapped);
+
+	/**
+	 * Get the statistics for a message name, adding them if need be.
+	 *
+	 * @return A pointer to the statistics is returned, or <b>NULL</b>
+	 * if there is no room for more names.
+	 */
+	AtkWireReplayStats* findStats(const char* msgName);
+
+	/** The log. */
+	char* m_log;
+	/** The length of the log, in bytes. */
+	long m_logLength;
+	/** Flag indicating whether the log is mapped rather than allocated. */
+	int m_mapped;
+	/** The indices of the statistics, by message name. */
+	AtkWireNameTable m_statNames;
+	/** The statistics, indexed by name ID less one. */
+	AtkWireReplayStats* m_stats;
+	/** The number of entries in <b>m_stats</b> in use. */
+	int m_numStats;
+	/** The number of entries <b>m_stats</b> has room for. */
+	int m_maxStats;
+	/** The number of messages delivered by the last replay. */
+	int m_numDelivered;
+	/** The time the last replay took, in nanoseconds. */
+	int64_t m_elapsedTime;
+	/** The longest a message was delivered late, in nanoseconds. */
+	int64_t m_maxLag;
+};
+
+#endif /* __ATK_WIREREPLAYER_H_ */
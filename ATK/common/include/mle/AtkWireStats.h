@@ -0,0 +1,253 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireStats.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that keeps per message counters and
+ * latency histograms for a wire.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIRESTATS_H_
+#define __ATK_WIRESTATS_H_
+
+// Include system header files.
+#include <stdio.h>
+#include <mutex>
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+#include <mle/AtkWireMsg.h>
+#include <mle/AtkWireNameTable.h>
+
+/**
+ * The number of buckets in a latency histogram. The first bucket counts
+ * times under a microsecond, bucket <b>i</b> counts times from 2^(i-1) up
+ * to 2^i microseconds, and the last bucket counts everything longer.
+ */
+#define ATK_WIRE_STATS_BUCKETS 24
+
+/** The name of the message that starts collecting message stats. */
+#define ATK_WIRE_START_STATS_MSG_NAME "StartMsgStats"
+/** The name of the message that stops collecting message stats. */
+#define ATK_WIRE_END_STATS_MSG_NAME "EndMsgStats"
+/** The name of the message that asks for the message stats. */
+#define ATK_WIRE_GET_STATS_MSG_NAME "GetMsgStats"
+
+/**
+ * The counters kept for one message name.
+ *
+ * Times are in nanoseconds. The handler time is how long the message
+ * took to handle once delivered; the wait time is how long it sat
+ * between arriving on the wire and being delivered.
+ */
+struct AtkWireMsgStats
+{
+    /** The name of the message. */
+    char m_msgName[MAX_MSG_NAME_LEN];
+    /** The number of messages received. */
+    long long m_recvMsgs;
+    /** The payload bytes of those messages. */
+    long long m_recvBytes;
+    /** The number of messages sent. */
+    long long m_sentMsgs;
+    /** The payload bytes of those messages. */
+    long long m_sentBytes;
+    /** The number of messages handled. */
+    long long m_handledMsgs;
+    /** The total time spent handling them. */
+    long long m_handlerTime;
+    /** The longest time spent handling one. */
+    long long m_maxHandlerTime;
+    /** The total time they waited to be delivered. */
+    long long m_waitTime;
+    /** The longest time one waited to be delivered. */
+    long long m_maxWaitTime;
+    /** A histogram of the handler times. */
+    long long m_handlerHistogram[ATK_WIRE_STATS_BUCKETS];
+    /** A histogram of the wait times. */
+    long long m_waitHistogram[ATK_WIRE_STATS_BUCKETS];
+};
+
+/**
+ * This class counts the messages crossing a wire, by name.
+ *
+ * Messages may be counted from the sending thread, a reader thread and
+ * the delivering thread at once, so updates are serialized; each one is
+ * a table lookup and a few additions.
+ *
+ * @see AtkWire
+ */
+class MLE_ATK_API AtkWireStats
+{
+  public:
+
+    AtkWireStats();
+
+    virtual ~AtkWireStats();
+
+	/**
+	 * Count a received message.
+	 *
+	 * @param msgName The name of the message.
+	 * @param bytes The length of its payload.
+	 */
+    void recordRecv(const char* msgName, int bytes);
+
+	/**
+	 * Count a sent message.
+	 *
+	 * @param msgName The name of the message.
+	 * @param bytes The length of its payload.
+	 */
+    void recordSend(const char* msgName, int bytes);
+
+	/**
+	 * Count a handled message.
+	 *
+	 * @param msgName The name of the message.
+	 * @param waitTime How long it waited to be delivered, in nanoseconds;
+	 * negative if that is not known.
+	 * @param handlerTime How long it took to handle, in nanoseconds.
+	 */
+    void recordHandled(const char* msgName, long long waitTime, long long handlerTime);
+
+	/**
+	 * Get the number of message names counted.
+	 */
+    int getNumEntries();
+
+	/**
+	 * Get a copy of the counters for a message name.
+	 *
+	 * @param index Which name, from <b>0</b> to getNumEntries() - 1.
+	 * @param stats Set to the counters.
+	 *
+	 * @return Upon success, <b>0</b> will be returned. If the index is out
+	 * of range, then <b>-1</b> will be returned.
+	 */
+    int getEntry(int index, AtkWireMsgStats* stats);
+
+	/**
+	 * Forget every counter.
+	 */
+    void reset();
+
+	/**
+	 * Add the counters to a message: the number of entries, followed by
+	 * each AtkWireMsgStats as a data parameter.
+	 *
+	 * @param msg The message to add to.
+	 */
+    void addParams(AtkWireMsg* msg);
+
+	/**
+	 * Get counters added to a message by addParams().
+	 *
+	 * @param msg The message, with its parameters reset.
+	 * @param stats An array of at least <b>maxEntries</b> entries.
+	 * @param maxEntries The most entries to get; any beyond are skipped.
+	 *
+	 * @return The number of entries in the message is returned, or a
+	 * negative value if it is malformed.
+	 */
+    static int getParams(AtkWireMsg* msg, AtkWireMsgStats* stats, int maxEntries);
+
+	/**
+	 * Print the counters as a table.
+	 *
+	 * @param fp Where to print them.
+	 */
+    void print(FILE* fp);
+
+	/**
+	 * Print the counters when the process exits, or when this object is
+	 * deleted if that comes first.
+	 *
+	 * @param filename The file to append them to; "-" for standard output.
+	 */
+    void printAtExit(const char* filename);
+
+	/**
+	 * Get the time from a clock that only goes forward, in nanoseconds.
+	 */
+    static long long now();
+
+	/**
+	 * Get the histogram bucket for a time.
+	 *
+	 * @param time The time, in nanoseconds.
+	 */
+    static int getBucket(long long time);
+
+	/**
+	 * Override operator new.
+	 *
+	 * @param tSize The size, in bytes, to allocate.
+	 */
+	void* operator new(size_t tSize);
+
+	/**
+	 * Override operator delete.
+	 *
+	 * @param p A pointer to the memory to delete.
+	 */
+    void  operator delete(void *p);
+
+  protected:
+
+    // Get the counters for a name, adding them if they are new; the lock
+    // must be held. Returns NULL if no more names fit.
+    AtkWireMsgStats* lookup(const char* msgName);
+
+    // Print every object waiting for the process to exit.
+    static void printAllAtExit();
+
+	/** Maps names to entries; entry i has ID i + 1. */
+	AtkWireNameTable m_names;
+	/** The counters, one per name. */
+	AtkWireMsgStats* m_entries;
+	/** The number of entries there is room for. */
+	int m_maxEntries;
+	/** Serializes updates from different threads. */
+	std::mutex m_lock;
+	/** Where to print the counters at exit, or NULL. */
+	char* m_exitFile;
+	/** The next object to print at exit. */
+	AtkWireStats* m_nextAtExit;
+};
+
+#endif /* __ATK_WIRESTATS_H_ */
@@ -0,0 +1,216 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireWorkers.h
+ * @ingroup MleATK
+ *
+ * This file contains a class that delivers messages on a pool of worker
+ * threads and sends their replies in order.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this header file, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#ifndef __ATK_WIREWORKERS_H_
+#define __ATK_WIREWORKERS_H_
+
+// Include system header files.
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Include Magic Lantern header files.
+#include <mle/mleatk_rehearsal.h>
+#include <mle/AtkWireFunc.h>
+
+// Message affinities: which thread a message is delivered on.
+/** The message is delivered on the thread that owns the wire. */
+#define ATK_WIRE_AFFINITY_MAIN   1
+/** The message only reads, and may be delivered on a worker. */
+#define ATK_WIRE_AFFINITY_WORKER 2
+
+// Declare classes.
+class AtkWired;
+class AtkWireMsg;
+class AtkWireBatch;
+struct AtkWireJob;
+
+/**
+ * This class delivers messages that only read state on a small pool of
+ * worker threads, so that the thread that owns the wire, which is usually
+ * the one that renders, is free while they are handled.
+ *
+ * Each message name carries a declared affinity; a name that isn't
+ * declared has <b>ATK_WIRE_AFFINITY_MAIN</b>. A message submitted to the
+ * pool is copied and delivered to its wired on a worker. Whatever the
+ * worker sends is collected rather than written, and <b>flush()</b>
+ * writes it from the owning thread, in the order the messages were
+ * submitted, with each reply carrying the correlation ID of its request.
+ *
+ * Nothing locks the state the workers read. The owning thread must not
+ * change it while messages are in flight: it calls <b>barrier()</b>
+ * before it handles a message that changes state, and before it returns
+ * to code that may change state some other way, such as rendering.
+ * <b>getNotifyFD()</b> becomes readable when there are replies to flush.
+ */
+class MLE_ATK_API AtkWireWorkers
+{
+  public:
+
+    /**
+	 * The constructor.
+	 *
+	 * @param numThreads The number of worker threads.
+	 */
+    AtkWireWorkers(int numThreads);
+
+    /**
+	 * The destructor; the messages already submitted are delivered and
+	 * their replies sent first.
+	 */
+    ~AtkWireWorkers();
+
+    /**
+	 * Declare the affinity of a message.
+	 *
+	 * @param msgName The name of the message.
+	 * @param affinity <b>ATK_WIRE_AFFINITY_MAIN</b> or
+	 * <b>ATK_WIRE_AFFINITY_WORKER</b>.
+	 */
+    void setAffinity(const char* msgName, int affinity);
+
+    /**
+	 * Get the affinity of a message.
+	 *
+	 * @param msgName The name of the message.
+	 *
+	 * @return The declared affinity is returned, or
+	 * <b>ATK_WIRE_AFFINITY_MAIN</b> if there is none.
+	 */
+    int getAffinity(const char* msgName);
+
+    /**
+	 * Deliver a copy of a message to a wired on a worker. What the
+	 * worker sends goes to the wired's object on the other side.
+	 *
+	 * @param wired The wired to deliver the message to.
+	 * @param msg The message; it can be deleted when this returns.
+	 *
+	 * @return 0 is returned on success, -1 if the pool has no threads.
+	 */
+    int submit(AtkWired* wired, AtkWireMsg* msg);
+
+    /**
+	 * Write what the workers have sent for the messages delivered so
+	 * far, stopping at the first message that is still being handled.
+	 * Call this on the thread that owns the wires.
+	 *
+	 * @return The number of messages written is returned.
+	 */
+    int flush();
+
+    /**
+	 * Wait for every submitted message to be delivered, then flush.
+	 *
+	 * @return The number of messages written is returned.
+	 */
+    int barrier();
+
+    /**
+	 * Get the number of submitted messages whose replies haven't been
+	 * flushed.
+	 */
+    int getNumPending();
+
+    /**
+	 * Get a file descriptor that becomes readable when there is
+	 * something to flush; -1 if there is none on this platform.
+	 */
+    int getNotifyFD() { return m_notifyFD[0]; }
+
+    /**
+	 * Check whether the calling thread is one of a pool's workers.
+	 */
+    static int isWorkerThread();
+
+	/**
+	 * Override operator new.
+	 *
+	 * @param tSize The size, in bytes, to allocate.
+	 */
+	void* operator new(size_t tSize);
+
+	/**
+	 * Override operator delete.
+	 *
+	 * @param p A pointer to the memory to delete.
+	 */
+    void  operator delete(void *p);
+
+  protected:
+
+    // Take messages off the queue and deliver them until stopped.
+    void workerLoop();
+
+    // Signal the notify descriptor.
+    void notify();
+
+	/** The declared affinities, keyed by message name. */
+    AtkWireFuncTable m_affinities;
+	/** The worker threads. */
+    std::thread** m_threads;
+	/** The number of worker threads. */
+    int m_numThreads;
+	/** Guards the queue. */
+    std::mutex m_lock;
+	/** Signalled when a message is submitted or the workers must stop. */
+    std::condition_variable m_ready;
+	/** Signalled when a worker finishes a message. */
+    std::condition_variable m_done;
+	/** The oldest message whose replies haven't been flushed. */
+    AtkWireJob* m_head;
+	/** The newest message. */
+    AtkWireJob* m_tail;
+	/** The next message for a worker to take. */
+    AtkWireJob* m_next;
+	/** The number of messages between m_head and m_tail. */
+    int m_numPending;
+	/** The number of those not yet delivered. */
+    int m_numUndelivered;
+	/** Whether the workers must stop. */
+    int m_stop;
+	/** The pipe that signals there is something to flush. */
+    int m_notifyFD[2];
+};
+
+#endif /* __ATK_WIREWORKERS_H_ */
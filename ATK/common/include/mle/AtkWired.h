@@ -52,6 +52,7 @@
 // Include Magic Lantern header files. 
 #include <mle/mleatk_rehearsal.h>
 #include <mle/AtkBasicArray.h>
+#include <mle/AtkWireFunc.h>
 
 // Declare classes.
 class AtkWire;
@@ -60,6 +61,13 @@ class AtkWireFunc;
 
 MLE_DECLARE_ARRAY(AtkWireFuncArray, AtkWireFunc*);
 
+// Wireds are named on the wire by handles rather than by their
+// addresses.  The low bits of a handle index a slot and the high bits hold
+// the slot's generation, which changes when its wired goes away, so that a
+// handle to a deleted wired is recognized as stale.  No handle is 0.
+#define ATK_WIRED_HANDLE_INDEX_BITS 16
+#define ATK_WIRED_HANDLE_INDEX_MASK ((1u << ATK_WIRED_HANDLE_INDEX_BITS) - 1)
+
 
 class MLE_ATK_API AtkWired 
 {
@@ -74,16 +82,35 @@ class MLE_ATK_API AtkWired
 
     virtual AtkWireMsg* recvAndDeliverMsg(); 
 
+    // deliver msgs that have already arrived, up to maxMsgs (0 for all),
+    // without waiting; returns the number delivered
+    virtual int deliverPendingMsgs(int maxMsgs = 0);
+
+    // deliver an already received msg to its destination object
+    virtual AtkWireMsg* routeMsg(AtkWireMsg* msg);
+
+    // deliver the members of a batch msg in order, answering a sync batch
+    // with one reply; returns the number delivered, or -1 if the batch is
+    // malformed
+    virtual int deliverBatch(AtkWireMsg* batch);
+
     // Getting the FD
     virtual int getFD();
 
-    // Sending an ID msg
+    // Sending an ID msg, carrying our handle
     virtual void sendID();
 
+    // the handle that names this wired on the wire; 0 if there was no
+    // slot left to register it in
+    unsigned int getHandle() { return m_handle; }
+
+    // the wired a handle names; NULL if the handle is stale or invalid
+    static AtkWired* lookup(unsigned int handle);
+
     // check for pending msgs
     virtual int pendingMsgs();
 
-    // find wire func from list
+    // find wire func; each wired keeps its own instance of each
     virtual AtkWireFunc* find(const char* name, int recv = 0);
 
     virtual AtkWireFunc* findRecv(const char* name);
@@ -161,7 +188,9 @@ class MLE_ATK_API AtkWired
   protected:
 
     AtkWire* m_wire;
+    // The handle of the object on the other side of the wire.
     void* m_objID;
+    unsigned int m_handle;
     char* m_name;
 #if defined(_WINDOWS)
 	int m_pid;
@@ -177,6 +206,23 @@ class MLE_ATK_API AtkWired
 
     AtkWireFuncArray m_wireFuncs;
     AtkWireFuncArray m_recvWireFuncs;
+
+    // The same wire funcs, keyed by name for lookup.
+    AtkWireFuncTable m_wireFuncTable;
+    AtkWireFuncTable m_recvWireFuncTable;
+
+    // The wire funcs find() made; the wired deletes them.
+    AtkWireFuncArray m_createdWireFuncs;
+
+    // The names find() found no wire func for, so that they aren't
+    // looked for again; each value is the wired's copy of its name.
+    AtkWireFuncTable m_missingWireFuncs;
+    AtkWireFuncTable m_missingRecvWireFuncs;
+    // The wire func generation the missing names were found under.
+    unsigned int m_missingGeneration;
+
+    // Forget the missing names.
+    void clearMissing();
 };
 
 #endif /* __ATK_WIRED_H_ */
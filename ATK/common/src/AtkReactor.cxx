@@ -0,0 +1,525 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkReactor.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that multiplexes wires,
+ * file descriptors and timers in a single event loop.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#if defined(__linux__)
+
+// Include system header files.
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+#include <mle/mlAssert.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkReactor.h"
+#include "mle/AtkWire.h"
+#include "mle/AtkWired.h"
+#include "mle/AtkWireMsg.h"
+
+// The kinds of event source.
+#define ATK_REACTOR_SOURCE_WIRE  1
+#define ATK_REACTOR_SOURCE_FD    2
+#define ATK_REACTOR_SOURCE_TIMER 3
+
+// The number of events collected by one epoll_wait().
+#define ATK_REACTOR_MAX_EVENTS 32
+
+struct AtkReactorSource
+{
+    // One of the ATK_REACTOR_SOURCE_* kinds.
+    int m_kind;
+    // The watched file descriptor.
+    int m_fd;
+    // For wires, the write file descriptor and whether it is watched.
+    int m_writeFD;
+    int m_watchingOutput;
+    // Set once the source has been removed during a dispatch.
+    int m_removed;
+    // For timers, whether the timer fires more than once.
+    int m_repeat;
+    // The wired object, for wire sources.
+    AtkWired* m_wired;
+    AtkReactorMsgCallback m_msgCallback;
+    AtkReactorFDCallback m_fdCallback;
+    AtkReactorTimerCallback m_timerCallback;
+    void* m_clientData;
+};
+
+static AtkReactorSource* atkNewSource(int kind, int fd, void* clientData)
+{
+    AtkReactorSource* source = (AtkReactorSource*) mlMalloc(sizeof(AtkReactorSource));
+    memset(source, 0, sizeof(AtkReactorSource));
+    source->m_kind = kind;
+    source->m_fd = fd;
+    source->m_clientData = clientData;
+    return(source);
+}
+
+
+AtkReactor::AtkReactor()
+{
+    m_epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFD < 0)
+		printf("REACTOR: Could not create epoll FD.  Errno: %d\n", errno);
+
+    m_running = 0;
+    m_dispatching = 0;
+    m_maxMsgsPerDispatch = ATK_REACTOR_MAX_MSGS_PER_DISPATCH;
+}
+
+AtkReactor::~AtkReactor()
+{
+    for (int i = 0; i < m_sources.getLength(); i++)
+	{
+		AtkReactorSource* source = m_sources[i];
+		if (source->m_kind == ATK_REACTOR_SOURCE_TIMER) close(source->m_fd);
+		mlFree(source);
+    }
+    m_sources.removeAll();
+
+    if (m_epollFD >= 0) close(m_epollFD);
+}
+
+int
+AtkReactor::addWired(AtkWired* wired, AtkReactorMsgCallback callback,
+	void* clientData)
+{
+    AtkWire* wire = wired ? wired->getWire() : NULL;
+    if (!wire)
+	{
+		printf("REACTOR: No wire to watch\n");
+		return(-1);
+    }
+    if (findSource(ATK_REACTOR_SOURCE_WIRE, wire->getFD()) >= 0)
+	{
+		printf("REACTOR: Wire %d is already watched\n", wire->getFD());
+		return(-1);
+    }
+
+    // Partial frames must never block the loop.
+    if (wire->setNonBlocking(1) < 0) return(-1);
+
+    AtkReactorSource* source = atkNewSource(ATK_REACTOR_SOURCE_WIRE,
+		wire->getFD(), clientData);
+    source->m_writeFD = wire->getWriteFD();
+    source->m_wired = wired;
+    source->m_msgCallback = callback;
+    if (addSource(source, ATK_REACTOR_READ) < 0)
+	{
+		wire->setNonBlocking(0);
+		return(-1);
+    }
+    return(0);
+}
+
+int
+AtkReactor::removeWired(AtkWired* wired)
+{
+    for (int i = 0; i < m_sources.getLength(); i++)
+	{
+		AtkReactorSource* source = m_sources[i];
+		if (source->m_removed || source->m_kind != ATK_REACTOR_SOURCE_WIRE ||
+			source->m_wired != wired)
+			continue;
+
+		// Hand the wire back in the mode it was found.
+		AtkWire* wire = wired->getWire();
+		if (wire && !wire->getLostConnection()) wire->setNonBlocking(0);
+
+		removeSource(i);
+		return(0);
+    }
+    return(-1);
+}
+
+int
+AtkReactor::addFD(int fd, AtkReactorFDCallback callback, void* clientData,
+	int events)
+{
+    if (fd < 0 || !callback) return(-1);
+    if (findSource(ATK_REACTOR_SOURCE_FD, fd) >= 0)
+	{
+		printf("REACTOR: FD %d is already watched\n", fd);
+		return(-1);
+    }
+
+    AtkReactorSource* source = atkNewSource(ATK_REACTOR_SOURCE_FD, fd, clientData);
+    source->m_fdCallback = callback;
+    return(addSource(source, events));
+}
+
+int
+AtkReactor::removeFD(int fd)
+{
+    int index = findSource(ATK_REACTOR_SOURCE_FD, fd);
+    if (index < 0) return(-1);
+    removeSource(index);
+    return(0);
+}
+
+int
+AtkReactor::addTimer(int interval, AtkReactorTimerCallback callback,
+	void* clientData, int repeat)
+{
+    if (interval <= 0 || !callback) return(-1);
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+	{
+		printf("REACTOR: Could not create timer.  Errno: %d\n", errno);
+		return(-1);
+    }
+
+    struct itimerspec spec;
+    spec.it_value.tv_sec = interval / 1000;
+    spec.it_value.tv_nsec = (interval % 1000) * 1000000L;
+    if (repeat) spec.it_interval = spec.it_value;
+    else spec.it_interval.tv_sec = spec.it_interval.tv_nsec = 0;
+    if (timerfd_settime(fd, 0, &spec, NULL) < 0)
+	{
+		printf("REACTOR: Could not set timer.  Errno: %d\n", errno);
+		close(fd);
+		return(-1);
+    }
+
+    AtkReactorSource* source = atkNewSource(ATK_REACTOR_SOURCE_TIMER, fd, clientData);
+    source->m_timerCallback = callback;
+    source->m_repeat = repeat;
+    if (addSource(source, ATK_REACTOR_READ) < 0)
+	{
+		close(fd);
+		return(-1);
+    }
+
+    // The timer descriptor doubles as its identifier.
+    return(fd);
+}
+
+int
+AtkReactor::removeTimer(int timerID)
+{
+    int index = findSource(ATK_REACTOR_SOURCE_TIMER, timerID);
+    if (index < 0) return(-1);
+    removeSource(index);
+    return(0);
+}
+
+int
+AtkReactor::dispatch(int timeout)
+{
+    if (m_epollFD < 0) return(-1);
+
+    int count = 0;
+    m_dispatching++;
+
+    // Messages queued outside the reactor, for instance while a synchronous
+    // message waited for its reply, raise no event; deliver them now.
+    for (int i = 0; i < m_sources.getLength(); i++)
+	{
+		AtkReactorSource* source = m_sources[i];
+		if (source->m_removed || source->m_kind != ATK_REACTOR_SOURCE_WIRE)
+			continue;
+		AtkWire* wire = source->m_wired->getWire();
+		if (wire && wire->getNumMsgs() > 0) count += deliverWireMsgs(source);
+    }
+    if (count > 0) timeout = 0;
+
+    struct epoll_event events[ATK_REACTOR_MAX_EVENTS];
+    int numEvents;
+    do
+	{
+		numEvents = epoll_wait(m_epollFD, events, ATK_REACTOR_MAX_EVENTS, timeout);
+    } while (numEvents < 0 && errno == EINTR);
+    if (numEvents < 0)
+	{
+		printf("REACTOR: Could not wait for events.  Errno: %d\n", errno);
+		m_dispatching--;
+		purgeSources();
+		return(-1);
+    }
+
+    for (int i = 0; i < numEvents; i++)
+	{
+		AtkReactorSource* source = (AtkReactorSource*) events[i].data.ptr;
+		if (source->m_removed) continue;
+
+		switch (source->m_kind)
+		{
+		  case ATK_REACTOR_SOURCE_WIRE:
+		  {
+			AtkWire* wire = source->m_wired->getWire();
+
+			// The reader has made room for buffered, held or bulk output.
+			if ((events[i].events & EPOLLOUT) && wire) wire->flush(0);
+
+			// Take everything that has arrived, then deliver what is complete.
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+			{
+				if (wire) wire->pollMsgs();
+				count += deliverWireMsgs(source);
+			}
+			break;
+		  }
+
+		  case ATK_REACTOR_SOURCE_FD:
+		  {
+			int mask = 0;
+			if (events[i].events & EPOLLIN) mask |= ATK_REACTOR_READ;
+			if (events[i].events & EPOLLOUT) mask |= ATK_REACTOR_WRITE;
+			if (events[i].events & (EPOLLERR | EPOLLHUP)) mask |= ATK_REACTOR_ERROR;
+			(*source->m_fdCallback)(source->m_fd, mask, source->m_clientData);
+			count++;
+			break;
+		  }
+
+		  case ATK_REACTOR_SOURCE_TIMER:
+		  {
+			uint64_t expirations = 0;
+			if (read(source->m_fd, &expirations, sizeof(expirations)) !=
+				sizeof(expirations) || expirations == 0)
+				break;
+			(*source->m_timerCallback)(source->m_fd, source->m_clientData);
+			count++;
+			if (!source->m_repeat && !source->m_removed)
+				removeTimer(source->m_fd);
+			break;
+		  }
+		}
+    }
+
+    // This is the flush point for everything sent while dispatching.
+    for (int i = 0; i < m_sources.getLength(); i++)
+	{
+		AtkReactorSource* source = m_sources[i];
+		if (source->m_removed || source->m_kind != ATK_REACTOR_SOURCE_WIRE)
+			continue;
+		AtkWire* wire = source->m_wired->getWire();
+		if (wire && wire->hasPendingOutput()) wire->flush(0);
+		updateWireOutput(source);
+    }
+
+    m_dispatching--;
+    purgeSources();
+    return(count);
+}
+
+void
+AtkReactor::run()
+{
+    m_running = 1;
+    while (m_running && m_sources.getLength() > 0)
+	{
+		if (dispatch(-1) < 0) break;
+    }
+    m_running = 0;
+}
+
+int
+AtkReactor::addSource(AtkReactorSource* source, int events)
+{
+    if (m_epollFD < 0)
+	{
+		mlFree(source);
+		return(-1);
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    if (events & ATK_REACTOR_READ) event.events |= EPOLLIN;
+    if (events & ATK_REACTOR_WRITE) event.events |= EPOLLOUT;
+    event.data.ptr = source;
+    if (epoll_ctl(m_epollFD, EPOLL_CTL_ADD, source->m_fd, &event) < 0)
+	{
+		printf("REACTOR: Could not watch FD %d.  Errno: %d\n", source->m_fd, errno);
+		mlFree(source);
+		return(-1);
+    }
+
+    m_sources.add(source);
+    return(0);
+}
+
+void
+AtkReactor::removeSource(int index)
+{
+    AtkReactorSource* source = m_sources[index];
+    MLE_ASSERT(!source->m_removed);
+
+    epoll_ctl(m_epollFD, EPOLL_CTL_DEL, source->m_fd, NULL);
+    if (source->m_watchingOutput && source->m_writeFD != source->m_fd)
+		epoll_ctl(m_epollFD, EPOLL_CTL_DEL, source->m_writeFD, NULL);
+    if (source->m_kind == ATK_REACTOR_SOURCE_TIMER) close(source->m_fd);
+    source->m_removed = 1;
+
+    // Events already collected may still refer to the source.
+    if (m_dispatching) return;
+    m_sources.remove(index);
+    mlFree(source);
+}
+
+int
+AtkReactor::findSource(int kind, int fd)
+{
+    for (int i = 0; i < m_sources.getLength(); i++)
+	{
+		AtkReactorSource* source = m_sources[i];
+		if (!source->m_removed && source->m_kind == kind && source->m_fd == fd)
+			return(i);
+    }
+    return(-1);
+}
+
+int
+AtkReactor::deliverWireMsgs(AtkReactorSource* source)
+{
+    int count = 0;
+    while (!source->m_removed &&
+		(m_maxMsgsPerDispatch <= 0 || count < m_maxMsgsPerDispatch))
+	{
+		// The wire may change under a callback, so fetch it every time.
+		AtkWire* wire = source->m_wired->getWire();
+		AtkWireMsg* msg = wire ? wire->recvMsg() : NULL;
+		if (!msg)
+		{
+			if (!wire || wire->getLostConnection())
+			{
+				AtkWired* wired = source->m_wired;
+				AtkReactorMsgCallback callback = source->m_msgCallback;
+				void* clientData = source->m_clientData;
+
+				removeSource(findSource(ATK_REACTOR_SOURCE_WIRE, source->m_fd));
+				if (callback) (*callback)(wired, NULL, clientData);
+			}
+			break;
+		}
+
+		count++;
+		if (source->m_msgCallback)
+			(*source->m_msgCallback)(source->m_wired, msg, source->m_clientData);
+		else
+			source->m_wired->routeMsg(msg);
+    }
+    return(count);
+}
+
+void
+AtkReactor::updateWireOutput(AtkReactorSource* source)
+{
+    AtkWire* wire = source->m_wired->getWire();
+    int watch = (wire && wire->hasPendingOutput()) ? 1 : 0;
+    if (watch == source->m_watchingOutput) return;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.ptr = source;
+
+    int status;
+    if (source->m_writeFD == source->m_fd)
+	{
+		// A single descriptor carries both directions.
+		event.events = EPOLLIN;
+		if (watch) event.events |= EPOLLOUT;
+		status = epoll_ctl(m_epollFD, EPOLL_CTL_MOD, source->m_fd, &event);
+    } else if (watch)
+	{
+		event.events = EPOLLOUT;
+		status = epoll_ctl(m_epollFD, EPOLL_CTL_ADD, source->m_writeFD, &event);
+    } else
+	{
+		status = epoll_ctl(m_epollFD, EPOLL_CTL_DEL, source->m_writeFD, NULL);
+    }
+
+    if (status < 0)
+		printf("REACTOR: Could not watch FD %d for output.  Errno: %d\n",
+			source->m_writeFD, errno);
+    else
+		source->m_watchingOutput = watch;
+}
+
+void
+AtkReactor::purgeSources()
+{
+    if (m_dispatching) return;
+
+    for (int i = m_sources.getLength() - 1; i >= 0; i--)
+	{
+		AtkReactorSource* source = m_sources[i];
+		if (!source->m_removed) continue;
+		m_sources.remove(i);
+		mlFree(source);
+    }
+}
+
+void *
+AtkReactor::operator new(size_t tSize)
+{
+	void *p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkReactor::operator delete(void *p)
+{
+	mlFree(p);
+}
+
+void*
+AtkReactor::operator new[](size_t tSize)
+{
+	void* p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkReactor::operator delete[](void* p)
+{
+	mlFree(p);
+}
+
+#endif /* __linux__ */
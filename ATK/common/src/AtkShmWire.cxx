@@ -0,0 +1,528 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkShmWire.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that provides utility
+ * for sending and recieving messages through shared memory.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+#if defined(__linux__)
+
+// Include system header files.
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Include Magic Lantern header files.
+#include <mle/mlErrno.h>
+#include <mle/mlMalloc.h>
+#include <mle/mlAssert.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkShmWire.h"
+#include "mle/AtkWireMsg.h"
+
+// Identifies an initialized region.
+#define ATK_SHM_WIRE_MAGIC   0x41544b53
+#define ATK_SHM_WIRE_VERSION 1
+
+// The size of the control page at the start of the region.
+#define ATK_SHM_WIRE_CONTROL_SIZE 4096
+
+// Each ring index lives on its own cache line so that the producer and
+// the consumer don't share one.
+struct AtkShmRing
+{
+    // The total number of bytes written; advanced by the producer.
+    uint64_t m_head;
+    char m_pad0[56];
+    // The total number of bytes read; advanced by the consumer.
+    uint64_t m_tail;
+    char m_pad1[56];
+    // Set by the consumer before it sleeps waiting for data.
+    uint32_t m_readerWaiting;
+    // Set by the producer before it sleeps waiting for room.
+    uint32_t m_writerWaiting;
+    // Set by the producer when it will write no more.
+    uint32_t m_closed;
+    char m_pad2[52];
+};
+
+struct AtkShmRegion
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    // The size of each ring, in bytes.
+    uint32_t m_ringSize;
+    char m_pad[52];
+    AtkShmRing m_rings[2];
+};
+
+// The flags are shared with the other process, so every access is
+// sequentially consistent: setting a waiting flag and then checking the
+// ring must not be reordered against publishing and then checking the flag.
+static inline uint64_t atkShmLoad(uint64_t* p)
+{
+    return(__atomic_load_n(p, __ATOMIC_SEQ_CST));
+}
+
+static inline void atkShmStore(uint64_t* p, uint64_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t atkShmLoadFlag(uint32_t* p)
+{
+    return(__atomic_load_n(p, __ATOMIC_SEQ_CST));
+}
+
+static inline void atkShmSetFlag(uint32_t* p, uint32_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t atkShmTakeFlag(uint32_t* p)
+{
+    return(__atomic_exchange_n(p, 0, __ATOMIC_SEQ_CST));
+}
+
+
+int
+AtkShmWire::createRegion(int ringSize)
+{
+    unsigned int size = 4096;
+    while (size < (unsigned int) ringSize) size <<= 1;
+
+    int memFD = memfd_create("AtkShmWire", 0);
+    if (memFD < 0)
+	{
+		printf("SHMWIRE: Could not create memfd.  Errno: %d\n", errno);
+		return(-1);
+    }
+
+    int regionSize = ATK_SHM_WIRE_CONTROL_SIZE + 2 * size;
+    if (ftruncate(memFD, regionSize) < 0)
+	{
+		printf("SHMWIRE: Could not size memfd.  Errno: %d\n", errno);
+		close(memFD);
+		return(-1);
+    }
+
+    AtkShmRegion* region = (AtkShmRegion*) mmap(NULL, ATK_SHM_WIRE_CONTROL_SIZE,
+		PROT_READ | PROT_WRITE, MAP_SHARED, memFD, 0);
+    if (region == MAP_FAILED)
+	{
+		printf("SHMWIRE: Could not map memfd.  Errno: %d\n", errno);
+		close(memFD);
+		return(-1);
+    }
+
+    // A new memfd is zero filled, so only the identification is needed.
+    region->m_ringSize = size;
+    region->m_version = ATK_SHM_WIRE_VERSION;
+    __atomic_store_n(&region->m_magic, ATK_SHM_WIRE_MAGIC, __ATOMIC_SEQ_CST);
+    munmap(region, ATK_SHM_WIRE_CONTROL_SIZE);
+
+    return(memFD);
+}
+
+AtkShmWire*
+AtkShmWire::attach(int memFD, int recvEventFD, int sendEventFD, int side)
+{
+    MLE_ASSERT(sizeof(AtkShmRegion) <= ATK_SHM_WIRE_CONTROL_SIZE);
+
+    struct stat st;
+    if (memFD < 0 || fstat(memFD, &st) < 0 || st.st_size < ATK_SHM_WIRE_CONTROL_SIZE)
+	{
+		printf("SHMWIRE: Bad memfd %d\n", memFD);
+		return(NULL);
+    }
+
+    int regionSize = (int) st.st_size;
+    AtkShmRegion* region = (AtkShmRegion*) mmap(NULL, regionSize,
+		PROT_READ | PROT_WRITE, MAP_SHARED, memFD, 0);
+    if (region == MAP_FAILED)
+	{
+		printf("SHMWIRE: Could not map memfd.  Errno: %d\n", errno);
+		return(NULL);
+    }
+
+    unsigned int ringSize = region->m_ringSize;
+    if (__atomic_load_n(&region->m_magic, __ATOMIC_SEQ_CST) != ATK_SHM_WIRE_MAGIC ||
+		region->m_version != ATK_SHM_WIRE_VERSION ||
+		ringSize == 0 || (ringSize & (ringSize - 1)) != 0 ||
+		ATK_SHM_WIRE_CONTROL_SIZE + 2 * (long) ringSize > regionSize)
+	{
+		printf("SHMWIRE: memfd %d does not hold a valid region\n", memFD);
+		munmap(region, regionSize);
+		return(NULL);
+    }
+
+    return(new AtkShmWire(memFD, recvEventFD, sendEventFD, region, regionSize,
+		side ? 1 : 0));
+}
+
+AtkShmWire::AtkShmWire(int memFD, int recvEventFD, int sendEventFD,
+	AtkShmRegion* region, int regionSize, int side)
+  : AtkWire(recvEventFD, sendEventFD)
+{
+    m_memFD = memFD;
+    m_region = region;
+    m_regionSize = regionSize;
+    m_ringSize = region->m_ringSize;
+
+    char* data = ((char*) region) + ATK_SHM_WIRE_CONTROL_SIZE;
+    m_sendRing = &region->m_rings[side];
+    m_recvRing = &region->m_rings[1 - side];
+    m_sendData = data + side * m_ringSize;
+    m_recvData = data + (1 - side) * m_ringSize;
+
+    // Spinning only pays when the other side can run at the same time.
+    m_spinCount = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? ATK_SHM_WIRE_SPIN_COUNT : 0;
+
+    // The base class may have taken a bulk threshold from the environment.
+    m_bulkThreshold = 0;
+}
+
+AtkShmWire::~AtkShmWire()
+{
+    // Let the other side see end of file.
+    atkShmSetFlag(&m_sendRing->m_closed, 1);
+    signalPeer();
+
+    munmap(m_region, m_regionSize);
+    close(m_memFD);
+}
+
+int
+AtkShmWire::setNonBlocking(int onOff)
+{
+    // The eventfd is only ever read once it is known to be readable.
+    m_nonBlocking = onOff ? 1 : 0;
+
+    // Until a read finds the ring empty, nothing else asks for a wakeup.
+    if (m_nonBlocking) armReader();
+    return(0);
+}
+
+int
+AtkShmWire::setSendBuffering(int onOff)
+{
+    return(onOff ? -1 : 0);
+}
+
+void
+AtkShmWire::setBulkThreshold(int /*threshold*/, int /*fragmentSize*/)
+{
+}
+
+int
+AtkShmWire::startReaderThread(int /*queueSize*/)
+{
+    printf("SHMWIRE: A reader thread is not supported\n");
+    return(-1);
+}
+
+unsigned int
+AtkShmWire::getInboundBytes()
+{
+    return((unsigned int) (atkShmLoad(&m_recvRing->m_head) - m_recvRing->m_tail));
+}
+
+unsigned int
+AtkShmWire::getOutboundSpace()
+{
+    return(m_ringSize - (unsigned int) (m_sendRing->m_head - atkShmLoad(&m_sendRing->m_tail)));
+}
+
+void
+AtkShmWire::signalPeer()
+{
+    uint64_t one = 1;
+    while (write(m_writeFD, &one, sizeof(one)) < 0 && errno == EINTR)
+		;
+}
+
+int
+AtkShmWire::waitForEvent(int timeout)
+{
+    struct pollfd pfd;
+    pfd.fd = m_readFD;
+    pfd.events = POLLIN;
+
+    for (;;)
+	{
+		pfd.revents = 0;
+		int ret = poll(&pfd, 1, timeout);
+		if (ret < 0)
+		{
+			if (errno == EINTR) continue;
+			return(-1);
+		}
+		if (ret == 0) return(0);
+
+		// Consume the count so that the descriptor is quiet until the next wakeup.
+		uint64_t count;
+		while (read(m_readFD, &count, sizeof(count)) < 0 && errno == EINTR)
+			;
+		return(1);
+    }
+}
+
+int
+AtkShmWire::writeFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers)
+{
+    char header[ATK_WIRE_MAX_HEADER_LENGTH];
+    int headerLen = encodeHeader(msg, header);
+    if (writeRing(header, headerLen) < 0)
+	{
+		printf("SHMWIRE: Could not write header\n");
+		return(-3);
+    }
+
+    for (int i = 0; i < numBuffers; i++)
+	{
+		if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+		if (writeRing(buffers[i].m_data, buffers[i].m_length) < 0)
+		{
+			printf("SHMWIRE: Could not write data\n");
+			return(-4);
+		}
+    }
+
+	MLE_DEBUG_CAT("ATK",
+		printf("SHMWIRE: Sent %s msg to %x object\n", msg->m_msgName, msg->m_destObj);
+	);
+
+    return(0);
+}
+
+int
+AtkShmWire::writeRing(const void* data, int len)
+{
+    const char* src = (const char*) data;
+    while (len > 0)
+	{
+		unsigned int space = getOutboundSpace();
+		if (space == 0)
+		{
+			if (waitForSpace() < 0) return(-1);
+			continue;
+		}
+
+		// Copy in, wrapping at the end of the ring.
+		unsigned int n = ((unsigned int) len < space) ? len : space;
+		uint64_t head = m_sendRing->m_head;
+		unsigned int offset = (unsigned int) head & (m_ringSize - 1);
+		unsigned int first = (n < m_ringSize - offset) ? n : m_ringSize - offset;
+		memcpy(m_sendData + offset, src, first);
+		if (n > first) memcpy(m_sendData, src + first, n - first);
+		atkShmStore(&m_sendRing->m_head, head + n);
+
+		// Wake the reader only if it has gone to sleep.
+		if (atkShmTakeFlag(&m_sendRing->m_readerWaiting))
+			signalPeer();
+
+		src += n;
+		len -= n;
+    }
+    return(0);
+}
+
+int
+AtkShmWire::waitForSpace()
+{
+    for (int i = 0; i < m_spinCount; i++)
+	{
+		if (getOutboundSpace() > 0) return(0);
+    }
+
+    for (;;)
+	{
+		// Say we are going to sleep, then look again before doing so.
+		atkShmSetFlag(&m_sendRing->m_writerWaiting, 1);
+		if (getOutboundSpace() > 0)
+		{
+			atkShmSetFlag(&m_sendRing->m_writerWaiting, 0);
+			return(0);
+		}
+		if (atkShmLoadFlag(&m_recvRing->m_closed))
+		{
+			m_lostConnection = 1;
+			return(-1);
+		}
+
+		if (waitForEvent(-1) < 0) return(-1);
+
+		// The wakeup may have been meant for the reader; pass it on.
+		if (getInboundBytes() > 0 || atkShmLoadFlag(&m_recvRing->m_closed))
+		{
+			uint64_t one = 1;
+			while (write(m_readFD, &one, sizeof(one)) < 0 && errno == EINTR)
+				;
+		}
+    }
+}
+
+int
+AtkShmWire::readRing(void* data, int len)
+{
+    unsigned int avail = getInboundBytes();
+    unsigned int n = ((unsigned int) len < avail) ? len : avail;
+    if (n == 0) return(0);
+
+    // Copy out, wrapping at the end of the ring.
+    uint64_t tail = m_recvRing->m_tail;
+    unsigned int offset = (unsigned int) tail & (m_ringSize - 1);
+    unsigned int first = (n < m_ringSize - offset) ? n : m_ringSize - offset;
+    memcpy(data, m_recvData + offset, first);
+    if (n > first) memcpy(((char*) data) + first, m_recvData, n - first);
+    atkShmStore(&m_recvRing->m_tail, tail + n);
+
+    // Wake the writer only if it has gone to sleep.
+    if (atkShmTakeFlag(&m_recvRing->m_writerWaiting)) signalPeer();
+
+    return(n);
+}
+
+int
+AtkShmWire::fillRecvBuffer()
+{
+    compactRecvBuffer();
+
+    for (;;)
+	{
+		// Check for close before looking at the data, so that nothing
+		// written before the close is missed.
+		uint32_t closed = atkShmLoadFlag(&m_recvRing->m_closed);
+		int len = readRing(m_recvBuf + m_recvEnd, m_recvBufSize - m_recvEnd);
+		if (len > 0)
+		{
+			m_recvEnd += len;
+			return(len);
+		}
+		if (closed) return(0);
+
+		// A blocking reader asks to be woken in waitForInput().
+		if (!m_nonBlocking || !armReader())
+		{
+			errno = EAGAIN;
+			return(-1);
+		}
+    }
+}
+
+int
+AtkShmWire::armReader()
+{
+    // Quieten the eventfd, so that it next becomes readable on a wakeup.
+    struct pollfd pfd;
+    pfd.fd = m_readFD;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) > 0)
+	{
+		uint64_t count;
+		while (read(m_readFD, &count, sizeof(count)) < 0 && errno == EINTR)
+			;
+    }
+
+    // Ask to be woken, then look again in case data arrived meanwhile.
+    atkShmSetFlag(&m_recvRing->m_readerWaiting, 1);
+    return((getInboundBytes() > 0 || atkShmLoadFlag(&m_recvRing->m_closed)) ? 1 : 0);
+}
+
+int
+AtkShmWire::readPartialMsg()
+{
+    AtkWireMsg* msg = m_partialMsg;
+    int dataLen = msg->getDataLength();
+
+    while (m_partialLen < dataLen)
+	{
+		int len = readRing(((char*) msg->m_msgData) + m_partialLen,
+			dataLen - m_partialLen);
+		if (len > 0)
+		{
+			m_partialLen += len;
+			continue;
+		}
+
+		if (atkShmLoadFlag(&m_recvRing->m_closed) && getInboundBytes() == 0)
+		{
+			// The peer closed in the middle of the frame.
+			delete msg;
+			m_partialMsg = NULL;
+			m_partialLen = 0;
+			m_lostConnection = 1;
+			mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
+			return(-1);
+		}
+
+		if (!m_nonBlocking || !armReader()) return(0);
+    }
+
+    return(1);
+}
+
+int
+AtkShmWire::waitForInput(int timeout)
+{
+    for (int i = 0; i < m_spinCount; i++)
+	{
+		if (getInboundBytes() > 0 || atkShmLoadFlag(&m_recvRing->m_closed))
+			return(1);
+    }
+
+    // Say we are going to sleep, then look again before doing so.
+    atkShmSetFlag(&m_recvRing->m_readerWaiting, 1);
+    if (getInboundBytes() > 0 || atkShmLoadFlag(&m_recvRing->m_closed))
+	{
+		atkShmSetFlag(&m_recvRing->m_readerWaiting, 0);
+		return(1);
+    }
+
+    return(waitForEvent(timeout));
+}
+
+#endif /* __linux__ */
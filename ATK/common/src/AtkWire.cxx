@@ -41,9 +41,29 @@
 //
 // COPYRIGHT_END
 
+// Include system header files.
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#if defined(__linux__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#endif
+
 // Include Magic Lantern header files.
 #include <mle/mlErrno.h>
 #include <mle/mlFileio.h>
+#include <mle/mlMalloc.h>
 #include <mle/mlAssert.h>
 #include <mle/mlDebug.h>
 
@@ -51,18 +71,207 @@
 #include "mle/AtkWire.h"
 #include "mle/AtkWired.h"    // I hate the fact that I use this class here
 #include "mle/AtkWireMsg.h"
+#include "mle/AtkWireBatch.h"
+#include "mle/AtkWireCompressor.h"
+#include "mle/AtkWireMsgQueue.h"
+#include "mle/AtkWirePool.h"
+#include "mle/AtkWireRecorder.h"
+
+
+// Check whether a descriptor is a Unix domain socket, and so can pass
+// descriptors.
+static int atkIsUnixSocket(int fd)
+{
+#if defined(__linux__)
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISSOCK(st.st_mode)) return(0);
+
+    int domain;
+    socklen_t len = sizeof(domain);
+    if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &len) < 0) return(0);
+    return(domain == AF_UNIX);
+#else
+    return(0);
+#endif
+}
+
+// Compact frame headers lead with a byte of frame flags, marked up with
+// the presence of the optional header fields.
+#define ATK_WIRE_HEADER_FRAME_FLAGS 0x1F
+#define ATK_WIRE_HEADER_SYNC 0x20
+#define ATK_WIRE_HEADER_DEST 0x40
+#define ATK_WIRE_HEADER_NAME 0x80
+
+// Write an unsigned integer seven bits at a time, least significant first.
+static int atkPutVarint(char* buf, uint64_t value)
+{
+    int len = 0;
+    while (value >= 0x80)
+	{
+		buf[len++] = (char) ((value & 0x7F) | 0x80);
+		value >>= 7;
+    }
+    buf[len++] = (char) value;
+    return(len);
+}
+
+// Read an unsigned integer written by atkPutVarint(). Returns the number
+// of bytes read, 0 if more are needed and -1 if the encoding is too long.
+static int atkGetVarint(const unsigned char* buf, int avail, uint64_t* value)
+{
+    uint64_t result = 0;
+    for (int len = 0; len < 10; len++)
+	{
+		if (len >= avail) return(0);
+		result |= ((uint64_t) (buf[len] & 0x7F)) << (7 * len);
+		if (!(buf[len] & 0x80))
+		{
+			*value = result;
+			return(len + 1);
+		}
+    }
+    return(-1);
+}
+
+// The batch the calling thread's messages are collected into, if any.
+static thread_local AtkWireBatch* g_threadCapture = NULL;
+
+// Copy the header fields of one message to another.
+static void atkCopyHeader(AtkWireMsg* to, AtkWireMsg* from)
+{
+    to->m_totalMsgLen = from->m_totalMsgLen;
+    memcpy(to->m_msgName, from->m_msgName, MAX_MSG_NAME_LEN);
+    to->m_destObj = from->m_destObj;
+    to->m_waitForReply = from->m_waitForReply;
+}
 
+// Check whether a descriptor can be written without waiting.
+static int atkCanWrite(int fd)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    return (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLOUT));
+#else
+    return(1);
+#endif
+}
 
 AtkWire::AtkWire(int readFD, int writeFD)
 {
     this->m_readFD = readFD;
     this->m_writeFD = writeFD;
     m_head = m_tail = 0;
+    m_numQueued = 0;
     m_lostConnection = 0;
+
+    m_recvBufSize = ATK_WIRE_RECV_BUFFER_SIZE;
+    m_recvBuf = (char*) mlMalloc(m_recvBufSize);
+    m_recvStart = m_recvEnd = 0;
+
+    m_nonBlocking = 0;
+    m_partialMsg = NULL;
+    m_partialLen = 0;
+
+    // The send buffer is allocated when buffering is first enabled.
+    m_sendBuffering = 0;
+    m_sendBuf = NULL;
+    m_sendBufSize = 0;
+    m_sendStart = m_sendEnd = 0;
+    m_highWaterMark = ATK_WIRE_SEND_HIGH_WATER_MARK;
+    m_highWaterCallback = NULL;
+    m_highWaterData = NULL;
+
+    // Everything goes on the interactive lane unless asked otherwise.
+    m_bulkThreshold = 0;
+    m_fragmentSize = ATK_WIRE_FRAGMENT_SIZE;
+    m_maxMsgSize = ATK_WIRE_MAX_MSG_SIZE;
+    m_forceBulk = 0;
+    m_bulkHead = m_bulkTail = NULL;
+    m_bulkOffset = 0;
+    m_bulkBytes = 0;
+    m_fragMsg = NULL;
+    m_fragLen = 0;
+    const char* bulk = getenv("MLE_ATK_BULK_THRESHOLD");
+    if (bulk) setBulkThreshold(atoi(bulk));
+
+    // Nothing is held back for coalescing until the wire falls behind.
+    m_coalesceHead = m_coalesceTail = NULL;
+    m_numCoalesced = 0;
+    m_coalescedBytes = 0;
+    m_numSuperseded = 0;
+    m_drainingCoalesced = 0;
+
+    // Out-of-band payloads need descriptor passing.
+    m_oobThreshold = 0;
+    m_readIsSocket = atkIsUnixSocket(readFD);
+    m_writeIsSocket = atkIsUnixSocket(writeFD);
+#if defined(__linux__)
+    const char* threshold = getenv("MLE_ATK_OOB_THRESHOLD");
+    if (threshold && m_writeIsSocket) m_oobThreshold = atoi(threshold);
+#endif
+
+    // Compression starts once the other side has agreed to it.
+    m_compressThreshold = 0;
+    m_peerCaps = 0;
+    m_sentOptions = 0;
+    memset(&m_compressionStats, 0, sizeof(m_compressionStats));
+    const char* compress = getenv("MLE_ATK_COMPRESS_THRESHOLD");
+    if (compress) setCompressionThreshold(atoi(compress));
+
+    // Compact headers start once the other side has agreed to them.
+    m_peerVersion = 1;
+    m_compactHeaders = 0;
+    m_sendCompact = 0;
+    m_recvCompact = 0;
+    const char* compact = getenv("MLE_ATK_COMPACT_HEADERS");
+    if (compact) setCompactHeaders(atoi(compact));
+
+    m_recorder = NULL;
+
+    m_statsEnabled.store(0);
+    const char* stats = getenv("MLE_ATK_STATS");
+    if (stats && *stats)
+	{
+		setStatsEnabled(1);
+		m_stats.printAtExit(stats);
+    }
+
+    m_nextCorrelationID = 1;
+    m_replyCorrelationID = 0;
+    m_replyBatch = NULL;
+    m_syncDeliveryDepth = 0;
+    m_replyHead = m_replyTail = NULL;
+
+    // Frames are read on the receiving thread until a reader is started.
+    m_readerThread = NULL;
+    m_readerQueue = NULL;
+    m_readerNotifyFD[0] = m_readerNotifyFD[1] = -1;
+    m_readerWakeFD[0] = m_readerWakeFD[1] = -1;
+    m_readerSavedFlags = 0;
+    m_readerStop.store(0);
+    m_readerDone.store(0);
+    m_readerNotified.store(0);
+}
+
+// Check whether the last read or write failed only because it would block.
+static int atkWouldBlock()
+{
+#if defined(__linux__) || defined(__APPLE__)
+    return ((errno == EAGAIN) || (errno == EWOULDBLOCK));
+#else
+    return(0);
+#endif
 }
 
 AtkWire::~AtkWire()
 {
+    // The reader thread must not outlive the wire.
+    if (m_readerThread) stopReaderThread();
+    if (m_recorder) delete m_recorder;
+
     // Delete all msgs in queue.
     for (; m_head; )
 	{
@@ -71,6 +280,40 @@ AtkWire::~AtkWire()
 		m_head = next;
     }
 
+    // And all replies that were never waited for.
+    while (m_replyHead)
+	{
+		AtkWireMsg* next = m_replyHead->m_next;
+		delete m_replyHead;
+		m_replyHead = next;
+    }
+
+    // Don't lose anything still buffered or queued for the other side.
+    if ((m_sendEnd > m_sendStart || m_coalesceHead || m_bulkHead) && !m_lostConnection)
+		flush(1);
+    while (m_coalesceHead)
+	{
+		AtkWireCoalescedMsg* next = m_coalesceHead->m_next;
+		delete m_coalesceHead->m_msg;
+		AtkWirePool::release(m_coalesceHead->m_key);
+		AtkWirePool::release(m_coalesceHead);
+		m_coalesceHead = next;
+    }
+    while (m_bulkHead)
+	{
+		AtkWireMsg* next = m_bulkHead->m_next;
+		delete m_bulkHead;
+		m_bulkHead = next;
+    }
+
+    // Close descriptors whose frames never arrived.
+    for (int i = 0; i < m_passedFDs.getLength(); i++) close(m_passedFDs[i]);
+
+    if (m_partialMsg) delete m_partialMsg;
+    if (m_fragMsg) delete m_fragMsg;
+    if (m_recvBuf) mlFree(m_recvBuf);
+    if (m_sendBuf) mlFree(m_sendBuf);
+
     // Close the fds.
     close(m_readFD);
     close(m_writeFD);
@@ -80,8 +323,51 @@ int
 AtkWire::sendMsg(void* destObj, const char* msgName, void* msgData, 
 	int msgDataLen)
 {
-    AtkWireMsg msg(destObj, msgName, 0, msgData, msgDataLen);
-    return(sendMsg(&msg));
+    // Borrow the payload rather than copying it into the message.
+    AtkWireBuffer buffer;
+    buffer.m_data = msgData;
+    buffer.m_length = msgDataLen;
+    return(sendMsg(destObj, msgName, &buffer, (msgData && msgDataLen > 0) ? 1 : 0));
+}
+
+int
+AtkWire::sendMsg(void* destObj, const char* msgName,
+	const AtkWireBuffer* buffers, int numBuffers)
+{
+    // Must have a valid connection.
+    if (m_lostConnection)
+	{
+		printf("WIRE: Lost Connection\n");
+		return(-1);
+    }
+
+    // Make sure writeFD is valid.
+    if (m_writeFD < 0 )
+	{
+		printf("WIRE: bad write FD\n");
+		return(-2);
+    }
+
+    if (g_threadCapture)
+	{
+		g_threadCapture->addBuffers(msgName, buffers, numBuffers);
+		return(0);
+    }
+
+    // Build the header only; the payload stays in the caller's buffers.
+    AtkWireMsg msg(destObj, msgName);
+    int dataLen = 0;
+    for (int i = 0; i < numBuffers; i++)
+	{
+		if (buffers[i].m_data && buffers[i].m_length > 0)
+			dataLen += buffers[i].m_length;
+    }
+    msg.m_totalMsgLen = msg.getHeaderLength() + dataLen;
+
+    // Messages held back for coalescing were sent first.
+    if (m_coalesceHead && !m_drainingCoalesced && drainCoalesced(1) < 0) return(-4);
+
+    return(sendFrame(&msg, buffers, numBuffers));
 }
 
 int 
@@ -108,214 +394,2259 @@ AtkWire::sendMsg(AtkWireMsg* msg)
 		return(-2);
     }
 
-    // Write out msg header.
-    if (mlWrite(m_writeFD, msg->getStartAddress(), msg->getHeaderLength()) < 0)
+    if (g_threadCapture)
 	{
-		printf("WIRE: Could not write header.  Errno: %d\n", g_mlErrno);
-		return(-3);
+		g_threadCapture->add(msg);
+		return(0);
     }
 
-    // Write out data.
-    if (msg->getDataLength() > 0)
-	{
-		int wlen;
-		if ((wlen = mlWrite(m_writeFD, msg->m_msgData, msg->getDataLength())) < 0)
-		{
-			printf("WIRE: Could not write data.  Errno: %d\n", g_mlErrno);
-			return(-4);
-		}
-		if (wlen != msg->getDataLength())
-		{
-			printf("WIRE: write len != data len    %d, %d\n", wlen, 
-			   msg->getDataLength());
-			MLE_ASSERT(0);
-		}
-    }
+    // Messages held back for coalescing were sent first.
+    if (m_coalesceHead && !m_drainingCoalesced && drainCoalesced(1) < 0) return(-4);
 
-	MLE_DEBUG_CAT("ATK",
-		printf("WIRE: Sent %s msg to %x object\n", msg->m_msgName, msg->m_destObj);
-		/*
-		printf("     Detail: ");
-		for (int h=0; h<msg->getHeaderLength(); h++) printf("%x ", msg->msgName[h]);
-		printf("\n");
-		*/
-	);
+    AtkWireBuffer buffer;
+    buffer.m_data = msg->m_msgData;
+    buffer.m_length = msg->getDataLength();
+    return(sendFrame(msg, &buffer, (buffer.m_data && buffer.m_length > 0) ? 1 : 0));
+}
 
-    // Success.
-    return(0);
+int
+AtkWire::sendBulkMsg(AtkWireMsg* msg)
+{
+    m_forceBulk = 1;
+    int status = sendMsg(msg);
+    m_forceBulk = 0;
+    return(status);
 }
 
-AtkWireMsg* 
-AtkWire::recvMsg()
+int
+AtkWire::sendCoalescedMsg(AtkWireMsg* msg, const char* key, const char* subKey)
 {
-    // Check read FD
-    if (m_readFD < 0)
+    // Must have a valid connection.
+    if (m_lostConnection)
 	{
-		printf("WIRE: Bad read FD\n");
-		return(NULL);
+		printf("WIRE: Lost Connection\n");
+		return(-1);
     }
 
-    // If any msgs are on the queue - return those.
-    if (m_head)
+    // Must have a valid msg.
+    if (!msg)
 	{
-		AtkWireMsg* ret = m_head;
-		if (m_head == m_tail)
-		{
-			m_head = m_tail = 0;
-		} else
-		{
-			m_head = m_head->m_next;
-		}
-		return(ret);
+		printf("WIRE: Null msg\n");
+		return(-1);
+    }
+
+    // With nothing held and room to write, there is nothing to coalesce.
+    if (g_threadCapture) return(sendMsg(msg));
+    if (!m_coalesceHead && m_sendEnd == m_sendStart && atkCanWrite(m_writeFD))
+		return(sendMsg(msg));
+
+    if (!key) key = "";
+    if (!subKey) subKey = "";
+    unsigned int hash = (atkHashString(msg->m_msgName) * 31 + atkHashString(key)) * 31 +
+		atkHashString(subKey);
+
+    // Copy the message, since it may be held after the call returns.
+    int dataLen = msg->getDataLength();
+    AtkWireMsg* copy = new AtkWireMsg();
+    atkCopyHeader(copy, msg);
+    copy->allocMsgData();
+    if (dataLen > 0) memcpy(copy->m_msgData, msg->m_msgData, dataLen);
+
+    // The newest value replaces one still waiting with the same key.
+    AtkWireCoalescedMsg* held;
+    for (held = m_coalesceHead; held; held = held->m_next)
+	{
+		if (held->m_hash == hash && !strcmp(held->m_key, key) &&
+			!strcmp(held->m_subKey, subKey) &&
+			!strcmp(held->m_msg->m_msgName, msg->m_msgName))
+			break;
+    }
+    if (held)
+	{
+		m_coalescedBytes += dataLen - held->m_msg->getDataLength();
+		delete held->m_msg;
+		held->m_msg = copy;
+		m_numSuperseded++;
+    } else
+	{
+		held = (AtkWireCoalescedMsg*) AtkWirePool::alloc(sizeof(AtkWireCoalescedMsg));
+		held->m_hash = hash;
+		int keyLen = strlen(key) + 1;
+		held->m_key = (char*) AtkWirePool::alloc(keyLen + strlen(subKey) + 1);
+		held->m_subKey = held->m_key + keyLen;
+		strcpy(held->m_key, key);
+		strcpy(held->m_subKey, subKey);
+		held->m_msg = copy;
+		held->m_next = NULL;
+		if (m_coalesceTail) m_coalesceTail->m_next = held;
+		else m_coalesceHead = held;
+		m_coalesceTail = held;
+		m_numCoalesced++;
+		m_coalescedBytes += dataLen;
     }
 
-    // OK, find it from the FD.
-    return(recvMsgFromFD());
+    // Write whatever the wire has room for now.
+    return(drainCoalesced(0));
 }
 
-AtkWireMsg* 
-AtkWire::recvMsgFromFD()
+int
+AtkWire::sendFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers)
 {
-    // Allocate a msg.
-    AtkWireMsg* msg = new AtkWireMsg();
+    // A reply to a member of a batch is part of the batch's reply.
+    if (m_replyBatch && msg->isReplyMsg())
+	{
+		m_replyBatch->addBuffers(msg->m_msgName, buffers, numBuffers);
+		return(0);
+    }
 
-    // Read msg header.
-    int len;
-    if ((len = mlRead(m_readFD, msg->getStartAddress(), msg->getHeaderLength())) < 0)
+    if (m_recorder) m_recorder->record(ATK_WIRE_LOG_SEND, msg, buffers, numBuffers);
+    if (isStatsEnabled())
 	{
-		printf("WIRE: Could not read header.  Errno: %d\n", g_mlErrno);
-		delete msg;
-		return(NULL);
-    } else if (len == 0)
+		int bytes = 0;
+		for (int i = 0; i < numBuffers; i++)
+			if (buffers[i].m_data && buffers[i].m_length > 0) bytes += buffers[i].m_length;
+		m_stats.recordSend(msg->m_msgName, bytes);
+    }
+
+    // Offer compression, compact headers and fragments before the first
+    // message that could use them.
+    if ((m_compressThreshold > 0 || m_compactHeaders || m_bulkThreshold > 0) && !m_sentOptions)
+		sendOptions();
+    if (m_compactHeaders && !m_sendCompact && (m_peerCaps & ATK_WIRE_CAP_COMPACT) &&
+		switchHeaders(1) < 0)
+		return(-3);
+
+    // Frames can only be flagged if the name leaves room for the flags.
+    int canFlag = (strlen(msg->m_msgName) < ATK_WIRE_MSG_FLAGS_INDEX);
+
+    // A reply echoes the ID of the request being handled; a request is
+    // tagged only if the other side will echo it.
+    unsigned int id = 0;
+    if (msg->isReplyMsg())
 	{
-//printf("WIRE: ZERO len in read:    %d\n", m_readFD);     
-		m_lostConnection = 1;
-		mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
-		delete msg;
-		return(NULL);
-    } else if (len != msg->getHeaderLength())
+		// One that carries its own ID leaves that of the request being
+		// handled for its reply.
+		id = msg->getCorrelationID();
+		if (!id)
+		{
+			id = m_replyCorrelationID;
+			m_replyCorrelationID = 0;
+		}
+    } else if (m_peerCaps & ATK_WIRE_CAP_CORRELATE)
 	{
-printf("WIRE: len != msgHeaderLen   %d, %d\n", len, msg->getHeaderLength());
-		MLE_ASSERT(0);
+		id = msg->getCorrelationID();
     }
+    if (!canFlag) id = 0;
 
-    // Allocate space.
-    msg->allocMsgData();
+    int dataLen = msg->getDataLength();
+    int compress = (canFlag && m_compressThreshold > 0 &&
+		(m_peerCaps & ATK_WIRE_CAP_COMPRESS) && dataLen >= m_compressThreshold);
+    if (!compress && !id) return(writeLaneFrame(msg, buffers, numBuffers));
 
-    // Read data
-    if (msg->getDataLength() > 0)
+    // The compressed payload is led by the raw length.
+    char* packed = NULL;
+    int packedLen = 0;
+    if (compress)
 	{
-		for (int totalLen=0; totalLen <msg->getDataLength(); totalLen+=len)
+		// The compressor needs the payload in one piece.
+		const char* raw = NULL;
+		char* gathered = NULL;
+		int count = 0;
+		for (int i = 0; i < numBuffers; i++)
 		{
-			if ((len = mlRead(m_readFD, ((char*) msg->m_msgData)+totalLen, 
-				msg->getDataLength()-totalLen)) < 0)
-			{
-				printf("WIRE: could not read msg data.  Errno: %d\n", g_mlErrno);
-				delete msg;
-				return(NULL);
-			} else if (len == 0)
+			if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+			raw = (const char*) buffers[i].m_data;
+			count++;
+		}
+		if (count > 1)
+		{
+			gathered = (char*) mlMalloc(dataLen);
+			int offset = 0;
+			for (int i = 0; i < numBuffers; i++)
 			{
-				printf("ZERO len in read 2:    %d\n", m_readFD);     
-				exit(-1);
-				mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
-				m_lostConnection = 1;
-				delete msg;
-				return(NULL);
+				if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+				memcpy(gathered + offset, buffers[i].m_data, buffers[i].m_length);
+				offset += buffers[i].m_length;
 			}
+			raw = gathered;
+		}
+
+		int maxLen = sizeof(int) + AtkWireCompressor::getMaxCompressedLength(dataLen);
+		packed = (char*) mlMalloc(maxLen);
+		memcpy(packed, &dataLen, sizeof(int));
+		packedLen = AtkWireCompressor::compress(raw, dataLen, packed + sizeof(int),
+			maxLen - sizeof(int));
+		if (gathered) mlFree(gathered);
+
+		// Not worth it unless it saves at least a sixteenth.
+		if (packedLen <= 0 || packedLen + (int) sizeof(int) > dataLen - dataLen / 16)
+		{
+			mlFree(packed);
+			packed = NULL;
+			if (!id) return(writeLaneFrame(msg, buffers, numBuffers));
+		} else
+		{
+			packedLen += sizeof(int);
 		}
     }
 
-// printf("WIRE: Recved %s msg from %x object\n", msg->msgName, msg->destObj);
-/*
-printf("     Detail: ");
-for (int h=0; h<msg->getHeaderLength(); h++) printf("%x ", msg->msgName[h]);
-printf("\n");
-*/
+    // Gather the payload, followed by the correlation ID.
+    AtkWireBuffer local[8];
+    AtkWireBuffer* frameBuffers = local;
+    int numFrameBuffers = 0;
+    int frameDataLen = 0;
+    int flags = msg->getMsgFlags();
+    if (packed)
+	{
+		frameBuffers[numFrameBuffers].m_data = packed;
+		frameBuffers[numFrameBuffers++].m_length = packedLen;
+		frameDataLen = packedLen;
+		flags |= ATK_WIRE_MSG_FLAG_COMPRESSED;
+    } else
+	{
+		if (numBuffers + 1 > (int) (sizeof(local) / sizeof(local[0])))
+			frameBuffers = (AtkWireBuffer*) mlMalloc((numBuffers + 1) * sizeof(AtkWireBuffer));
+		for (int i = 0; i < numBuffers; i++) frameBuffers[numFrameBuffers++] = buffers[i];
+		frameDataLen = dataLen;
+    }
+    if (id)
+	{
+		frameBuffers[numFrameBuffers].m_data = &id;
+		frameBuffers[numFrameBuffers++].m_length = sizeof(id);
+		frameDataLen += sizeof(id);
+		flags |= ATK_WIRE_MSG_FLAG_CORRELATED;
+    }
 
-    // Success.
-    return(msg);
+    AtkWireMsg frame;
+    atkCopyHeader(&frame, msg);
+    frame.m_totalMsgLen = frame.getHeaderLength() + frameDataLen;
+    frame.setMsgFlags(flags);
+
+    int status = writeLaneFrame(&frame, frameBuffers, numFrameBuffers);
+    if (frameBuffers != local) mlFree(frameBuffers);
+
+    if (packed)
+	{
+		if (status == 0)
+		{
+			m_compressionStats.m_sentMsgs++;
+			m_compressionStats.m_sentRawBytes += dataLen;
+			m_compressionStats.m_sentWireBytes += packedLen;
+		}
+		mlFree(packed);
+    }
+    return(status);
 }
 
-AtkWireMsg* 
-AtkWire::sendSyncMsg(AtkWired* wired, void* destObj, const char* msgName, 
-	void* msgData, int msgDataLen)
+int
+AtkWire::writeLaneFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers)
 {
-    AtkWireMsg msg(destObj, msgName, 1, msgData, msgDataLen);
-    return sendSyncMsg(wired, &msg);
+    // Bulk frames need flags, and the other side must reassemble them.
+    // A payload going out-of-band never holds up the descriptor anyway.
+    int dataLen = msg->getDataLength();
+    int bulk = (m_bulkThreshold > 0 && (m_peerCaps & ATK_WIRE_CAP_FRAGMENT) &&
+		strlen(msg->m_msgName) < ATK_WIRE_MSG_FLAGS_INDEX &&
+		(m_forceBulk || dataLen >= m_bulkThreshold) &&
+		!(m_oobThreshold > 0 && m_writeIsSocket && dataLen >= m_oobThreshold));
+    if (bulk) return(queueBulkFrame(msg, buffers, numBuffers));
+
+    int status = writeFrame(msg, buffers, numBuffers);
+    if (status == 0 && m_bulkHead && pumpBulk(0) < 0) return(-4);
+    return(status);
 }
 
-AtkWireMsg* 
-AtkWire::sendSyncMsg(AtkWired* wired, AtkWireMsg* msg)
+int
+AtkWire::queueBulkFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers)
 {
-    // Must have a valid connection.
-    if (m_lostConnection)
+    // The caller's buffers are only borrowed, so the payload is copied.
+    int dataLen = msg->getDataLength();
+    char* data = (dataLen > 0) ? (char*) AtkWirePool::alloc(dataLen) : NULL;
+    int offset = 0;
+    for (int i = 0; i < numBuffers; i++)
 	{
-		printf("WIRE: Lost Connection\n");
-		return(NULL);
+		if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+		memcpy(data + offset, buffers[i].m_data, buffers[i].m_length);
+		offset += buffers[i].m_length;
     }
 
-    // First send the msg.
-    if (sendMsg(msg) < 0)
+    AtkWireMsg* frame = new AtkWireMsg();
+    atkCopyHeader(frame, msg);
+    frame->adoptPooledMsgData(data, dataLen);
+
+    if (m_bulkTail) m_bulkTail->m_next = frame;
+    else m_bulkHead = frame;
+    m_bulkTail = frame;
+    m_bulkBytes += dataLen;
+
+    MLE_DEBUG_CAT("ATK",
+		printf("WIRE: Queued %s msg, %d bytes, on the bulk lane\n", msg->m_msgName, dataLen);
+    );
+
+    return((pumpBulk(0) < 0) ? -4 : 0);
+}
+
+int
+AtkWire::writeBulkFragment()
+{
+    AtkWireMsg* head = m_bulkHead;
+    int dataLen = head->getDataLength();
+    int chunk = dataLen - m_bulkOffset;
+    if (chunk > m_fragmentSize) chunk = m_fragmentSize;
+
+    AtkWireBuffer buffers[2];
+    int numBuffers = 0;
+    int fragLen = chunk;
+    if (m_bulkOffset == 0)
 	{
-		// Error.
-		printf("WIRE: send msg from sendSyncMsg failed\n");
-		return(NULL);
+		buffers[numBuffers].m_data = &dataLen;
+		buffers[numBuffers++].m_length = sizeof(int);
+		fragLen += sizeof(int);
     }
+    buffers[numBuffers].m_data = ((char*) head->m_msgData) + m_bulkOffset;
+    buffers[numBuffers++].m_length = chunk;
 
-    // Now we have to wait for a reply
-    for (;;)
-	{
-		AtkWireMsg* msg = recvMsgFromFD();
+    AtkWireMsg frag;
+    atkCopyHeader(&frag, head);
+    frag.m_totalMsgLen = frag.getHeaderLength() + fragLen;
+    frag.setMsgFlags(head->getMsgFlags() | ATK_WIRE_MSG_FLAG_FRAGMENT);
 
-		// If no message  - we have lost connection.
-		if (!msg) return(NULL);
+    int status = writeFrame(&frag, buffers, numBuffers);
+    if (status < 0) return(status);
+
+    m_bulkOffset += chunk;
+    m_bulkBytes -= chunk;
+    if (m_bulkOffset == dataLen)
+	{
+		m_bulkHead = head->m_next;
+		if (!m_bulkHead) m_bulkTail = NULL;
+		m_bulkOffset = 0;
+		delete head;
+    }
+    return(0);
+}
 
-		// If a reply msg return it.
-		if (msg->isReplyMsg())
+long
+AtkWire::pumpBulk(int block)
+{
+    int burst = 0;
+    while (m_bulkHead)
+	{
+		// Frames buffered or held on the interactive lane go first.
+		if (m_sendEnd > m_sendStart)
 		{
-			return(msg);
+			if (!block) break;
+			if (flushSendBuffer(1) < 0) return(-1);
 		}
-
-		// If a sync msg - respond to it - otherwise we might have deadlock 
-		// situations.
-		if (msg->isSyncMsg())
+		if (m_coalesceHead)
 		{
+			if (!block) break;
+			if (drainCoalesced(1) < 0) return(-1);
+			continue;
+		}
+		if (!block && (burst >= ATK_WIRE_BULK_BURST || !atkCanWrite(m_writeFD))) break;
 
-			AtkWired* w = (AtkWired*) msg->m_destObj;
+		if (writeBulkFragment() < 0) return(-1);
+		if (m_sendBuffering && flushSendBuffer(block) < 0) return(-1);
+		burst++;
+    }
+    return(m_bulkBytes);
+}
 
-			MLE_DEBUG_CAT("ATK",
-				printf("WIRED (inside sendSyncMsg): delivering %s msg to %d obj\n",
-					msg->m_msgName ? msg->m_msgName : "UNKNOWN", w);
-			);
+int
+AtkWire::drainCoalesced(int block)
+{
+    m_drainingCoalesced = 1;
+    int status = 0;
+    while (m_coalesceHead)
+	{
+		// Wait for the send buffer to drain, so nothing is held twice.
+		if (!block && (m_sendEnd > m_sendStart || !atkCanWrite(m_writeFD))) break;
 
-			// If no id - deliver msg to itself.
-			if (!w)
-			{
-				wired->deliverMsg(msg);
-			} else
-			{
-				// Dtherwise deliver to obj.
-				w->deliverMsg(msg);
-			}
-		} else
+		AtkWireCoalescedMsg* held = m_coalesceHead;
+		m_coalesceHead = held->m_next;
+		if (!m_coalesceHead) m_coalesceTail = NULL;
+		m_numCoalesced--;
+		m_coalescedBytes -= held->m_msg->getDataLength();
+
+		status = sendMsg(held->m_msg);
+		delete held->m_msg;
+		AtkWirePool::release(held->m_key);
+		AtkWirePool::release(held);
+		if (status < 0) break;
+
+		if (m_sendBuffering && flushSendBuffer(block) < 0)
 		{
-			// Otherwise, place msg on queue.
-			if (m_tail) m_tail->m_next = msg;
-			m_tail = msg;
-			if (!m_head) m_head = msg;
+			status = -4;
+			break;
 		}
     }
+    m_drainingCoalesced = 0;
+    return(status);
 }
 
-int
-AtkWire::getNumMsgs()
+AtkWireBatch*
+AtkWire::setThreadCapture(AtkWireBatch* batch)
 {
-    AtkWireMsg* m= m_head;
-	int count;
-    for (count=0; m; m=m->m_next) count++;
-    return(count);
+    AtkWireBatch* old = g_threadCapture;
+    g_threadCapture = batch;
+    return(old);
+}
+
+void
+AtkWire::setRecorder(AtkWireRecorder* recorder)
+{
+    if (m_recorder && m_recorder != recorder) delete m_recorder;
+    m_recorder = recorder;
+}
+
+void
+AtkWire::setStatsEnabled(int onOff)
+{
+    m_statsEnabled.store(onOff ? 1 : 0);
 }
 
+void
+AtkWire::setBulkThreshold(int threshold, int fragmentSize)
+{
+    m_bulkThreshold = (threshold > 0) ? threshold : 0;
+    m_fragmentSize = (fragmentSize > 0) ? fragmentSize : ATK_WIRE_FRAGMENT_SIZE;
+}
+
+void
+AtkWire::setCompressionThreshold(int threshold)
+{
+    m_compressThreshold = (threshold > 0) ? threshold : 0;
+}
+
+int
+AtkWire::getCapabilities()
+{
+    return(ATK_WIRE_CAP_COMPRESS | ATK_WIRE_CAP_CORRELATE | ATK_WIRE_CAP_COMPACT |
+		ATK_WIRE_CAP_FRAGMENT);
+}
+
+int
+AtkWire::sendOptions()
+{
+    m_sentOptions = 1;
+
+    AtkWireMsg msg(NULL, ATK_WIRE_OPTIONS_MSG_NAME);
+    msg.addParam(getCapabilities());
+    msg.addParam(ATK_WIRE_PROTOCOL_VERSION);
+    return(sendMsg(&msg));
+}
+
+void
+AtkWire::setCompactHeaders(int onOff)
+{
+    m_compactHeaders = onOff ? 1 : 0;
+
+    // Turning them on waits for the other side; turning them off does not.
+    if (!m_compactHeaders && m_sendCompact) switchHeaders(0);
+}
+
+int
+AtkWire::switchHeaders(int compact)
+{
+    AtkWireMsg msg(NULL, ATK_WIRE_FRAMING_MSG_NAME);
+    msg.addParam(compact ? ATK_WIRE_PROTOCOL_VERSION : 1);
+
+    // Written directly, since sendFrame() is what decides to switch.
+    AtkWireBuffer buffer;
+    buffer.m_data = msg.m_msgData;
+    buffer.m_length = msg.getDataLength();
+    int status = writeFrame(&msg, &buffer, 1);
+    if (status < 0) return(status);
+
+    m_sendCompact = compact ? 1 : 0;
+    m_sendNames.clear();
+    return(0);
+}
+
+int
+AtkWire::encodeHeader(AtkWireMsg* msg, char* header)
+{
+    if (!m_sendCompact)
+	{
+		// The original header: the total length, the name, the
+		// destination handle and the sync flag, packed.  The handle is
+		// widened to the pointer the destination used to be.
+		int len = 0;
+		void* destObj = (void*) (uintptr_t) msg->getDestHandle();
+		memcpy(header + len, &msg->m_totalMsgLen, sizeof(int));
+		len += sizeof(int);
+		memcpy(header + len, msg->m_msgName, MAX_MSG_NAME_LEN);
+		len += MAX_MSG_NAME_LEN;
+		memcpy(header + len, &destObj, sizeof(void*));
+		len += sizeof(void*);
+		header[len++] = msg->m_waitForReply;
+		MLE_ASSERT(len == msg->getHeaderLength());
+		return(len);
+    }
+
+    // The first frame to use a name carries it, defining its ID; so does
+    // every frame whose name did not fit in the table.
+    int added;
+    int id = m_sendNames.intern(msg->m_msgName, &added);
+    int flags = msg->getMsgFlags() & ATK_WIRE_HEADER_FRAME_FLAGS;
+    if (added || !id) flags |= ATK_WIRE_HEADER_NAME;
+    if (msg->getDestHandle()) flags |= ATK_WIRE_HEADER_DEST;
+    if (msg->m_waitForReply) flags |= ATK_WIRE_HEADER_SYNC;
+
+    int len = 0;
+    header[len++] = (char) flags;
+    header[len++] = (char) (id & 0xFF);
+    header[len++] = (char) ((id >> 8) & 0xFF);
+    len += atkPutVarint(header + len, (uint64_t) msg->getDataLength());
+    if (flags & ATK_WIRE_HEADER_DEST)
+		len += atkPutVarint(header + len, (uint64_t) msg->getDestHandle());
+    if (flags & ATK_WIRE_HEADER_NAME)
+	{
+		int nameLen = (int) strlen(msg->m_msgName);
+		if (nameLen > MAX_MSG_NAME_LEN - 1) nameLen = MAX_MSG_NAME_LEN - 1;
+		header[len++] = (char) nameLen;
+		memcpy(header + len, msg->m_msgName, nameLen);
+		len += nameLen;
+    }
+    MLE_ASSERT(len <= ATK_WIRE_MAX_HEADER_LENGTH);
+    return(len);
+}
+
+int
+AtkWire::decodeHeader(const char* buf, int avail, AtkWireMsg* msg, int* dataLen)
+{
+    if (!m_recvCompact)
+	{
+		// The original header is the message fields, led by the total length.
+		int headerLen = AtkWireMsg::getFrameHeaderLength();
+		if (avail < headerLen) return(0);
+		int len = 0;
+		memcpy(&msg->m_totalMsgLen, buf + len, sizeof(int));
+		len += sizeof(int);
+		memcpy(msg->m_msgName, buf + len, MAX_MSG_NAME_LEN);
+		len += MAX_MSG_NAME_LEN;
+		memcpy(&msg->m_destObj, buf + len, sizeof(void*));
+		len += sizeof(void*);
+		if ((uintptr_t) msg->m_destObj > 0xFFFFFFFFu)
+		{
+			printf("WIRE: Bad destination handle %p\n", msg->m_destObj);
+			return(-1);
+		}
+		msg->m_waitForReply = buf[len];
+		if (msg->m_totalMsgLen < headerLen)
+		{
+printf("WIRE: len != msgHeaderLen   %d, %d\n", msg->m_totalMsgLen, headerLen);
+			MLE_ASSERT(0);
+			return(-1);
+		}
+		*dataLen = msg->m_totalMsgLen - headerLen;
+		return(headerLen);
+    }
+
+    const unsigned char* p = (const unsigned char*) buf;
+    if (avail < 3) return(0);
+    int flags = p[0];
+    int id = p[1] | (p[2] << 8);
+    int len = 3;
+
+    uint64_t value;
+    int n = atkGetVarint(p + len, avail - len, &value);
+    if (n <= 0) return(n);
+    if (value > (uint64_t) (INT_MAX - AtkWireMsg::getFrameHeaderLength()))
+	{
+		printf("WIRE: Bad msg length %llu\n", (unsigned long long) value);
+		return(-1);
+    }
+    len += n;
+    int payloadLen = (int) value;
+
+    void* destObj = NULL;
+    if (flags & ATK_WIRE_HEADER_DEST)
+	{
+		if ((n = atkGetVarint(p + len, avail - len, &value)) <= 0) return(n);
+		if (value > 0xFFFFFFFFu)
+		{
+			printf("WIRE: Bad destination handle %llu\n", (unsigned long long) value);
+			return(-1);
+		}
+		len += n;
+		destObj = (void*) (uintptr_t) value;
+    }
+
+    char name[MAX_MSG_NAME_LEN];
+    if (flags & ATK_WIRE_HEADER_NAME)
+	{
+		if (avail < len + 1) return(0);
+		int nameLen = p[len++];
+		if (nameLen >= MAX_MSG_NAME_LEN ||
+			((flags & ATK_WIRE_HEADER_FRAME_FLAGS) && nameLen >= ATK_WIRE_MSG_FLAGS_INDEX))
+		{
+			printf("WIRE: Bad msg name length %d\n", nameLen);
+			return(-1);
+		}
+		if (avail < len + nameLen) return(0);
+		memcpy(name, p + len, nameLen);
+		name[nameLen] = 0;
+		len += nameLen;
+		if (id) m_recvNames.define(id, name);
+    } else
+	{
+		const char* known = m_recvNames.lookup(id);
+		if (!known)
+		{
+			printf("WIRE: Unknown msg name ID %d\n", id);
+			return(-1);
+		}
+		strcpy(name, known);
+    }
+
+    memset(msg->m_msgName, 0, MAX_MSG_NAME_LEN);
+    strcpy(msg->m_msgName, name);
+    if (flags & ATK_WIRE_HEADER_FRAME_FLAGS)
+		msg->setMsgFlags(flags & ATK_WIRE_HEADER_FRAME_FLAGS);
+    msg->m_destObj = destObj;
+    msg->m_waitForReply = (flags & ATK_WIRE_HEADER_SYNC) ? 1 : 0;
+    msg->m_totalMsgLen = msg->getHeaderLength() + payloadLen;
+    *dataLen = payloadLen;
+    return(len);
+}
+
+int
+AtkWire::writeFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers)
+{
+    if (m_oobThreshold > 0 && m_writeIsSocket && msg->getDataLength() >= m_oobThreshold &&
+		strlen(msg->m_msgName) < ATK_WIRE_MSG_FLAGS_INDEX)
+		return(writeOOBFrame(msg, buffers, numBuffers));
+
+    if (m_sendBuffering) return(bufferFrame(msg, buffers, numBuffers));
+
+    // Anything buffered before buffering was turned off goes first.
+    if (m_sendEnd > m_sendStart && flushSendBuffer(1) < 0) return(-3);
+
+#if defined(__linux__) || defined(__APPLE__)
+    // Gather the header and payload into one vector so that the whole
+    // frame goes out in as few system calls as possible.
+    struct iovec stackIov[8];
+    struct iovec* iov = stackIov;
+    if (numBuffers + 1 > (int) (sizeof(stackIov) / sizeof(stackIov[0])))
+	{
+		iov = (struct iovec*) mlMalloc(sizeof(struct iovec) * (numBuffers + 1));
+    }
+
+    char header[ATK_WIRE_MAX_HEADER_LENGTH];
+    int headerLen = encodeHeader(msg, header);
+    int iovCount = 0;
+    iov[iovCount].iov_base = header;
+    iov[iovCount].iov_len = headerLen;
+    iovCount++;
+    for (int i = 0; i < numBuffers; i++)
+	{
+		if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+		iov[iovCount].iov_base = (void*) buffers[i].m_data;
+		iov[iovCount].iov_len = buffers[i].m_length;
+		iovCount++;
+    }
+
+    // Write until the entire frame is out, resuming after partial writes.
+    int status = 0;
+    long totalLen = headerLen + msg->getDataLength();
+    long written = 0;
+    struct iovec* cur = iov;
+    int curCount = iovCount;
+    while (curCount > 0)
+	{
+		ssize_t wlen = writev(m_writeFD, cur, (curCount > IOV_MAX) ? IOV_MAX : curCount);
+		if (wlen < 0)
+		{
+			if (errno == EINTR) continue;
+			if (atkWouldBlock())
+			{
+				// The descriptor is shared with a non-blocking reader;
+				// wait for room rather than dropping part of the frame.
+				struct pollfd pfd;
+				pfd.fd = m_writeFD;
+				pfd.events = POLLOUT;
+				pfd.revents = 0;
+				if (poll(&pfd, 1, -1) >= 0 || errno == EINTR) continue;
+			}
+			if (written < headerLen)
+			{
+				printf("WIRE: Could not write header.  Errno: %d\n", errno);
+				status = -3;
+			} else
+			{
+				printf("WIRE: Could not write data.  Errno: %d\n", errno);
+				status = -4;
+			}
+			break;
+		}
+		written += wlen;
+
+		// Skip over the vectors that have been written completely.
+		while (curCount > 0 && (size_t) wlen >= cur->iov_len)
+		{
+			wlen -= cur->iov_len;
+			cur++;
+			curCount--;
+		}
+		if (curCount > 0)
+		{
+			cur->iov_base = ((char*) cur->iov_base) + wlen;
+			cur->iov_len -= wlen;
+		}
+    }
+
+    if (iov != stackIov) mlFree(iov);
+    if (status < 0) return(status);
+    MLE_ASSERT(written == totalLen);
+#else
+    // Write out msg header.
+    char header[ATK_WIRE_MAX_HEADER_LENGTH];
+    int headerLen = encodeHeader(msg, header);
+    if (mlWrite(m_writeFD, header, headerLen) < 0)
+	{
+		printf("WIRE: Could not write header.  Errno: %d\n", g_mlErrno);
+		return(-3);
+    }
+
+    // Write out data.
+    for (int i = 0; i < numBuffers; i++)
+	{
+		if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+
+		int wlen;
+		if ((wlen = mlWrite(m_writeFD, (void*) buffers[i].m_data, buffers[i].m_length)) < 0)
+		{
+			printf("WIRE: Could not write data.  Errno: %d\n", g_mlErrno);
+			return(-4);
+		}
+		if (wlen != buffers[i].m_length)
+		{
+			printf("WIRE: write len != data len    %d, %d\n", wlen, 
+			   buffers[i].m_length);
+			MLE_ASSERT(0);
+		}
+    }
+#endif /* __linux__ || __APPLE__ */
+
+	MLE_DEBUG_CAT("ATK",
+		printf("WIRE: Sent %s msg to %x object\n", msg->m_msgName, msg->m_destObj);
+		/*
+		printf("     Detail: ");
+		for (int h=0; h<msg->getHeaderLength(); h++) printf("%x ", msg->msgName[h]);
+		printf("\n");
+		*/
+	);
+
+    // Success.
+    return(0);
+}
+
+int
+AtkWire::writeOOBFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers)
+{
+#if defined(__linux__)
+    // The descriptor travels with the control frame, so nothing buffered
+    // may be left behind it.
+    if (m_sendEnd > m_sendStart && flushSendBuffer(1) < 0) return(-3);
+
+    // Write the payload into a memfd.
+    int memFD = memfd_create("AtkWireOOB", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFD < 0)
+	{
+		printf("WIRE: Could not create memfd.  Errno: %d\n", errno);
+		return(-4);
+    }
+    int64_t dataLen = 0;
+    for (int i = 0; i < numBuffers; i++)
+	{
+		if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+
+		const char* data = (const char*) buffers[i].m_data;
+		int remaining = buffers[i].m_length;
+		while (remaining > 0)
+		{
+			ssize_t len = write(memFD, data, remaining);
+			if (len < 0)
+			{
+				if (errno == EINTR) continue;
+				printf("WIRE: Could not write memfd.  Errno: %d\n", errno);
+				close(memFD);
+				return(-4);
+			}
+			data += len;
+			remaining -= len;
+		}
+		dataLen += buffers[i].m_length;
+    }
+
+    // Seal it, so that the receiver can map it without fear of it changing.
+    if (fcntl(memFD, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+	{
+		printf("WIRE: Could not seal memfd.  Errno: %d\n", errno);
+		close(memFD);
+		return(-4);
+    }
+
+    // The control frame is the header, flagged, with the payload length.
+    AtkWireMsg controlMsg;
+    atkCopyHeader(&controlMsg, msg);
+    controlMsg.m_totalMsgLen = controlMsg.getHeaderLength() + (int) sizeof(dataLen);
+    controlMsg.setMsgFlags(controlMsg.getMsgFlags() | ATK_WIRE_MSG_FLAG_OOB);
+    char frame[ATK_WIRE_MAX_HEADER_LENGTH + sizeof(dataLen)];
+    int headerLen = encodeHeader(&controlMsg, frame);
+    int frameLen = headerLen + (int) sizeof(dataLen);
+    memcpy(frame + headerLen, &dataLen, sizeof(dataLen));
+
+    // Pass the descriptor with the first bytes of the frame.
+    struct iovec iov;
+    iov.iov_base = frame;
+    iov.iov_len = frameLen;
+    union
+	{
+		struct cmsghdr m_align;
+		char m_buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control.m_buf;
+    hdr.msg_controllen = sizeof(control.m_buf);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memFD, sizeof(int));
+
+    int status = 0;
+    int written = 0;
+    while (written < frameLen)
+	{
+		ssize_t len;
+		if (written == 0) len = sendmsg(m_writeFD, &hdr, MSG_NOSIGNAL);
+		else len = write(m_writeFD, frame + written, frameLen - written);
+		if (len < 0)
+		{
+			if (errno == EINTR) continue;
+			if (atkWouldBlock())
+			{
+				struct pollfd pfd;
+				pfd.fd = m_writeFD;
+				pfd.events = POLLOUT;
+				pfd.revents = 0;
+				if (poll(&pfd, 1, -1) >= 0 || errno == EINTR) continue;
+			}
+			printf("WIRE: Could not write out-of-band header.  Errno: %d\n", errno);
+			status = -3;
+			break;
+		}
+		written += len;
+    }
+
+    // The receiver holds its own reference once the frame is sent.
+    close(memFD);
+    if (status < 0) return(status);
+
+	MLE_DEBUG_CAT("ATK",
+		printf("WIRE: Sent %s msg to %x object, %d bytes out-of-band\n",
+			msg->m_msgName, msg->m_destObj, (int) dataLen);
+	);
+
+    return(0);
+#else
+    return(-4);
+#endif /* __linux__ */
+}
+
+int
+AtkWire::setOOBThreshold(int threshold)
+{
+    if (threshold > 0 && !m_writeIsSocket)
+	{
+		printf("WIRE: Out-of-band messages need a Unix socket\n");
+		return(-1);
+    }
+
+    m_oobThreshold = (threshold > 0) ? threshold : 0;
+    return(0);
+}
+
+int
+AtkWire::bufferFrame(AtkWireMsg* msg, const AtkWireBuffer* buffers, int numBuffers)
+{
+    int frameLen = msg->m_totalMsgLen;
+
+    // Apply the high-water policy when the reader has fallen behind.
+    if (getPendingBytes() + frameLen > m_highWaterMark)
+	{
+		int pending = flushSendBuffer(0);
+		if (pending < 0) return(-3);
+
+		if (pending > 0 && pending + frameLen > m_highWaterMark)
+		{
+			int policy = ATK_WIRE_HWM_BLOCK;
+			if (m_highWaterCallback)
+				policy = (*m_highWaterCallback)(this, msg->m_msgName, pending,
+					m_highWaterData);
+
+			if (policy == ATK_WIRE_HWM_DROP)
+			{
+				return(-5);
+			} else if (policy == ATK_WIRE_HWM_BLOCK)
+			{
+				if (flushSendBuffer(1) < 0) return(-3);
+			}
+		}
+    }
+
+    // The header is encoded only once the frame is sure to be sent, since
+    // encoding may define a name ID.
+    char header[ATK_WIRE_MAX_HEADER_LENGTH];
+    int headerLen = encodeHeader(msg, header);
+    frameLen = headerLen + msg->getDataLength();
+
+    // Make room behind the pending bytes, growing the buffer if need be.
+    if (m_sendEnd + frameLen > m_sendBufSize)
+	{
+		if (m_sendStart > 0)
+		{
+			if (m_sendEnd > m_sendStart)
+				memmove(m_sendBuf, m_sendBuf + m_sendStart, m_sendEnd - m_sendStart);
+			m_sendEnd -= m_sendStart;
+			m_sendStart = 0;
+		}
+		if (m_sendEnd + frameLen > m_sendBufSize)
+		{
+			int size = m_sendBufSize ? m_sendBufSize : ATK_WIRE_SEND_BUFFER_SIZE;
+			while (size < m_sendEnd + frameLen) size *= 2;
+			char* buf = (char*) mlRealloc(m_sendBuf, size);
+			if (!buf)
+			{
+				printf("WIRE: Could not grow send buffer to %d bytes\n", size);
+				return(-3);
+			}
+			m_sendBuf = buf;
+			m_sendBufSize = size;
+		}
+    }
+
+    // Copy the frame in.
+    memcpy(m_sendBuf + m_sendEnd, header, headerLen);
+    m_sendEnd += headerLen;
+    for (int i = 0; i < numBuffers; i++)
+	{
+		if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+		memcpy(m_sendBuf + m_sendEnd, buffers[i].m_data, buffers[i].m_length);
+		m_sendEnd += buffers[i].m_length;
+    }
+
+	MLE_DEBUG_CAT("ATK",
+		printf("WIRE: Buffered %s msg to %x object\n", msg->m_msgName, msg->m_destObj);
+	);
+
+    return(0);
+}
+
+int
+AtkWire::flush(int block)
+{
+    // The interactive lane goes first, then the messages held back for
+    // coalescing; the bulk lane follows once both are empty.
+    int pending = flushSendBuffer(block);
+    if (pending < 0) return(pending);
+    if (pending == 0 && m_coalesceHead)
+	{
+		if (drainCoalesced(block) < 0) return(-4);
+		pending = getPendingBytes();
+    }
+    if (pending == 0 && !m_coalesceHead && m_bulkHead && pumpBulk(block) < 0) return(-4);
+    return(getPendingBytes() + (int) (m_coalescedBytes + m_bulkBytes));
+}
+
+int
+AtkWire::flushSendBuffer(int block)
+{
+    while (m_sendEnd > m_sendStart)
+	{
+#if defined(__linux__) || defined(__APPLE__)
+		ssize_t len = write(m_writeFD, m_sendBuf + m_sendStart, m_sendEnd - m_sendStart);
+		if (len < 0)
+		{
+			if (errno == EINTR) continue;
+			if (atkWouldBlock())
+			{
+				if (!block) break;
+
+				struct pollfd pfd;
+				pfd.fd = m_writeFD;
+				pfd.events = POLLOUT;
+				pfd.revents = 0;
+				if (poll(&pfd, 1, -1) >= 0 || errno == EINTR) continue;
+			}
+			printf("WIRE: Could not flush data.  Errno: %d\n", errno);
+			return(-4);
+		}
+#else
+		int len = mlWrite(m_writeFD, m_sendBuf + m_sendStart, m_sendEnd - m_sendStart);
+		if (len < 0)
+		{
+			printf("WIRE: Could not flush data.  Errno: %d\n", g_mlErrno);
+			return(-4);
+		}
+#endif /* __linux__ || __APPLE__ */
+		m_sendStart += len;
+    }
+
+    if (m_sendStart == m_sendEnd) m_sendStart = m_sendEnd = 0;
+    return(m_sendEnd - m_sendStart);
+}
+
+int
+AtkWire::setSendBuffering(int onOff)
+{
+    onOff = onOff ? 1 : 0;
+    if (onOff == m_sendBuffering) return(0);
+
+    if (!onOff)
+	{
+		// Nothing may be left behind once sends go straight out again.
+		m_sendBuffering = 0;
+		if (flushSendBuffer(1) < 0) return(-1);
+    }
+
+#if defined(__linux__) || defined(__APPLE__)
+    // A descriptor shared with a non-blocking reader stays non-blocking.
+    if (!onOff && m_writeFD == m_readFD && m_nonBlocking)
+	{
+		return(0);
+    }
+
+    int flags = fcntl(m_writeFD, F_GETFL, 0);
+    if (flags < 0)
+	{
+		printf("WIRE: Could not get FD flags.  Errno: %d\n", errno);
+		return(-1);
+    }
+
+    if (onOff) flags |= O_NONBLOCK;
+    else flags &= ~O_NONBLOCK;
+    if (fcntl(m_writeFD, F_SETFL, flags) < 0)
+	{
+		printf("WIRE: Could not set FD flags.  Errno: %d\n", errno);
+		return(-1);
+    }
+#endif /* __linux__ || __APPLE__ */
+
+    m_sendBuffering = onOff;
+    return(0);
+}
+
+void
+AtkWire::setHighWaterMark(int mark, AtkWireHighWaterCallback callback,
+	void* clientData)
+{
+    m_highWaterMark = mark;
+    m_highWaterCallback = callback;
+    m_highWaterData = clientData;
+}
+
+AtkWireMsg* 
+AtkWire::recvMsg()
+{
+    // Check read FD
+    if (m_readFD < 0)
+	{
+		printf("WIRE: Bad read FD\n");
+		return(NULL);
+    }
+
+    AtkWireMsg* msg;
+    if (m_head)
+	{
+		// If any msgs are on the queue - return those.
+		msg = dequeueMsg();
+    } else if (m_readerThread)
+	{
+		// The reader thread has done the reading.
+		msg = popReaderMsg(!m_nonBlocking);
+    } else if (m_nonBlocking)
+	{
+		// In non-blocking mode take only what has already arrived.
+		pollMsgs();
+		msg = dequeueMsg();
+    } else
+	{
+		// OK, find it from the FD.
+		msg = recvMsgFromFD();
+
+		// Hand any other frames that arrived with it to the queue so that
+		// they show up as pending.
+		if (msg) queueBufferedMsgs();
+    }
+
+    // The reply sent while a sync msg is handled answers it.
+    if (msg) m_replyCorrelationID = msg->isSyncMsg() ? msg->getCorrelationID() : 0;
+
+    return(msg);
+}
+
+AtkWireMsg* 
+AtkWire::recvMsgFromFD()
+{
+    // Even in non-blocking mode the caller wants a message, so wait for it.
+    if (m_readerThread) return(popReaderMsg(1));
+    return(readFrame(1));
+}
+
+AtkWireMsg*
+AtkWire::readFrame(int block, int* status)
+{
+    int unused;
+    if (!status) status = &unused;
+
+    // Frames that decode to no message, such as fragments and framing
+    // switches, are read past.
+    *status = ATK_WIRE_READ_ERROR;
+    for (;;)
+	{
+		if (m_partialMsg)
+		{
+			// Continue a frame too large for the receive buffer.
+			if (block && (m_coalesceHead || m_bulkHead) && waitForInput(-1) < 0) return(NULL);
+			int partial = readPartialMsg();
+			if (partial > 0)
+			{
+				AtkWireMsg* msg = finishMsg(m_partialMsg);
+				m_partialMsg = NULL;
+				m_partialLen = 0;
+				if (msg)
+				{
+					*status = ATK_WIRE_READ_MSG;
+					return(msg);
+				}
+				if (m_lostConnection) return(NULL);
+				continue;
+			} else if (partial < 0)
+			{
+				return(NULL);
+			}
+		} else
+		{
+			// Anything already buffered comes first.
+			AtkWireMsg* msg = decodeMsg();
+			if (msg)
+			{
+				*status = ATK_WIRE_READ_MSG;
+				return(msg);
+			}
+			if (m_lostConnection) return(NULL);
+
+			// A large frame was started; read the rest of it directly.
+			if (m_partialMsg) continue;
+
+			// Otherwise, read whatever is available.  A blocking read would
+			// stall held and bulk messages, so keep sending while waiting.
+			if (block && (m_coalesceHead || m_bulkHead) && waitForInput(-1) < 0) return(NULL);
+			int len = fillRecvBuffer();
+			if (len > 0) continue;
+			if (len == 0)
+			{
+				// The peer closed, possibly in the middle of a frame; what
+				// is buffered can never be completed.
+				m_lostConnection = 1;
+				mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
+				return(NULL);
+			}
+			if (!atkWouldBlock())
+			{
+				printf("WIRE: Could not read header.  Errno: %d\n", g_mlErrno);
+				return(NULL);
+			}
+		}
+
+		// Nothing more has arrived yet.
+		if (!block)
+		{
+			*status = ATK_WIRE_READ_EMPTY;
+			return(NULL);
+		}
+		if (waitForInput(-1) < 0)
+		{
+			printf("WIRE: Could not wait for input.  Errno: %d\n", errno);
+			return(NULL);
+		}
+    }
+}
+
+int
+AtkWire::readPartialMsg()
+{
+    AtkWireMsg* msg = m_partialMsg;
+    int dataLen = msg->getDataLength();
+
+    while (m_partialLen < dataLen)
+	{
+		int len = mlRead(m_readFD, ((char*) msg->m_msgData) + m_partialLen,
+			dataLen - m_partialLen);
+		if (len < 0)
+		{
+			if (atkWouldBlock()) return(0);
+			printf("WIRE: could not read msg data.  Errno: %d\n", g_mlErrno);
+			delete msg;
+			m_partialMsg = NULL;
+			m_partialLen = 0;
+			return(-1);
+		} else if (len == 0)
+		{
+			// The peer closed in the middle of the frame.
+			delete msg;
+			m_partialMsg = NULL;
+			m_partialLen = 0;
+			m_lostConnection = 1;
+			mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
+			return(-1);
+		}
+		m_partialLen += len;
+    }
+
+    return(1);
+}
+
+int
+AtkWire::fillRecvBuffer()
+{
+    compactRecvBuffer();
+
+    int len;
+#if defined(__linux__)
+    if (m_readIsSocket)
+	{
+		// Collect any descriptors sent with out-of-band frames; a plain
+		// read would discard them.
+		struct iovec iov;
+		iov.iov_base = m_recvBuf + m_recvEnd;
+		iov.iov_len = m_recvBufSize - m_recvEnd;
+		union
+		{
+			struct cmsghdr m_align;
+			char m_buf[CMSG_SPACE(sizeof(int) * ATK_WIRE_MAX_PASSED_FDS)];
+		} control;
+		struct msghdr hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.msg_iov = &iov;
+		hdr.msg_iovlen = 1;
+		hdr.msg_control = control.m_buf;
+		hdr.msg_controllen = sizeof(control.m_buf);
+
+		do
+		{
+			len = recvmsg(m_readFD, &hdr, MSG_CMSG_CLOEXEC);
+		} while (len < 0 && errno == EINTR);
+
+		if (len >= 0)
+		{
+			if (hdr.msg_flags & MSG_CTRUNC)
+				printf("WIRE: Too many descriptors received; some were dropped\n");
+			for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg;
+				 cmsg = CMSG_NXTHDR(&hdr, cmsg))
+			{
+				if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+					continue;
+				int numFDs = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				for (int i = 0; i < numFDs; i++)
+				{
+					int fd;
+					memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+					m_passedFDs.add(fd);
+				}
+			}
+		}
+    } else
+#endif /* __linux__ */
+    len = mlRead(m_readFD, m_recvBuf + m_recvEnd, m_recvBufSize - m_recvEnd);
+    if (len > 0) m_recvEnd += len;
+    return(len);
+}
+
+void
+AtkWire::compactRecvBuffer()
+{
+    // Move any partial frame to the front to make room behind it.
+    if (m_recvStart > 0)
+	{
+		if (m_recvEnd > m_recvStart)
+			memmove(m_recvBuf, m_recvBuf + m_recvStart, m_recvEnd - m_recvStart);
+		m_recvEnd -= m_recvStart;
+		m_recvStart = 0;
+    }
+}
+
+AtkWireMsg*
+AtkWire::decodeMsg()
+{
+    AtkWireMsg* msg;
+    while ((msg = decodeFrame()) != NULL)
+	{
+		msg = finishMsg(msg);
+		if (msg || m_lostConnection) return(msg);
+    }
+    return(NULL);
+}
+
+AtkWireMsg*
+AtkWire::finishMsg(AtkWireMsg* msg)
+{
+    // A framing switch applies to the frames behind it, so it is handled
+    // as soon as it is decoded, whichever thread that is on.
+    if (!strcmp(msg->m_msgName, ATK_WIRE_FRAMING_MSG_NAME))
+	{
+		int version = 1;
+		msg->getParam(version);
+		m_recvCompact = (version >= 2) ? 1 : 0;
+		m_recvNames.clear();
+		delete msg;
+
+		MLE_DEBUG_CAT("ATK",
+			printf("WIRE: Receiving %s headers\n", m_recvCompact ? "compact" : "original");
+		);
+		return(NULL);
+    }
+
+    // An out-of-band payload is mapped in place of the control payload,
+    // and may itself be compressed.
+    int status = 0;
+    if (msg->getMsgFlags() & ATK_WIRE_MSG_FLAG_OOB) status = mapOOBData(msg);
+
+    // A bulk message is handled once all of its fragments are in.
+    if (status == 0 && (msg->getMsgFlags() & ATK_WIRE_MSG_FLAG_FRAGMENT))
+	{
+		msg = collectFragment(msg);
+		if (!msg) return(NULL);
+    }
+
+    // The correlation ID trails the payload.
+    if (status == 0 && (msg->getMsgFlags() & ATK_WIRE_MSG_FLAG_CORRELATED))
+	{
+		unsigned int id;
+		int len = msg->getDataLength() - (int) sizeof(id);
+		if (len < 0)
+		{
+			printf("WIRE: Bad correlated msg %s\n", msg->m_msgName);
+			status = -1;
+		} else
+		{
+			memcpy(&id, ((char*) msg->m_msgData) + len, sizeof(id));
+			msg->setCorrelationID(id);
+			msg->truncateMsgData(len);
+			msg->setMsgFlags(msg->getMsgFlags() & ~ATK_WIRE_MSG_FLAG_CORRELATED);
+		}
+    }
+
+    if (status == 0 && (msg->getMsgFlags() & ATK_WIRE_MSG_FLAG_COMPRESSED))
+		status = decompressMsg(msg);
+    if (status < 0)
+	{
+		delete msg;
+		m_lostConnection = 1;
+		mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
+		return(NULL);
+    }
+
+    // Capability announcements are for the wire, not its users. Answering
+    // one writes, so the reader thread leaves it to the receiving thread.
+    if (!m_readerThread && handleOptions(msg)) return(NULL);
+
+    if (m_recorder) m_recorder->record(ATK_WIRE_LOG_RECV, msg);
+    if (isStatsEnabled())
+	{
+		msg->setRecvTime(AtkWireStats::now());
+		m_stats.recordRecv(msg->m_msgName, msg->getDataLength());
+    }
+    return(msg);
+}
+
+AtkWireMsg*
+AtkWire::collectFragment(AtkWireMsg* msg)
+{
+    char* data = (char*) msg->m_msgData;
+    int len = msg->getDataLength();
+
+    if (!m_fragMsg)
+	{
+		// The first fragment is led by the length of the whole payload,
+		// which is allocated up front and so is held to the largest size.
+		int total = -1;
+		if (len >= (int) sizeof(int)) memcpy(&total, data, sizeof(int));
+		if (total < len - (int) sizeof(int) || total > m_maxMsgSize)
+		{
+			printf("WIRE: Bad first fragment of msg %s\n", msg->m_msgName);
+			delete msg;
+			m_lostConnection = 1;
+			mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
+			return(NULL);
+		}
+		data += sizeof(int);
+		len -= sizeof(int);
+
+		m_fragMsg = new AtkWireMsg();
+		atkCopyHeader(m_fragMsg, msg);
+		m_fragMsg->adoptPooledMsgData((total > 0) ? AtkWirePool::alloc(total) : NULL, total);
+		m_fragLen = 0;
+    } else if (strcmp(msg->m_msgName, m_fragMsg->m_msgName) ||
+		len > m_fragMsg->getDataLength() - m_fragLen)
+	{
+		// Fragments of one message are never interleaved with another's.
+		printf("WIRE: Fragment of msg %s does not belong to msg %s\n",
+			msg->m_msgName, m_fragMsg->m_msgName);
+		delete msg;
+		m_lostConnection = 1;
+		mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
+		return(NULL);
+    }
+
+    if (len > 0) memcpy(((char*) m_fragMsg->m_msgData) + m_fragLen, data, len);
+    m_fragLen += len;
+    delete msg;
+    if (m_fragLen < m_fragMsg->getDataLength()) return(NULL);
+
+    AtkWireMsg* whole = m_fragMsg;
+    whole->setMsgFlags(whole->getMsgFlags() & ~ATK_WIRE_MSG_FLAG_FRAGMENT);
+    m_fragMsg = NULL;
+    m_fragLen = 0;
+    return(whole);
+}
+
+int
+AtkWire::handleOptions(AtkWireMsg* msg)
+{
+    if (strcmp(msg->m_msgName, ATK_WIRE_OPTIONS_MSG_NAME)) return(0);
+
+    // The protocol version follows the capabilities, if the other side
+    // is new enough to send it.
+    int caps = 0;
+    int version = 1;
+    msg->getParam(caps);
+    if (msg->getDataLength() - msg->m_curParamOffset >= (int) sizeof(int))
+		msg->getParam(version);
+    m_peerCaps = caps;
+    m_peerVersion = version;
+    delete msg;
+
+    MLE_DEBUG_CAT("ATK",
+		printf("WIRE: Peer version %d, capabilities 0x%x\n", version, caps);
+    );
+
+    // Answer, so that the other side knows what this side can do.
+    if (!m_sentOptions) sendOptions();
+    return(1);
+}
+
+int
+AtkWire::decompressMsg(AtkWireMsg* msg)
+{
+    int packedLen = msg->getDataLength() - (int) sizeof(int);
+    int rawLen;
+    if (packedLen < 0)
+	{
+		printf("WIRE: Bad compressed msg %s\n", msg->m_msgName);
+		return(-1);
+    }
+    memcpy(&rawLen, msg->m_msgData, sizeof(int));
+    if (rawLen < 0 || rawLen > m_maxMsgSize)
+	{
+		printf("WIRE: Bad decompressed length %d of msg %s\n", rawLen, msg->m_msgName);
+		return(-1);
+    }
+
+    char* raw = (char*) AtkWirePool::alloc(rawLen > 0 ? rawLen : 1);
+    int len = AtkWireCompressor::decompress(((char*) msg->m_msgData) + sizeof(int),
+		packedLen, raw, rawLen);
+    if (len != rawLen)
+	{
+		printf("WIRE: Could not decompress msg %s\n", msg->m_msgName);
+		AtkWirePool::release(raw);
+		return(-1);
+    }
+
+    m_compressionStats.m_recvMsgs++;
+    m_compressionStats.m_recvRawBytes += rawLen;
+    m_compressionStats.m_recvWireBytes += packedLen + sizeof(int);
+
+    msg->setMsgFlags(msg->getMsgFlags() & ~ATK_WIRE_MSG_FLAG_COMPRESSED);
+    msg->adoptPooledMsgData(raw, rawLen);
+    return(0);
+}
+
+AtkWireMsg*
+AtkWire::decodeFrame()
+{
+    int avail = m_recvEnd - m_recvStart;
+    AtkWireMsg header;
+    int dataLen;
+    int headerLen = decodeHeader(m_recvBuf + m_recvStart, avail, &header, &dataLen);
+    if (headerLen == 0) return(NULL);
+    if (headerLen < 0)
+	{
+		m_lostConnection = 1;
+		mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
+		return(NULL);
+    }
+
+    int frameLen = headerLen + dataLen;
+    if (frameLen > m_recvBufSize)
+	{
+		// The frame can never fit in the buffer.  Take the header and
+		// whatever part of the payload is buffered, and leave the rest to
+		// be read directly into the message.
+		AtkWireMsg* msg = new AtkWireMsg();
+		atkCopyHeader(msg, &header);
+		m_recvStart += headerLen;
+
+		msg->allocMsgData();
+		int len = m_recvEnd - m_recvStart;
+		if (len > msg->getDataLength()) len = msg->getDataLength();
+		if (len > 0) memcpy(msg->m_msgData, m_recvBuf + m_recvStart, len);
+		m_recvStart += len;
+		if (m_recvStart == m_recvEnd) m_recvStart = m_recvEnd = 0;
+
+		m_partialMsg = msg;
+		m_partialLen = len;
+		return(NULL);
+    }
+    if (avail < frameLen) return(NULL);
+
+    // Copy the frame out of the buffer.
+    AtkWireMsg* msg = new AtkWireMsg();
+    atkCopyHeader(msg, &header);
+    msg->allocMsgData();
+    if (msg->getDataLength() > 0)
+		memcpy(msg->m_msgData, m_recvBuf + m_recvStart + headerLen, msg->getDataLength());
+
+    m_recvStart += frameLen;
+    if (m_recvStart == m_recvEnd) m_recvStart = m_recvEnd = 0;
+
+// printf("WIRE: Recved %s msg from %x object\n", msg->msgName, msg->destObj);
+/*
+printf("     Detail: ");
+for (int h=0; h<msg->getHeaderLength(); h++) printf("%x ", msg->msgName[h]);
+printf("\n");
+*/
+
+    return(msg);
+}
+
+int
+AtkWire::mapOOBData(AtkWireMsg* msg)
+{
+#if defined(__linux__)
+    int64_t dataLen;
+    if (msg->getDataLength() != (int) sizeof(dataLen))
+	{
+		printf("WIRE: Bad out-of-band msg %s\n", msg->m_msgName);
+		return(-1);
+    }
+    memcpy(&dataLen, msg->m_msgData, sizeof(dataLen));
+
+    if (m_passedFDs.getLength() == 0)
+	{
+		printf("WIRE: Out-of-band msg %s arrived without its descriptor\n",
+			msg->m_msgName);
+		return(-1);
+    }
+    int fd = m_passedFDs[0];
+    m_passedFDs.remove(0);
+
+    // A private mapping lets the receiver parse, and even modify, the
+    // payload in place without touching the sender's copy.
+    void* data = NULL;
+    if (dataLen > 0)
+	{
+		data = mmap(NULL, dataLen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			printf("WIRE: Could not map out-of-band msg %s.  Errno: %d\n",
+				msg->m_msgName, errno);
+			close(fd);
+			return(-1);
+		}
+    }
+    close(fd);
+
+    msg->setMsgFlags(msg->getMsgFlags() & ~ATK_WIRE_MSG_FLAG_OOB);
+    msg->setMsgDataMapped(data, (int) dataLen);
+    return(0);
+#else
+    printf("WIRE: Out-of-band msg %s is not supported\n", msg->m_msgName);
+    return(-1);
+#endif /* __linux__ */
+}
+
+int
+AtkWire::queueBufferedMsgs()
+{
+    // A partial frame must complete before anything behind it.
+    if (m_partialMsg) return(0);
+
+    int count = 0;
+    AtkWireMsg* msg;
+    while ((msg = decodeMsg()) != NULL)
+	{
+		queueMsg(msg);
+		count++;
+    }
+    return(count);
+}
+
+void
+AtkWire::queueMsg(AtkWireMsg* msg)
+{
+    msg->m_next = NULL;
+    if (m_tail) m_tail->m_next = msg;
+    m_tail = msg;
+    if (!m_head) m_head = msg;
+    m_numQueued++;
+}
+
+AtkWireMsg*
+AtkWire::dequeueMsg()
+{
+    AtkWireMsg* ret = m_head;
+    if (!ret) return(NULL);
+
+    if (m_head == m_tail)
+	{
+		m_head = m_tail = 0;
+    } else
+	{
+		m_head = m_head->m_next;
+    }
+    ret->m_next = NULL;
+    m_numQueued--;
+    return(ret);
+}
+
+AtkWireMsg* 
+AtkWire::sendSyncMsg(AtkWired* wired, void* destObj, const char* msgName, 
+	void* msgData, int msgDataLen)
+{
+    // Borrow the payload rather than copying it into the message.
+    AtkWireMsg msg(destObj, msgName, 1);
+    msg.setMsgDataRef(msgData, msgDataLen);
+    return sendSyncMsg(wired, &msg);
+}
+
+AtkWireMsg* 
+AtkWire::sendSyncMsg(AtkWired* wired, AtkWireMsg* msg)
+{
+    // Must have a valid connection.
+    if (m_lostConnection)
+	{
+		printf("WIRE: Lost Connection\n");
+		return(NULL);
+    }
+
+    // First send the msg.
+    unsigned int id = issueRequest(msg);
+    if (!id)
+	{
+		// Error.
+		printf("WIRE: send msg from sendSyncMsg failed\n");
+		return(NULL);
+    }
+
+    // Now we have to wait for a reply.
+    return(waitForReply(wired, id));
+}
+
+unsigned int
+AtkWire::sendRequest(void* destObj, const char* msgName, void* msgData, int msgDataLen)
+{
+    // Borrow the payload rather than copying it into the message.
+    AtkWireMsg msg(destObj, msgName, 1);
+    msg.setMsgDataRef(msgData, msgDataLen);
+    return(sendRequest(&msg));
+}
+
+unsigned int
+AtkWire::sendRequest(AtkWireMsg* msg)
+{
+    if (m_lostConnection)
+	{
+		printf("WIRE: Lost Connection\n");
+		return(0);
+    }
+
+    // Offer correlation before the first request that could use it.
+    if (!m_sentOptions) sendOptions();
+
+    return(issueRequest(msg));
+}
+
+unsigned int
+AtkWire::issueRequest(AtkWireMsg* msg)
+{
+    unsigned int id = m_nextCorrelationID++;
+    if (!m_nextCorrelationID) m_nextCorrelationID = 1;
+
+    msg->m_waitForReply = 1;
+    msg->setCorrelationID(id);
+    int status = sendMsg(msg);
+    msg->setCorrelationID(0);
+    if (status < 0) return(0);
+
+    m_pendingIDs.add(id);
+    return(id);
+}
+
+AtkWireMsg*
+AtkWire::waitForReply(AtkWired* wired, unsigned int id)
+{
+    if (beginWaitForReply(wired) < 0) return(NULL);
+
+    for (;;)
+	{
+		AtkWireMsg* reply = takeReply(id);
+		if (reply) return(reply);
+
+		// The reply has either been taken already or never will come.
+		int pending = 0;
+		for (int i = 0; i < m_pendingIDs.getLength() && !pending; i++)
+			pending = (m_pendingIDs[i] == id);
+		if (!pending)
+		{
+			printf("WIRE: No request %u is waiting for a reply\n", id);
+			return(NULL);
+		}
+
+		if (collectReply(wired) < 0) return(NULL);
+    }
+}
+
+int
+AtkWire::waitForReplies(AtkWired* wired, const unsigned int* ids, int numIDs,
+	AtkWireMsg** replies)
+{
+    int count = 0;
+    for (int i = 0; i < numIDs; i++)
+	{
+		replies[i] = waitForReply(wired, ids[i]);
+		if (replies[i]) count++;
+    }
+    return(count);
+}
+
+AtkWireMsg*
+AtkWire::waitForAnyReply(AtkWired* wired, unsigned int* id)
+{
+    if (beginWaitForReply(wired) < 0) return(NULL);
+
+    for (;;)
+	{
+		AtkWireMsg* reply = takeReply(0);
+		if (reply)
+		{
+			if (id) *id = reply->getCorrelationID();
+			return(reply);
+		}
+		if (m_pendingIDs.getLength() == 0) return(NULL);
+
+		if (collectReply(wired) < 0) return(NULL);
+    }
+}
+
+int
+AtkWire::beginWaitForReply(AtkWired* wired)
+{
+    // Must have a valid connection.
+    if (m_lostConnection)
+	{
+		printf("WIRE: Lost Connection\n");
+		return(-1);
+    }
+
+    // The reply can't come until the other side has the request.
+    if (m_sendEnd > m_sendStart && flushSendBuffer(1) < 0)
+	{
+		printf("WIRE: flush while waiting for a reply failed\n");
+		return(-1);
+    }
+
+    // Replies that were decoded onto the queue are stored, and sync msgs
+    // ahead of our reply must be answered now, otherwise the other side
+    // may deadlock waiting on them.  The sync msgs are all taken off the
+    // queue first, since answering one runs a handler that may wait for a
+    // reply of its own and so come back here.
+    AtkWireMsg* taken = NULL;
+    AtkWireMsg* takenTail = NULL;
+    AtkWireMsg* prev = NULL;
+    for (AtkWireMsg* queued = m_head; queued; )
+	{
+		AtkWireMsg* next = queued->m_next;
+		if (queued->isReplyMsg() || queued->isSyncMsg())
+		{
+			if (prev) prev->m_next = next;
+			else m_head = next;
+			if (m_tail == queued) m_tail = prev;
+			m_numQueued--;
+
+			queued->m_next = NULL;
+			if (queued->isReplyMsg())
+			{
+				storeReply(queued);
+			} else
+			{
+				if (takenTail) takenTail->m_next = queued;
+				else taken = queued;
+				takenTail = queued;
+			}
+		} else
+		{
+			prev = queued;
+		}
+		queued = next;
+    }
+
+    while (taken)
+	{
+		AtkWireMsg* msg = taken;
+		taken = msg->m_next;
+		msg->m_next = NULL;
+		deliverSyncMsg(wired, msg);
+    }
+    return(0);
+}
+
+int
+AtkWire::collectReply(AtkWired* wired)
+{
+    AtkWireMsg* msg = recvMsgFromFD();
+
+    // If no message  - we have lost connection.
+    if (!msg) return(-1);
+
+    if (msg->isReplyMsg())
+	{
+		storeReply(msg);
+    } else if (msg->isSyncMsg())
+	{
+		// If a sync msg - respond to it - otherwise we might have deadlock
+		// situations.
+		deliverSyncMsg(wired, msg);
+    } else
+	{
+		// Otherwise, place msg on queue.
+		queueMsg(msg);
+    }
+    return(0);
+}
+
+void
+AtkWire::deliverSyncMsg(AtkWired* wired, AtkWireMsg* msg)
+{
+    unsigned int handle = msg->getDestHandle();
+    AtkWired* w = handle ? AtkWired::lookup(handle) : NULL;
+
+    MLE_DEBUG_CAT("ATK",
+		printf("WIRED (inside sendSyncMsg): delivering %s msg to %x obj\n",
+			msg->m_msgName ? msg->m_msgName : "UNKNOWN", handle);
+    );
+
+    // Our own request may still be waiting for the reply it is answering.
+    unsigned int replyID = m_replyCorrelationID;
+    m_replyCorrelationID = msg->getCorrelationID();
+
+    // Its reply isn't part of a batch being answered.
+    AtkWireBatch* replyBatch = setReplyBatch(NULL);
+    m_syncDeliveryDepth++;
+
+    // If no id - deliver msg to itself.
+    if (handle && !w)
+	{
+		// The sender still waits, so it gets an empty reply.
+		printf("WIRE: Dropping %s msg for stale object %x\n", msg->m_msgName, handle);
+		sendMsg(NULL, REPLY_MSG_NAME, (void*) NULL, 0);
+    } else if (!w)
+	{
+		wired->deliverMsg(msg);
+    } else
+	{
+		// Otherwise deliver to obj.
+		w->deliverMsg(msg);
+    }
+
+    m_syncDeliveryDepth--;
+    setReplyBatch(replyBatch);
+    m_replyCorrelationID = replyID;
+}
+
+void
+AtkWire::storeReply(AtkWireMsg* reply)
+{
+    // An untagged reply answers the oldest request.
+    unsigned int id = reply->getCorrelationID();
+    int index = -1;
+    for (int i = 0; i < m_pendingIDs.getLength() && index < 0; i++)
+		if (!id || m_pendingIDs[i] == id) index = i;
+    if (index < 0)
+	{
+		printf("WIRE: Discarding reply %u that no request is waiting for\n", id);
+		delete reply;
+		return;
+    }
+    reply->setCorrelationID(m_pendingIDs[index]);
+    m_pendingIDs.remove(index);
+
+    reply->m_next = NULL;
+    if (m_replyTail) m_replyTail->m_next = reply;
+    else m_replyHead = reply;
+    m_replyTail = reply;
+}
+
+AtkWireMsg*
+AtkWire::takeReply(unsigned int id)
+{
+    AtkWireMsg* prev = NULL;
+    for (AtkWireMsg* reply = m_replyHead; reply; prev = reply, reply = reply->m_next)
+	{
+		if (id && reply->getCorrelationID() != id) continue;
+
+		if (prev) prev->m_next = reply->m_next;
+		else m_replyHead = reply->m_next;
+		if (m_replyTail == reply) m_replyTail = prev;
+		reply->m_next = NULL;
+		return(reply);
+    }
+    return(NULL);
+}
+
+int
+AtkWire::getNumMsgs()
+{
+    // So are those the reader thread has queued.
+    if (m_readerThread) return(m_numQueued + m_readerQueue->getCount());
+
+    // Frames already sitting in the receive buffer are pending too.
+    queueBufferedMsgs();
+    return(m_numQueued);
+}
+
+int
+AtkWire::setNonBlocking(int onOff)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    // The reader thread owns the descriptor; only receiving changes.
+    if (m_readerThread)
+	{
+		m_nonBlocking = onOff ? 1 : 0;
+		return(0);
+    }
+
+    // A descriptor shared with a buffered writer stays non-blocking;
+    // blocking reads then wait for input instead.
+    if (!onOff && m_writeFD == m_readFD && m_sendBuffering)
+	{
+		m_nonBlocking = 0;
+		return(0);
+    }
+
+    int flags = fcntl(m_readFD, F_GETFL, 0);
+    if (flags < 0)
+	{
+		printf("WIRE: Could not get FD flags.  Errno: %d\n", errno);
+		return(-1);
+    }
+
+    if (onOff) flags |= O_NONBLOCK;
+    else flags &= ~O_NONBLOCK;
+    if (fcntl(m_readFD, F_SETFL, flags) < 0)
+	{
+		printf("WIRE: Could not set FD flags.  Errno: %d\n", errno);
+		return(-1);
+    }
+
+    m_nonBlocking = onOff ? 1 : 0;
+    return(0);
+#else
+    // Not supported; the wire stays blocking.
+    return(-1);
+#endif /* __linux__ || __APPLE__ */
+}
+
+int
+AtkWire::pollMsgs()
+{
+    // Let held and bulk messages move along, if there is room.
+    if (m_coalesceHead && drainCoalesced(0) < 0) return(-1);
+    if (m_bulkHead && pumpBulk(0) < 0) return(-1);
+
+    int count = 0;
+    AtkWireMsg* msg;
+    while ((msg = (m_readerThread ? popReaderMsg(0) : readFrame(0))) != NULL)
+	{
+		queueMsg(msg);
+		count++;
+    }
+
+    if (m_lostConnection) return(-1);
+    return(count);
+}
+
+int
+AtkWire::waitForInput(int timeout)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    // With a reader thread, input is what it has queued.
+    if (m_readerThread && m_readerQueue->getCount() > 0) return(1);
+
+    return(waitForFD(getFD(), timeout));
+#else
+    // Reads block until data arrives.
+    return(1);
+#endif /* __linux__ || __APPLE__ */
+}
+
+int
+AtkWire::waitForFD(int fd, int timeout)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    // While messages are held or bulk fragments queued, wait for room to
+    // write them too.
+    struct pollfd pfd[2];
+    pfd[0].fd = fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = m_writeFD;
+    pfd[1].events = POLLOUT;
+
+    std::chrono::steady_clock::time_point deadline =
+		std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    for (;;)
+	{
+		int wait = timeout;
+		if (timeout > 0)
+		{
+			wait = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+				deadline - std::chrono::steady_clock::now()).count();
+			if (wait < 0) wait = 0;
+		}
+
+		pfd[0].revents = pfd[1].revents = 0;
+		int ret = poll(pfd, (m_coalesceHead || m_bulkHead) ? 2 : 1, wait);
+		if (ret < 0)
+		{
+			if (errno == EINTR) continue;
+			return(-1);
+		}
+		if (ret == 0) return(0);
+		if (pfd[0].revents) return(1);
+		if (flush(0) < 0) return(-1);
+    }
+#else
+    return(1);
+#endif /* __linux__ || __APPLE__ */
+}
+
+int
+AtkWire::startReaderThread(int queueSize)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    if (m_readerThread) return(0);
+    if (m_lostConnection)
+	{
+		printf("WIRE: Lost Connection\n");
+		return(-1);
+    }
+
+    if (pipe(m_readerNotifyFD) < 0)
+	{
+		printf("WIRE: Could not create reader pipe.  Errno: %d\n", errno);
+		return(-1);
+    }
+    if (pipe(m_readerWakeFD) < 0)
+	{
+		printf("WIRE: Could not create reader pipe.  Errno: %d\n", errno);
+		close(m_readerNotifyFD[0]);
+		close(m_readerNotifyFD[1]);
+		m_readerNotifyFD[0] = m_readerNotifyFD[1] = -1;
+		return(-1);
+    }
+    for (int i = 0; i < 2; i++)
+	{
+		fcntl(m_readerNotifyFD[i], F_SETFL, fcntl(m_readerNotifyFD[i], F_GETFL, 0) | O_NONBLOCK);
+		fcntl(m_readerWakeFD[i], F_SETFL, fcntl(m_readerWakeFD[i], F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    // The thread never blocks in a read, so that it can always be stopped.
+    m_readerSavedFlags = fcntl(m_readFD, F_GETFL, 0);
+    if (m_readerSavedFlags >= 0)
+		fcntl(m_readFD, F_SETFL, m_readerSavedFlags | O_NONBLOCK);
+
+    m_readerQueue = new AtkWireMsgQueue(queueSize);
+    m_readerStop.store(0);
+    m_readerDone.store(0);
+    m_readerNotified.store(0);
+    m_readerThread = new std::thread(&AtkWire::readerLoop, this);
+    return(0);
+#else
+    // Not supported; frames are read by the receiving thread.
+    return(-1);
+#endif /* __linux__ || __APPLE__ */
+}
+
+int
+AtkWire::stopReaderThread()
+{
+#if defined(__linux__) || defined(__APPLE__)
+    if (!m_readerThread) return(0);
+
+    m_readerStop.store(1);
+    char wake = 0;
+    if (write(m_readerWakeFD[1], &wake, 1) < 0 && errno != EAGAIN)
+		printf("WIRE: Could not wake reader.  Errno: %d\n", errno);
+    m_readerThread->join();
+    delete m_readerThread;
+    m_readerThread = NULL;
+
+    // What the thread decoded can still be received.
+    AtkWireMsg* msg;
+    while ((msg = m_readerQueue->pop()) != NULL)
+	{
+		if (!handleOptions(msg)) queueMsg(msg);
+    }
+    delete m_readerQueue;
+    m_readerQueue = NULL;
+
+    for (int i = 0; i < 2; i++)
+	{
+		close(m_readerNotifyFD[i]);
+		close(m_readerWakeFD[i]);
+		m_readerNotifyFD[i] = m_readerWakeFD[i] = -1;
+    }
+    if (m_readerSavedFlags >= 0 && !m_lostConnection)
+		fcntl(m_readFD, F_SETFL, m_readerSavedFlags);
+    return(0);
+#else
+    return(-1);
+#endif /* __linux__ || __APPLE__ */
+}
+
+void
+AtkWire::readerLoop()
+{
+#if defined(__linux__) || defined(__APPLE__)
+    while (!m_readerStop.load())
+	{
+		int status;
+		AtkWireMsg* msg = readFrame(0, &status);
+		if (msg)
+		{
+			// Wait for room rather than drop anything.
+			while (m_readerQueue->push(msg) < 0)
+			{
+				notifyReceiver(0);
+				if (m_readerStop.load())
+				{
+					delete msg;
+					break;
+				}
+				struct pollfd pfd;
+				pfd.fd = m_readerWakeFD[0];
+				pfd.events = POLLIN;
+				poll(&pfd, 1, 1);
+			}
+			notifyReceiver(0);
+			continue;
+		}
+
+		// Anything but running out of input ends the connection.
+		if (status != ATK_WIRE_READ_EMPTY || m_lostConnection)
+		{
+			m_lostConnection = 1;
+			break;
+		}
+
+		struct pollfd pfd[2];
+		pfd[0].fd = m_readFD;
+		pfd[0].events = POLLIN;
+		pfd[0].revents = 0;
+		pfd[1].fd = m_readerWakeFD[0];
+		pfd[1].events = POLLIN;
+		pfd[1].revents = 0;
+		if (poll(pfd, 2, -1) < 0 && errno != EINTR)
+		{
+			printf("WIRE: Could not wait for input.  Errno: %d\n", errno);
+			m_lostConnection = 1;
+			break;
+		}
+    }
+
+    // The receiving thread sees the connection lost once the queue drains.
+    m_readerDone.store(1);
+    notifyReceiver(1);
+#endif /* __linux__ || __APPLE__ */
+}
+
+void
+AtkWire::notifyReceiver(int force)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    // One byte is enough to make the descriptor readable.
+    if (m_readerNotified.exchange(1) && !force) return;
+
+    char notify = 0;
+    if (write(m_readerNotifyFD[1], &notify, 1) < 0 && errno != EAGAIN)
+		printf("WIRE: Could not notify receiver.  Errno: %d\n", errno);
+#endif /* __linux__ || __APPLE__ */
+}
+
+AtkWireMsg*
+AtkWire::popReaderMsg(int block)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    for (;;)
+	{
+		AtkWireMsg* msg = m_readerQueue->pop();
+		if (!msg)
+		{
+			// Clear the signal, then look again, so that nothing queued
+			// in between goes unnoticed.
+			char drain[64];
+			while (read(m_readerNotifyFD[0], drain, sizeof(drain)) > 0) ;
+			m_readerNotified.store(0);
+
+			int done = m_readerDone.load();
+			msg = m_readerQueue->pop();
+			if (!msg && done)
+			{
+				// Like a descriptor at end of file, the notify descriptor
+				// stays readable, so the loss is seen by whoever polls next.
+				notifyReceiver(1);
+				m_lostConnection = 1;
+				mlSetErrno(MLE_E_ATKLIB_CONNECTION_LOST);
+				return(NULL);
+			}
+		}
+
+		if (msg)
+		{
+			if (handleOptions(msg)) continue;
+			return(msg);
+		}
+
+		if (!block) return(NULL);
+
+		if (waitForFD(m_readerNotifyFD[0], -1) < 0)
+		{
+			printf("WIRE: Could not wait for reader.  Errno: %d\n", errno);
+			return(NULL);
+		}
+    }
+#else
+    return(NULL);
+#endif /* __linux__ || __APPLE__ */
+}
+
+
 void *
 AtkWire::operator new(size_t tSize)
 {
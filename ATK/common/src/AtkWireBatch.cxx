@@ -0,0 +1,165 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireBatch.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that packs many
+ * messages into the payload of one.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <string.h>
+#include <stdio.h>
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWireBatch.h"
+#include "mle/AtkWireMsg.h"
+#include "mle/AtkMsgSchema.h"
+
+// What leads each member: whether it waits for a reply, its name and
+// the length of its payload.
+ATK_MSG_SCHEMA(AtkWireBatchMember, ATK_WIRE_BATCH_MSG_NAME, int, const char*, int);
+
+
+AtkWireBatch::AtkWireBatch(void* destObj, const char* msgName)
+{
+    m_msg = new AtkWireMsg(destObj, msgName);
+    m_numMsgs = 0;
+    m_numSyncMsgs = 0;
+}
+
+AtkWireBatch::~AtkWireBatch()
+{
+    delete m_msg;
+}
+
+void
+AtkWireBatch::add(AtkWireMsg* msg)
+{
+    AtkWireBuffer buffer;
+    buffer.m_data = msg->m_msgData;
+    buffer.m_length = msg->getDataLength();
+    addBuffers(msg->m_msgName, &buffer, (buffer.m_data && buffer.m_length > 0) ? 1 : 0,
+		msg->isSyncMsg());
+}
+
+void
+AtkWireBatch::add(const char* msgName, const void* msgData, int msgDataLen,
+	int waitForReply)
+{
+    AtkWireBuffer buffer;
+    buffer.m_data = msgData;
+    buffer.m_length = msgDataLen;
+    addBuffers(msgName, &buffer, (msgData && msgDataLen > 0) ? 1 : 0, waitForReply);
+}
+
+void
+AtkWireBatch::addBuffers(const char* msgName, const AtkWireBuffer* buffers, int numBuffers,
+	int waitForReply)
+{
+    int dataLen = 0;
+    for (int i = 0; i < numBuffers; i++)
+		if (buffers[i].m_data && buffers[i].m_length > 0) dataLen += buffers[i].m_length;
+
+    // Size the member once, then copy the payload in behind its head.
+    int headLen = AtkWireBatchMember::getSize(waitForReply, msgName, dataLen);
+    m_msg->reserveMsgData(m_msg->getDataLength() + headLen + dataLen);
+    AtkWireBatchMember::pack(m_msg, waitForReply ? 1 : 0, msgName, dataLen);
+    char* p = (char*) m_msg->extendMsgData(dataLen);
+    for (int i = 0; i < numBuffers; i++)
+	{
+		if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+		memcpy(p, buffers[i].m_data, buffers[i].m_length);
+		p += buffers[i].m_length;
+    }
+
+    m_numMsgs++;
+    if (waitForReply)
+	{
+		m_numSyncMsgs++;
+		m_msg->m_waitForReply = 1;
+    }
+}
+
+void
+AtkWireBatch::clear()
+{
+    m_msg->clearMsgData();
+    m_msg->m_waitForReply = 0;
+    m_msg->setCorrelationID(0);
+    m_numMsgs = 0;
+    m_numSyncMsgs = 0;
+}
+
+int
+AtkWireBatch::getNext(AtkWireMsg* batch, AtkWireMsg* msg)
+{
+    if (batch->m_curParamOffset >= batch->getDataLength()) return(0);
+
+    int waitForReply, dataLen;
+    const char* msgName;
+    if (AtkWireBatchMember::unpack(batch, waitForReply, msgName, dataLen) < 0) return(-1);
+    if (dataLen < 0 || dataLen > batch->getDataLength() - batch->m_curParamOffset ||
+		strlen(msgName) >= MAX_MSG_NAME_LEN)
+	{
+		printf("WM: batch member %s error curParamOffset: %d  len: %d  dataLength: %d\n",
+			msgName, batch->m_curParamOffset, dataLen, batch->getDataLength());
+		return(-1);
+    }
+
+    msg->reset(batch->m_destObj, msgName, waitForReply);
+    msg->setMsgDataRef(((char*) batch->m_msgData) + batch->m_curParamOffset, dataLen);
+    msg->setRecvTime(batch->getRecvTime());
+    batch->m_curParamOffset += dataLen;
+    return(1);
+}
+
+void *
+AtkWireBatch::operator new(size_t tSize)
+{
+	void *p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkWireBatch::operator delete(void *p)
+{
+	mlFree(p);
+}
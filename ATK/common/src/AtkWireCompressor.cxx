@@ -0,0 +1,210 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireCompressor.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that provides a fast
+ * block compressor for message payloads.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <string.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWireCompressor.h"
+
+// The size of the match hash table, as a power of two.
+#define ATK_COMPRESS_HASH_LOG 13
+#define ATK_COMPRESS_HASH_SIZE (1 << ATK_COMPRESS_HASH_LOG)
+
+// The longest literal run, back reference and reference distance.
+#define ATK_COMPRESS_MAX_LITERAL 32
+#define ATK_COMPRESS_MAX_MATCH   264
+#define ATK_COMPRESS_MAX_OFFSET  8192
+
+static inline unsigned int atkCompressHash(const unsigned char* p)
+{
+    unsigned int v = (p[0] << 16) | (p[1] << 8) | p[2];
+    return((v * 2654435761U) >> (32 - ATK_COMPRESS_HASH_LOG));
+}
+
+
+int
+AtkWireCompressor::getMaxCompressedLength(int length)
+{
+    // Incompressible data costs one control byte per literal run; the
+    // slack lets the compressor check for room a whole token at a time.
+    return(length + (length / ATK_COMPRESS_MAX_LITERAL) + 16);
+}
+
+int
+AtkWireCompressor::compress(const void* in, int inLength, void* out, int outLength)
+{
+    const unsigned char* base = (const unsigned char*) in;
+    const unsigned char* ip = base;
+    const unsigned char* inEnd = base + inLength;
+    unsigned char* op = (unsigned char*) out;
+    unsigned char* outEnd = op + outLength;
+
+    // The last position at which each hash was seen, plus one.
+    int table[ATK_COMPRESS_HASH_SIZE];
+    memset(table, 0, sizeof(table));
+
+    if (inLength <= 0 || outLength <= 0) return(0);
+
+    // Each literal run is preceded by a control byte, filled in when the
+    // run ends.
+    int literals = 0;
+    op++;
+
+    while (ip + 2 < inEnd)
+	{
+		unsigned int hash = atkCompressHash(ip);
+		int pos = (int) (ip - base);
+		int ref = table[hash] - 1;
+		table[hash] = pos + 1;
+
+		int offset = pos - ref - 1;
+		if (ref >= 0 && offset < ATK_COMPRESS_MAX_OFFSET &&
+			base[ref] == ip[0] && base[ref + 1] == ip[1] && base[ref + 2] == ip[2])
+		{
+			int maxLen = (int) (inEnd - ip);
+			if (maxLen > ATK_COMPRESS_MAX_MATCH) maxLen = ATK_COMPRESS_MAX_MATCH;
+			int len = 3;
+			while (len < maxLen && base[ref + len] == ip[len]) len++;
+
+			// Close the literal run, or take back its unused control byte.
+			if (op + 3 + 1 > outEnd) return(0);
+			if (literals) op[-literals - 1] = (unsigned char) (literals - 1);
+			else op--;
+
+			int code = len - 2;
+			if (code < 7)
+			{
+				*op++ = (unsigned char) ((code << 5) | (offset >> 8));
+			} else
+			{
+				*op++ = (unsigned char) ((7 << 5) | (offset >> 8));
+				*op++ = (unsigned char) (code - 7);
+			}
+			*op++ = (unsigned char) offset;
+
+			// Start the next literal run.
+			literals = 0;
+			op++;
+
+			// Remember where the match ends, so runs of repeats keep matching.
+			ip += len;
+			if (ip + 2 < inEnd)
+				table[atkCompressHash(ip - 1)] = (int) (ip - 1 - base) + 1;
+			continue;
+		}
+
+		if (op >= outEnd) return(0);
+		*op++ = *ip++;
+		if (++literals == ATK_COMPRESS_MAX_LITERAL)
+		{
+			op[-literals - 1] = (unsigned char) (literals - 1);
+			literals = 0;
+			if (op >= outEnd) return(0);
+			op++;
+		}
+    }
+
+    // The last bytes are too few to start a match.
+    while (ip < inEnd)
+	{
+		if (op >= outEnd) return(0);
+		*op++ = *ip++;
+		if (++literals == ATK_COMPRESS_MAX_LITERAL)
+		{
+			op[-literals - 1] = (unsigned char) (literals - 1);
+			literals = 0;
+			if (op >= outEnd) return(0);
+			op++;
+		}
+    }
+
+    if (literals) op[-literals - 1] = (unsigned char) (literals - 1);
+    else op--;
+
+    return((int) (op - (unsigned char*) out));
+}
+
+int
+AtkWireCompressor::decompress(const void* in, int inLength, void* out, int outLength)
+{
+    const unsigned char* ip = (const unsigned char*) in;
+    const unsigned char* inEnd = ip + inLength;
+    unsigned char* op = (unsigned char*) out;
+    unsigned char* outEnd = op + outLength;
+
+    while (ip < inEnd)
+	{
+		unsigned int ctrl = *ip++;
+
+		if (ctrl < ATK_COMPRESS_MAX_LITERAL)
+		{
+			// A literal run.
+			int len = ctrl + 1;
+			if (ip + len > inEnd || op + len > outEnd) return(-1);
+			memcpy(op, ip, len);
+			ip += len;
+			op += len;
+		} else
+		{
+			// A back reference; it may overlap the bytes it produces.
+			int len = ctrl >> 5;
+			if (len == 7)
+			{
+				if (ip >= inEnd) return(-1);
+				len += *ip++;
+			}
+			len += 2;
+
+			if (ip >= inEnd) return(-1);
+			int offset = (int) ((ctrl & 0x1f) << 8) + *ip++ + 1;
+			unsigned char* ref = op - offset;
+			if (ref < (unsigned char*) out || op + len > outEnd) return(-1);
+
+			for (int i = 0; i < len; i++) op[i] = ref[i];
+			op += len;
+		}
+    }
+
+    return((int) (op - (unsigned char*) out));
+}
@@ -44,24 +44,31 @@
 #if defined(_WINDOWS)
 #include <windows.h>
 #endif
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 //#include <mle/types.h>
 #include <mle/MleDsoLoader.h>
 #include <mle/mlDebug.h>
 
 #if defined(__linux__) || defined(__APPLE__)
+#include <dirent.h>
 #include <dlfcn.h>
-#include <sys/time.h>
 #endif
 
 #include "mle/AtkWireFunc.h"
+#include "mle/AtkWireStats.h"
 
 #include "mle/AtkWired.h"
 #include "mle/AtkWire.h"
 
-AtkCreateWireFuncArray AtkWireFunc::g_wireFuncs;
-AtkCreateWireFuncArray AtkWireFunc::g_recvWireFuncs;
+AtkWireFuncTable AtkWireFunc::g_wireFuncs;
+AtkWireFuncTable AtkWireFunc::g_recvWireFuncs;
 
 #if defined(__linux__) || defined(__APPLE__)
 #define WIRE_FUNC_DSO_PATH "/opt/MagicLantern/plug-ins/wirefuncs"
@@ -70,6 +77,61 @@ AtkCreateWireFuncArray AtkWireFunc::g_recvWireFuncs;
 #define PATH_MAX 1024
 #endif
 
+// The number of slots a table starts with.
+#define ATK_WIRE_FUNC_TABLE_INITIAL_SIZE 64
+
+#if defined(_WINDOWS)
+#define ATK_WIRE_FUNC_DSO_SUFFIX "WireFunc.dll"
+#define ATK_WIRE_FUNC_PATH_SEPARATOR "\\"
+#define atkStrdup _strdup
+#else
+#define ATK_WIRE_FUNC_DSO_SUFFIX "WireFunc.so"
+#define ATK_WIRE_FUNC_PATH_SEPARATOR "/"
+#define atkStrdup strdup
+#endif
+
+// A wire func DSO named by the index.
+struct AtkWireFuncDso
+{
+    char* name;
+    char* path;
+    int loaded;
+};
+
+// Guards the tables, which the preload thread registers into while the
+// main thread looks up.  Nothing is loaded while it is held.
+static std::mutex g_wireFuncLock;
+
+// The wire func DSOs, keyed by message name.
+static AtkWireFuncTable g_dsoIndex;
+
+// Changed by every registration and preload; see getGeneration().
+static std::atomic<unsigned int> g_generation(0);
+
+static std::thread* g_preloadThread = NULL;
+static long long g_preloadStart = 0;
+
+// Whether to print load times; -1 until MLE_ATK_WIREFUNC_TIMING is read.
+static int g_loadTiming = -1;
+
+static int
+atkGetLoadTiming()
+{
+    if (g_loadTiming < 0)
+	{
+		const char* timing = getenv("MLE_ATK_WIREFUNC_TIMING");
+		g_loadTiming = (timing && *timing) ? atoi(timing) : 0;
+    }
+    return(g_loadTiming);
+}
+
+// The milliseconds since a time from AtkWireStats::now().
+static double
+atkMillisSince(long long start)
+{
+    return((AtkWireStats::now() - start) / 1000000.0);
+}
+
 
 
 AtkWireFunc::AtkWireFunc()
@@ -83,106 +145,442 @@ AtkWireFunc::~AtkWireFunc()
 {
 }
 
+AtkWireFuncTable::~AtkWireFuncTable()
+{
+    if (m_slots) mlFree(m_slots);
+}
+
+int
+AtkWireFuncTable::findSlot(const char* name, unsigned int hash)
+{
+    // Linear probing; the table is never more than half full.
+    int slot = hash & m_slotMask;
+    while (m_slots[slot].m_value &&
+		(m_slots[slot].m_hash != hash || strcmp(m_slots[slot].m_name, name)))
+		slot = (slot + 1) & m_slotMask;
+    return(slot);
+}
+
+void
+AtkWireFuncTable::grow()
+{
+    Slot* oldSlots = m_slots;
+    int oldSize = m_slotMask + 1;
+
+    int size = oldSlots ? 2 * oldSize : ATK_WIRE_FUNC_TABLE_INITIAL_SIZE;
+    m_slots = (Slot*) mlMalloc(size * sizeof(Slot));
+    memset(m_slots, 0, size * sizeof(Slot));
+    m_slotMask = size - 1;
+
+    for (int i = 0; i < oldSize && oldSlots; i++)
+		if (oldSlots[i].m_value)
+			m_slots[findSlot(oldSlots[i].m_name, oldSlots[i].m_hash)] = oldSlots[i];
+    if (oldSlots) mlFree(oldSlots);
+}
+
+void
+AtkWireFuncTable::clear()
+{
+    if (m_slots) memset(m_slots, 0, (m_slotMask + 1) * sizeof(Slot));
+    m_count = 0;
+}
+
+void*
+AtkWireFuncTable::find(const char* name, unsigned int hash)
+{
+    if (!m_slots) return(NULL);
+    return(m_slots[findSlot(name, hash)].m_value);
+}
+
+void*
+AtkWireFuncTable::set(const char* name, unsigned int hash, void* value)
+{
+    if (!m_slots || 2 * (m_count + 1) > m_slotMask + 1) grow();
+
+    Slot* slot = &m_slots[findSlot(name, hash)];
+    void* old = slot->m_value;
+    if (!old) m_count++;
+    slot->m_hash = hash;
+    slot->m_name = name;
+    slot->m_value = value;
+    return(old);
+}
+
 AtkWireFunc*
 AtkWireFunc::find(const char* msgName, int recv)
 {
-    // First search through array.
-    AtkWireFunc* wireFunc = findInArray(msgName, recv);
-    if (wireFunc) return(wireFunc);
+    // Every lookup shares the one instance.
+    AtkCreateWireFunc* cwf = findEntry(msgName, recv);
+    if (!cwf) return(NULL);
+    std::lock_guard<std::mutex> guard(g_wireFuncLock);
+    if (!cwf->instance) cwf->instance = (*cwf->createFunc)();
+    return(cwf->instance);
+}
 
-    // Get Class name ...
-    char className[500];
-    sprintf(className, "Mle%sWireFunc", msgName);
+AtkWireFunc*
+AtkWireFunc::create(const char* msgName, int recv)
+{
+    AtkCreateWireFunc* cwf = findEntry(msgName, recv);
+    if (!cwf) return(NULL);
+    AtkCreateFunc createFunc;
+    {
+		std::lock_guard<std::mutex> guard(g_wireFuncLock);
+		createFunc = cwf->createFunc;
+    }
+    return((*createFunc)());
+}
+
+AtkCreateWireFunc*
+AtkWireFunc::findEntry(const char* msgName, int recv)
+{
+    AtkWireFuncTable& table = recv ? g_recvWireFuncs : g_wireFuncs;
+    unsigned int hash = atkHashString(msgName);
 
-    // and path
+    // First search through the table, and find which DSO to load if the
+    // wire func isn't there.
     char path[PATH_MAX];
+    {
+		std::lock_guard<std::mutex> guard(g_wireFuncLock);
+		AtkCreateWireFunc* cwf = (AtkCreateWireFunc*) table.find(msgName, hash);
+		if (cwf) return(cwf);
+
+		AtkWireFuncDso* dso = (AtkWireFuncDso*) g_dsoIndex.find(msgName, hash);
+		if (dso)
+		{
+			strncpy(path, dso->path, PATH_MAX - 1);
+			path[PATH_MAX - 1] = 0;
+			dso->loaded = 1;
+		} else
+			snprintf(path, PATH_MAX, "%s%sMle%s%s", getDsoPath(),
+				ATK_WIRE_FUNC_PATH_SEPARATOR, msgName, ATK_WIRE_FUNC_DSO_SUFFIX);
+    }
+
+    if (loadDso(msgName, path) < 0) return(NULL);
+
+    MLE_DEBUG_CAT("ATK",
+		printf("WIREFUNC: Loaded wirefunc class from DSO: %s  for %s array\n", path, recv ? "RECV": "NORMAL");
+    );
+
+    // search through the table again
+    {
+		std::lock_guard<std::mutex> guard(g_wireFuncLock);
+		AtkCreateWireFunc* cwf = (AtkCreateWireFunc*) table.find(msgName, hash);
+		if (cwf) return(cwf);
+    }
+
+    // error
+    printf("WIREFUNC ERROR: could not find wirefunc class (but loaded dso): Mle%sWireFunc\n", msgName);
+    return(NULL);
+}
+
+int
+AtkWireFunc::loadDso(const char* msgName, const char* path)
+{
+    // Get Class name.
+    char className[500];
+    snprintf(className, sizeof(className), "Mle%sWireFunc", msgName);
+
+    long long startTime = AtkWireStats::now();
+    void (*initClass)(void) = NULL;// initClass function pointer
+
 #if defined(_WINDOWS)
-	sprintf(path, "%s\\%s.dll", WIRE_FUNC_DSO_PATH, className);
+    HMODULE handle = LoadLibraryA(path);
+    double openTime = atkMillisSince(startTime);
+    if (handle) initClass = (void (*)(void)) GetProcAddress(handle, "initClass");
 #else
-    sprintf(path, "%s/%s.so", WIRE_FUNC_DSO_PATH, className);
+    // Loading the DSO registers the classes it defines.
+    void* handle = dlopen(path, RTLD_NOW | RTLD_GLOBAL);
+    double openTime = atkMillisSince(startTime);
+
+    // Classes that aren't registered as they are constructed are
+    // registered by initClass(), looked up by its mangled name in the DSO
+    // or, failing that, anywhere in the process.  The old cfront mangling
+    // is still tried for classes built that way.
+    char dso_func[1024];
+    snprintf(dso_func, sizeof(dso_func), "_ZN%d%s9initClassEv",
+		(int) strlen(className), className);
+    if (handle) initClass = (void (*)(void)) dlsym(handle, dso_func);
+    if (!initClass) initClass = (void (*)(void)) dlsym(RTLD_DEFAULT, dso_func);
+    if (!initClass)
+	{
+		snprintf(dso_func, sizeof(dso_func), "initClass__%d%sSFv",
+			(int) strlen(className), className);
+		initClass = (void (*)(void)) dlsym(RTLD_DEFAULT, dso_func);
+    }
 #endif
 
-#ifdef TIMELOAD
-struct timeval starttime, endtime, dlOpenTime;
-gettimeofday(&starttime);
-#endif
+    if (!handle && !initClass)
+	{
+		printf("WIREFUNC ERROR: could not load wirefunc class: %s\n", className);
+		return(-1);
+    }
+    if (initClass) (*initClass)();
 
-    // OK, try to load through DSO.
-    //MlDSOLoader loader;
-    //MlDSOLoader::loadFile(path);
-#ifdef _WINDOWS
-	HMODULE handle = LoadLibrary((LPCTSTR)path);
-#endif
+    if (atkGetLoadTiming())
+		printf("WIREFUNC: Loaded %s in %.3f ms (open %.3f ms)\n", className,
+			atkMillisSince(startTime), openTime);
+    return(0);
+}
 
-    char dso_func[1024];
-    void (*initClass)(void);// initClass function pointer
-    initClass = NULL;
+const char*
+AtkWireFunc::getDsoPath()
+{
+    const char* path = getenv("MLE_ATK_WIREFUNC_PATH");
+    return((path && *path) ? path : WIRE_FUNC_DSO_PATH);
+}
+
+// Add a DSO to the index, replacing the one the name had.
+static void
+atkAddToIndex(const char* name, const char* path)
+{
+    std::lock_guard<std::mutex> guard(g_wireFuncLock);
+    unsigned int hash = atkHashString(name);
+    AtkWireFuncDso* dso = (AtkWireFuncDso*) g_dsoIndex.find(name, hash);
+    if (dso)
+	{
+		if (!strcmp(dso->path, path)) return;
+		free(dso->path);
+		dso->path = atkStrdup(path);
+		dso->loaded = 0;
+		g_generation++;
+		return;
+    }
+
+    g_generation++;
+    dso = new AtkWireFuncDso;
+    dso->name = atkStrdup(name);
+    dso->path = atkStrdup(path);
+    dso->loaded = 0;
+    g_dsoIndex.set(dso->name, hash, dso);
+}
+
+// Add a DSO to the index if its file name is that of a wire func.
+static int
+atkIndexDso(const char* dsoPath, const char* fileName)
+{
+    int prefixLen = 3;
+    int suffixLen = (int) strlen(ATK_WIRE_FUNC_DSO_SUFFIX);
+    int len = (int) strlen(fileName);
+    if (len <= prefixLen + suffixLen || strncmp(fileName, "Mle", prefixLen) ||
+		strcmp(fileName + len - suffixLen, ATK_WIRE_FUNC_DSO_SUFFIX))
+		return(0);
+
+    char name[MAX_MSG_NAME_LEN];
+    int nameLen = len - prefixLen - suffixLen;
+    if (nameLen >= MAX_MSG_NAME_LEN) return(0);
+    memcpy(name, fileName + prefixLen, nameLen);
+    name[nameLen] = 0;
 
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s%s%s", dsoPath, ATK_WIRE_FUNC_PATH_SEPARATOR, fileName);
+    atkAddToIndex(name, path);
+    return(1);
+}
+
+int
+AtkWireFunc::indexDsos(const char* dsoPath)
+{
+    int count = 0;
 #if defined(_WINDOWS)
-	sprintf(dso_func,"initClass");
-    initClass = (void (*)(void))GetProcAddress(handle,dso_func);
+    char pattern[PATH_MAX];
+    snprintf(pattern, PATH_MAX, "%s\\Mle*%s", dsoPath, ATK_WIRE_FUNC_DSO_SUFFIX);
+    WIN32_FIND_DATAA data;
+    HANDLE dir = FindFirstFileA(pattern, &data);
+    if (dir == INVALID_HANDLE_VALUE) return(-1);
+    do
+		count += atkIndexDso(dsoPath, data.cFileName);
+    while (FindNextFileA(dir, &data));
+    FindClose(dir);
 #else
-    sprintf(dso_func,"initClass__%ld%sSFv", strlen(className),className);
-    //void* handle = dlopen(NULL,RTLD_NOW);
-#ifdef TIMELOAD
-gettimeofday(&dlOpenTime);
-#endif
-    initClass = (void (*)(void))dlsym(0,dso_func);
-    //initClass = (void (*)(void))dlsym(handle,dso_func);
+    DIR* dir = opendir(dsoPath);
+    if (!dir) return(-1);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+		count += atkIndexDso(dsoPath, entry->d_name);
+    closedir(dir);
 #endif
-    if (!initClass)
+    return(count);
+}
+
+int
+AtkWireFunc::writeIndex(const char* indexPath, const char* dsoPath)
+{
+    if (!dsoPath) dsoPath = getDsoPath();
+    char defaultPath[PATH_MAX];
+    if (!indexPath)
 	{
-		printf("WIREFUNC ERROR: could not load wirefunc class: %s\n", className);
-		return(NULL);
-    } else
+		snprintf(defaultPath, PATH_MAX, "%s%s%s", dsoPath,
+			ATK_WIRE_FUNC_PATH_SEPARATOR, ATK_WIREFUNC_INDEX_NAME);
+		indexPath = defaultPath;
+    }
+
+    if (indexDsos(dsoPath) < 0)
 	{
-		(*initClass)();
-		printf("Init class\n");
+		printf("WIREFUNC ERROR: could not read wirefunc directory: %s\n", dsoPath);
+		return(-1);
     }
 
-    //if (loader.loadClass(className)) {
-    //    printf("WIREFUNC ERROR: could not load wirefunc class: %s\n", className);
-    //    return(NULL);
-    //}
-
-#ifdef TIMELOAD
-gettimeofday(&endtime);
-float totalTime = (endtime.tv_sec - starttime.tv_sec) +
-		 (float(endtime.tv_usec - starttime.tv_usec)/1000000.0);
-printf("TotalTime to load wirefunc:  %s: %f\n", className, totalTime);
-totalTime = (dlOpenTime.tv_sec - starttime.tv_sec) +
-		 (float(dlOpenTime.tv_usec - starttime.tv_usec)/1000000.0);
-printf("TotalTime to dlopen:  %s: %f\n", className, totalTime);
-#endif
+    FILE* file = fopen(indexPath, "w");
+    if (!file)
+	{
+		printf("WIREFUNC ERROR: could not write wirefunc index: %s\n", indexPath);
+		return(-1);
+    }
 
-	MLE_DEBUG_CAT("ATK",
-		printf("WIREFUNC: Loaded wirefunc class from DSO: %s  for %s array\n", className, recv ? "RECV": "NORMAL");
-	);
+    // The index holds what was read before as well as what was found.
+    int count = 0;
+    fprintf(file, "# Magic Lantern wire func DSOs: <message name> <path>\n");
+    {
+		std::lock_guard<std::mutex> guard(g_wireFuncLock);
+		for (int i = 0; i < g_dsoIndex.getNumSlots(); i++)
+		{
+			AtkWireFuncDso* dso = (AtkWireFuncDso*) g_dsoIndex.getValue(i);
+			if (!dso) continue;
+			fprintf(file, "%s %s\n", dso->name, dso->path);
+			count++;
+		}
+    }
+    if (fclose(file))
+	{
+		printf("WIREFUNC ERROR: could not write wirefunc index: %s\n", indexPath);
+		return(-1);
+    }
+    return(count);
+}
 
-    // search through array again
-    wireFunc = findInArray(msgName, recv);
-    if (wireFunc) return(wireFunc);
+int
+AtkWireFunc::readIndex(const char* indexPath)
+{
+    char defaultPath[PATH_MAX];
+    if (!indexPath)
+	{
+		snprintf(defaultPath, PATH_MAX, "%s%s%s", getDsoPath(),
+			ATK_WIRE_FUNC_PATH_SEPARATOR, ATK_WIREFUNC_INDEX_NAME);
+		indexPath = defaultPath;
+    }
 
-    // error
-    printf("WIREFUNC ERROR: could not find wirefunc class (but loaded dso): %s\n", className);
-    return(NULL);
+    FILE* file = fopen(indexPath, "r");
+    if (!file) return(-1);
+
+    // Each line is a name and, after one space, the path to the end of
+    // the line; the path may hold spaces.
+    int count = 0;
+    char line[MAX_MSG_NAME_LEN + PATH_MAX + 2];
+    while (fgets(line, sizeof(line), file))
+	{
+		int len = (int) strlen(line);
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = 0;
+		if (!len || line[0] == '#') continue;
+
+		char* path = strchr(line, ' ');
+		if (!path || path == line || path - line >= MAX_MSG_NAME_LEN || !path[1])
+		{
+			printf("WIREFUNC ERROR: bad line in wirefunc index %s: %s\n", indexPath, line);
+			continue;
+		}
+		*path++ = 0;
+		atkAddToIndex(line, path);
+		count++;
+    }
+    fclose(file);
+    return(count);
 }
 
-AtkWireFunc*
-AtkWireFunc::findInArray(const char* name, int recv)
+int
+AtkWireFunc::preload(const char* indexPath, int background)
 {
-    int len = (recv) ? g_recvWireFuncs.getLength() : g_wireFuncs.getLength();
-    for (int i=0; i<len; i++)
+    waitForPreload();
+
+    g_preloadStart = AtkWireStats::now();
+    int count = readIndex(indexPath);
+    if (count < 0)
 	{
-        struct AtkCreateWireFunc* cwf = (recv) ? g_recvWireFuncs[i]: g_wireFuncs[i];
-        if (!strcmp(cwf->name, name))
+		// Without an index, look through the directory instead.
+		count = indexDsos(getDsoPath());
+		if (count < 0)
 		{
-		    // Create the func
-		    AtkWireFunc* wireFunc = (*cwf->createFunc)();
-	        return(wireFunc);
-        }
-	}
-    return(NULL);
+			printf("WIREFUNC ERROR: no wirefunc index or directory to preload from: %s\n",
+				getDsoPath());
+			return(-1);
+		}
+    }
+
+    if (background) g_preloadThread = new std::thread(&AtkWireFunc::preloadAll);
+    else preloadAll();
+    return(count);
+}
+
+void
+AtkWireFunc::preloadAll()
+{
+    std::vector<AtkWireFuncDso*> dsos;
+    {
+		std::lock_guard<std::mutex> guard(g_wireFuncLock);
+		for (int i = 0; i < g_dsoIndex.getNumSlots(); i++)
+			if (g_dsoIndex.getValue(i))
+				dsos.push_back((AtkWireFuncDso*) g_dsoIndex.getValue(i));
+    }
+
+    int numLoaded = 0;
+    for (size_t i = 0; i < dsos.size(); i++)
+	{
+		// Skip what is loaded on demand meanwhile or linked in.
+		char name[MAX_MSG_NAME_LEN];
+		char path[PATH_MAX];
+		{
+			std::lock_guard<std::mutex> guard(g_wireFuncLock);
+			AtkWireFuncDso* dso = dsos[i];
+			unsigned int hash = atkHashString(dso->name);
+			if (dso->loaded || g_wireFuncs.find(dso->name, hash) ||
+				g_recvWireFuncs.find(dso->name, hash))
+				continue;
+			dso->loaded = 1;
+			strncpy(name, dso->name, MAX_MSG_NAME_LEN - 1);
+			name[MAX_MSG_NAME_LEN - 1] = 0;
+			strncpy(path, dso->path, PATH_MAX - 1);
+			path[PATH_MAX - 1] = 0;
+		}
+		if (loadDso(name, path) == 0) numLoaded++;
+    }
+
+    if (atkGetLoadTiming())
+		printf("WIREFUNC: Preloaded %d of %d wirefuncs in %.3f ms\n", numLoaded,
+			(int) dsos.size(), atkMillisSince(g_preloadStart));
+    g_generation++;
+}
+
+void
+AtkWireFunc::waitForPreload()
+{
+    if (!g_preloadThread) return;
+    g_preloadThread->join();
+    delete g_preloadThread;
+    g_preloadThread = NULL;
+}
+
+unsigned int
+AtkWireFunc::getGeneration()
+{
+    return(g_generation);
+}
+
+void
+AtkWireFunc::setLoadTiming(int enable)
+{
+    g_loadTiming = enable;
+}
+
+AtkWireFunc*
+AtkWireFunc::findInArray(const char* name, int recv)
+{
+    // Only what is already registered; nothing is loaded.
+    std::lock_guard<std::mutex> guard(g_wireFuncLock);
+    AtkWireFuncTable& table = recv ? g_recvWireFuncs : g_wireFuncs;
+    AtkCreateWireFunc* cwf = (AtkCreateWireFunc*) table.find(name, atkHashString(name));
+    if (!cwf) return(NULL);
+    if (!cwf->instance) cwf->instance = (*cwf->createFunc)();
+    return(cwf->instance);
 }
 
 AtkWireFunc*
@@ -194,29 +592,42 @@ AtkWireFunc::findRecv(const char* name)
 void
 AtkWireFunc::addToArray(const char* name, AtkCreateFunc createFunc)
 {
-    struct AtkCreateWireFunc* cwf = new AtkCreateWireFunc;
-    cwf->createFunc = createFunc;
-#if defined(_WINDOWS)
-	cwf->name = _strdup(name);
-#else
-    cwf->name = strdup(name);
-#endif
-    g_wireFuncs.add(cwf);
-    //printf("Added: %s to array - len %d\n", name, wireFuncs.getLength());
+    addToTable(g_wireFuncs, name, createFunc);
+    //printf("Added: %s to array - len %d\n", name, g_wireFuncs.getCount());
 }
 
 void
 AtkWireFunc::addToRecvArray(const char* name, AtkCreateFunc createFunc)
 {
-    struct AtkCreateWireFunc* cwf = new AtkCreateWireFunc;
+    addToTable(g_recvWireFuncs, name, createFunc);
+    //printf("Added: %s to recv array - len %d\n", name, g_recvWireFuncs.getCount());
+}
+
+void
+AtkWireFunc::addToTable(AtkWireFuncTable& table, const char* name, AtkCreateFunc createFunc)
+{
+    // A class registered both statically and by initClass() is added
+    // once.
+    std::lock_guard<std::mutex> guard(g_wireFuncLock);
+    unsigned int hash = atkHashString(name);
+    AtkCreateWireFunc* cwf = (AtkCreateWireFunc*) table.find(name, hash);
+    g_generation++;
+    if (cwf)
+	{
+		cwf->createFunc = createFunc;
+		return;
+    }
+
+    cwf = new AtkCreateWireFunc;
     cwf->createFunc = createFunc;
 #if defined(_WINDOWS)
 	cwf->name = _strdup(name);
 #else
     cwf->name = strdup(name);
 #endif
-    g_recvWireFuncs.add(cwf);
-    //printf("Added: %s to recv array - len %d\n", name, recvWireFuncs.getLength());
+    cwf->hash = hash;
+    cwf->instance = NULL;
+    table.set(cwf->name, hash, cwf);
 }
 
 AtkWireMsg* 
@@ -249,11 +660,12 @@ AtkWireFunc::recvMsg(AtkWired*, AtkWireMsg* msg)
 void
 AtkWireFunc::printWireFuncs(int recv)
 {
-    int len = (recv) ? g_recvWireFuncs.getLength() : g_wireFuncs.getLength();
-    for (int i=0; i<len; i++)
+    std::lock_guard<std::mutex> guard(g_wireFuncLock);
+    AtkWireFuncTable& table = recv ? g_recvWireFuncs : g_wireFuncs;
+    for (int i=0; i<table.getNumSlots(); i++)
 	{
-       struct AtkCreateWireFunc* cwf = (recv) ? g_recvWireFuncs[i]: g_wireFuncs[i];
-       printf("WF: %s\n", cwf->name);
+       struct AtkCreateWireFunc* cwf = (struct AtkCreateWireFunc*) table.getValue(i);
+       if (cwf) printf("WF: %s\n", cwf->name);
     }
 }
 
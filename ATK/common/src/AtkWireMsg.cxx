@@ -42,6 +42,9 @@
 
 // Include system header files.
 #include <string.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
 
 // Include Magic Lantern header files.
 #include <mle/mlAssert.h>
@@ -51,6 +54,14 @@
 // Include Authoring Toolkit header files.
 #include "mle/AtkWire.h"
 #include "mle/AtkWireMsg.h"
+#include "mle/AtkWirePool.h"
+
+// The smallest buffer allocated once parameters are being added.
+#define ATK_WIRE_MSG_MIN_CAPACITY 64
+
+// Whether the message may modify and grow its data in place.
+#define ATK_WIRE_MSG_DATA_IS_OURS(ownership) \
+    ((ownership) == ATK_WIRE_MSG_DATA_OWNED || (ownership) == ATK_WIRE_MSG_DATA_POOLED)
 
 
 AtkWireMsg::AtkWireMsg(void* destObj, const char* msgName, int waitForReply, 
@@ -64,9 +75,13 @@ AtkWireMsg::AtkWireMsg(void* destObj, const char* msgName, int waitForReply,
     // Copy data - note that this is a little controversial since you must
     // allocate a data slot just to send a msg.
     this->m_msgData = 0;
+    this->m_dataCapacity = 0;
+    m_dataOwnership = ATK_WIRE_MSG_DATA_OWNED;
     if (msgData && msgDataLen > 0)
 	{
-		this->m_msgData = mlMalloc(msgDataLen);
+		this->m_msgData = AtkWirePool::alloc(msgDataLen);
+		this->m_dataCapacity = AtkWirePool::getCapacity(this->m_msgData);
+		m_dataOwnership = ATK_WIRE_MSG_DATA_POOLED;
 		//bcopy(msgData, this->msgData, msgDataLen);
 		memcpy(this->m_msgData, msgData, msgDataLen);
 	}
@@ -75,6 +90,9 @@ AtkWireMsg::AtkWireMsg(void* destObj, const char* msgName, int waitForReply,
     // Initialize next field.
     m_next = NULL;
     m_curParamOffset = 0;
+    m_correlationID = 0;
+    m_recvTime = 0;
+    m_mappedLen = 0;
 }
 
 AtkWireMsg::~AtkWireMsg()
@@ -89,7 +107,7 @@ AtkWireMsg::~AtkWireMsg()
 		}
     );
 
-    if (m_msgData) mlFree(m_msgData);
+    freeMsgData();
 }
 
 void
@@ -115,12 +133,19 @@ AtkWireMsg::getStartAddress()
 }
 
 
-// XXX - this relies on the data packing 
 int 
 AtkWireMsg::getHeaderLength()
 {
+    return(getFrameHeaderLength());
+}
+
+int
+AtkWireMsg::getFrameHeaderLength()
+{
+    // The total length, the name, the destination and whether the sender
+    // waits for a reply.  The destination was once a pointer, and keeps
+    // a pointer's width so that older peers can still read the frames.
     return(sizeof(int) + MAX_MSG_NAME_LEN + sizeof(void*) + sizeof(char));
-    //return(((char*) &m_msgData) - ((char*) &m_totalMsgLen));
 }
 
 int 
@@ -132,27 +157,196 @@ AtkWireMsg::getDataLength()
 void
 AtkWireMsg::allocMsgData()
 {
-    if (m_msgData) mlFree(m_msgData);
-	m_msgData = 0;
+    freeMsgData();
     if (getDataLength() > 0)
 	{
-		m_msgData = mlMalloc(getDataLength());
+		m_msgData = AtkWirePool::alloc(getDataLength());
+		m_dataCapacity = AtkWirePool::getCapacity(m_msgData);
+		m_dataOwnership = ATK_WIRE_MSG_DATA_POOLED;
     }
 }
 
 void
 AtkWireMsg::setMsgData(void* data, int len)
 {
-    if (m_msgData) mlFree(m_msgData);
-    m_msgData = 0;
+    freeMsgData();
     if (len > 0) {
-		m_msgData = mlMalloc(len);
+		m_msgData = AtkWirePool::alloc(len);
+		m_dataCapacity = AtkWirePool::getCapacity(m_msgData);
+		m_dataOwnership = ATK_WIRE_MSG_DATA_POOLED;
 		//if (data) bcopy(data, msgData, len);
 		if (data) memcpy(m_msgData, data, len);
     }
     m_totalMsgLen = len+getHeaderLength();
 }
 
+void
+AtkWireMsg::setMsgDataRef(void* data, int len)
+{
+    freeMsgData();
+    if (data && len > 0)
+	{
+		m_msgData = data;
+		m_dataOwnership = ATK_WIRE_MSG_DATA_BORROWED;
+    } else
+	{
+		len = 0;
+	}
+    m_totalMsgLen = len+getHeaderLength();
+}
+
+void*
+AtkWireMsg::extendMsgData(int len)
+{
+    int oldLen = getDataLength();
+    growMsgData(oldLen + len);
+    m_totalMsgLen += len;
+
+    return(((char*) m_msgData) + oldLen);
+}
+
+void
+AtkWireMsg::growMsgData(int len)
+{
+    if (ATK_WIRE_MSG_DATA_IS_OURS(m_dataOwnership) && len <= m_dataCapacity) return;
+
+    int capacity = m_dataCapacity ? 2 * m_dataCapacity : ATK_WIRE_MSG_MIN_CAPACITY;
+    if (capacity < len) capacity = len;
+
+    int oldLen = getDataLength();
+    if (m_dataOwnership != ATK_WIRE_MSG_DATA_POOLED)
+	{
+		// Move the data into the pool; data that isn't ours is copied
+		// before it is modified.
+		void* data = AtkWirePool::alloc(capacity);
+		if (oldLen > 0) memcpy(data, m_msgData, oldLen);
+		freeMsgData();
+		m_msgData = data;
+		m_dataOwnership = ATK_WIRE_MSG_DATA_POOLED;
+    } else
+	{
+		m_msgData = AtkWirePool::resize(m_msgData, capacity);
+    }
+    m_dataCapacity = AtkWirePool::getCapacity(m_msgData);
+}
+
+void
+AtkWireMsg::reserveMsgData(int len)
+{
+    if (len > getDataLength()) growMsgData(len);
+}
+
+void
+AtkWireMsg::clearMsgData()
+{
+    // Data that isn't ours can't be reused.
+    if (!ATK_WIRE_MSG_DATA_IS_OURS(m_dataOwnership)) freeMsgData();
+    m_totalMsgLen = getHeaderLength();
+    m_curParamOffset = 0;
+}
+
+void
+AtkWireMsg::reset(void* destObj, const char* msgName, int waitForReply)
+{
+    memset(m_msgName, 0, MAX_MSG_NAME_LEN);
+    if (msgName) strncpy(m_msgName, msgName, MAX_MSG_NAME_LEN - 1);
+    m_destObj = destObj;
+    m_waitForReply = waitForReply;
+    m_next = NULL;
+    m_correlationID = 0;
+    m_recvTime = 0;
+    clearMsgData();
+}
+
+void
+AtkWireMsg::freeMsgData()
+{
+    if (m_msgData)
+	{
+		if (m_dataOwnership == ATK_WIRE_MSG_DATA_POOLED)
+		{
+			AtkWirePool::release(m_msgData);
+		} else if (m_dataOwnership == ATK_WIRE_MSG_DATA_OWNED)
+		{
+			mlFree(m_msgData);
+		} else if (m_dataOwnership == ATK_WIRE_MSG_DATA_MAPPED)
+		{
+#if defined(__linux__) || defined(__APPLE__)
+			munmap(m_msgData, m_mappedLen);
+#endif
+		}
+    }
+    m_msgData = 0;
+    m_dataCapacity = 0;
+    m_dataOwnership = ATK_WIRE_MSG_DATA_OWNED;
+}
+
+void
+AtkWireMsg::setMsgDataMapped(void* data, int len)
+{
+    freeMsgData();
+    if (data && len > 0)
+	{
+		m_msgData = data;
+		m_dataOwnership = ATK_WIRE_MSG_DATA_MAPPED;
+		m_mappedLen = len;
+    } else
+	{
+		len = 0;
+	}
+    m_totalMsgLen = len+getHeaderLength();
+}
+
+void
+AtkWireMsg::adoptMsgData(void* data, int len)
+{
+    freeMsgData();
+    if (data && len > 0)
+	{
+		m_msgData = data;
+		m_dataCapacity = len;
+    } else
+	{
+		if (data) mlFree(data);
+		len = 0;
+	}
+    m_totalMsgLen = len+getHeaderLength();
+}
+
+void
+AtkWireMsg::adoptPooledMsgData(void* data, int len)
+{
+    freeMsgData();
+    if (data && len > 0)
+	{
+		m_msgData = data;
+		m_dataCapacity = AtkWirePool::getCapacity(data);
+		m_dataOwnership = ATK_WIRE_MSG_DATA_POOLED;
+    } else
+	{
+		AtkWirePool::release(data);
+		len = 0;
+	}
+    m_totalMsgLen = len+getHeaderLength();
+}
+
+void
+AtkWireMsg::truncateMsgData(int len)
+{
+    MLE_ASSERT(len >= 0 && len <= getDataLength());
+
+    // The buffer keeps its size; a mapping is still unmapped whole.
+    m_totalMsgLen = len+getHeaderLength();
+    if (m_curParamOffset > len) m_curParamOffset = len;
+}
+
+void
+AtkWireMsg::setMsgFlags(int flags)
+{
+    MLE_ASSERT(!flags || strlen(m_msgName) < ATK_WIRE_MSG_FLAGS_INDEX);
+    m_msgName[ATK_WIRE_MSG_FLAGS_INDEX] = (char) flags;
+}
+
 int 
 AtkWireMsg::isReplyMsg()
 {
@@ -166,31 +360,24 @@ AtkWireMsg::isReplyMsg()
 void 
 AtkWireMsg::addParam(int i)
 {
-    m_totalMsgLen += sizeof(int);
-    m_msgData = mlRealloc(m_msgData, getDataLength());
-    //bcopy(&i, ((char*) msgData) + getDataLength() - sizeof(int), sizeof(int));
-    memcpy(((char*) m_msgData) + getDataLength() - sizeof(int), &i, sizeof(int));
+    memcpy(extendMsgData(sizeof(int)), &i, sizeof(int));
 }
 
 void 
 AtkWireMsg::addParam(const char* s)
 {
     if (!s) s = "";
-    m_totalMsgLen += strlen(s)+1;
-    m_msgData = mlRealloc(m_msgData, getDataLength());
-    strcpy(((char*) m_msgData) + getDataLength() - strlen(s)-1, s);
+    int len = strlen(s)+1;
+    memcpy(extendMsgData(len), s, len);
 }
 
 void 
 AtkWireMsg::addParam(void* data, int len)
 {
     if (!data || !len) return;
-    m_totalMsgLen += len + sizeof(int);
-    m_msgData = mlRealloc(m_msgData, getDataLength());
-    //bcopy(&len, ((char*) msgData) + getDataLength()-len-sizeof(int), sizeof(int));
-    //bcopy(data, ((char*) msgData) + getDataLength() - len, len);
-	memcpy(((char*) m_msgData) + getDataLength()-len-sizeof(int), &len, sizeof(int));
-    memcpy(((char*) m_msgData) + getDataLength() - len, data, len);
+    char* p = (char*) extendMsgData(len + sizeof(int));
+	memcpy(p, &len, sizeof(int));
+    memcpy(p + sizeof(int), data, len);
 }
 
 // NOTE: This is important to be pass by value (&xform) because
@@ -201,46 +388,25 @@ void
 AtkWireMsg::addParam(MlTransform &xform)
 {
     int len = sizeof(MlTransform);
-    m_totalMsgLen += len;
-    m_msgData = mlRealloc(m_msgData, getDataLength());
-    //bcopy(&xform, ((char*) msgData) + getDataLength() - len, len);
-	memcpy(((char*) m_msgData) + getDataLength() - len, &xform, len);
+	memcpy(extendMsgData(len), &xform, len);
 }
 
 void
 AtkWireMsg::addParam(const char** strArray)
 {
-    // Calc length of str array.
-    int len=0;
+    // Each string is measured once and appended; the buffer grows
+    // geometrically, so this is linear in the total length.
     for (int i=0; strArray && strArray[i] && *(strArray[i]); i++)
 	{
-		len += strlen(strArray[i]) + 1;
+		int strLen = strlen(strArray[i]) + 1;
+		memcpy(extendMsgData(strLen), strArray[i], strLen);
     }
-    len++;
-
-    // Realloc buffer length.
-    m_totalMsgLen += len;
-    m_msgData = mlRealloc(m_msgData, getDataLength());
-
-    // Copy data.
-    int index = getDataLength() - len;
-    for (int j=0; strArray && strArray[j] && *(strArray[j]); j++)
-	{
-		//bcopy(strArray[j], ((char*) msgData) + index, strlen(strArray[j])+1);
-		memcpy(((char*) m_msgData) + index, strArray[j], strlen(strArray[j])+1);
-		index += strlen(strArray[j]) + 1;
-    }
-    *(((char*) m_msgData)+index) = 0;
+    *((char*) extendMsgData(1)) = 0;
 }
 
 void AtkWireMsg::addParam(const float f[3])
 {
-    m_totalMsgLen += sizeof(float) * 3;
-    m_msgData = mlRealloc(m_msgData, getDataLength());
-    //bcopy(f, ((char*) msgData) + getDataLength() - sizeof(float)*3, 
-	//sizeof(float)*3);
-	memcpy(((char*) m_msgData) + getDataLength() - sizeof(float)*3, f,
-	sizeof(float)*3);
+	memcpy(extendMsgData(sizeof(float) * 3), f, sizeof(float)*3);
 }
 
 void 
@@ -267,43 +433,96 @@ AtkWireMsg::getParam(int &i)
 int 
 AtkWireMsg::getParam(char* s)
 {
-    strcpy(s, ((char*) m_msgData) + m_curParamOffset);
-    if (m_curParamOffset + strlen(s) + 1 > (unsigned int) getDataLength())
-	{
-        printf("WM: getParam (char*) error curParamOffset: %d  str: %s, %zu  dataLength: %d\n",
-			 m_curParamOffset, s, strlen(s), getDataLength());
-		return(-1);
-    }
-    m_curParamOffset += strlen(s)+1;
+    // The string is checked against the data before it is copied.
+    const char* view;
+    int len = getParamView(view);
+    if (len < 0) return(-1);
+    memcpy(s, view, len + 1);
     return(0);
 }
 
 int 
 AtkWireMsg::getParam(void* &data, int& len)
 {
-    if (m_curParamOffset + sizeof(int) > (unsigned int) getDataLength())
+    data = NULL;
+    const void* view;
+    len = getParamView(view);
+    if (len < 0) return(-1);
+    data = mlMalloc(len);
+    memcpy(data, view, len);
+    return(0);
+}
+
+int
+AtkWireMsg::getParamView(const char* &s)
+{
+    // The terminator must be inside the data.
+    int avail = getDataLength() - m_curParamOffset;
+    const char* p = ((const char*) m_msgData) + m_curParamOffset;
+    const char* end = (m_msgData && avail > 0) ? (const char*) memchr(p, 0, avail) : NULL;
+    if (!end)
+	{
+		printf("WM: getParam (char*) error curParamOffset: %d  dataLength: %d\n",
+			 m_curParamOffset, getDataLength());
+		return(-1);
+    }
+
+    s = p;
+    int len = end - p;
+    m_curParamOffset += len + 1;
+    return(len);
+}
+
+int
+AtkWireMsg::getParamView(const void* &data)
+{
+    int avail = getDataLength() - m_curParamOffset;
+    if (!m_msgData || avail < (int) sizeof(int))
 	{
 		printf("WM: getParam (void*) error curParamOffset: %d  dataLength: %d\n",
 			 m_curParamOffset, getDataLength());
 		return(-1);
     }
-    //bcopy(((char*) msgData) + curParamOffset, &len, sizeof(int));
-	memcpy(&len, ((char*) m_msgData) + m_curParamOffset, sizeof(int));
-    m_curParamOffset += sizeof(int);
 
-    data = NULL;
-    if (len <= 0) return -1;
-    data = mlMalloc(len);
-    if (m_curParamOffset + len > getDataLength())
+    int len;
+	memcpy(&len, ((char*) m_msgData) + m_curParamOffset, sizeof(int));
+    if (len <= 0 || len > avail - (int) sizeof(int))
 	{
 		printf("WM: getParam (void*) error curParamOffset: %d  len: %d  dataLength: %d\n",
 			 m_curParamOffset, len, getDataLength());
 		return(-1);
     }
-    //bcopy(((char*) msgData) + curParamOffset, data, len);
-	memcpy(data, ((char*) m_msgData) + m_curParamOffset, len);
-    m_curParamOffset += len;
-    return(0);
+
+    data = ((char*) m_msgData) + m_curParamOffset + sizeof(int);
+    m_curParamOffset += sizeof(int) + len;
+    return(len);
+}
+
+int
+AtkWireMsg::getParamArrayView(const char* &strs)
+{
+    const char* start = ((const char*) m_msgData) + m_curParamOffset;
+    const char* limit = ((const char*) m_msgData) + getDataLength();
+    const char* p = start;
+    int numStrs = 0;
+    for (;;)
+	{
+		const char* end = (m_msgData && p < limit) ?
+			(const char*) memchr(p, 0, limit - p) : NULL;
+		if (!end)
+		{
+			printf("WM: getParam (char**) error curParamOffset: %d  dataLength: %d\n",
+				 m_curParamOffset, getDataLength());
+			return(-1);
+		}
+		if (end == p) break;
+		numStrs++;
+		p = end + 1;
+    }
+
+    strs = start;
+    m_curParamOffset += (p + 1) - start;
+    return(numStrs);
 }
 
 int
@@ -360,23 +579,16 @@ int
 AtkWireMsg::getParam(char*** strArray)
 {
     // Find number and length.
-    char* p= ((char*) m_msgData) + m_curParamOffset;
-    int len = 0, numStrs = 0;
-    for (; *p;  numStrs++,p += strlen(p)+1) len += strlen(p)+1;
-
-    // Check.
-    if (m_curParamOffset + len > getDataLength())
-	{
-		printf("WM: getParam (char**) error curParamOffset: %d  len: %d  dataLength: %d\n",
-			 m_curParamOffset, len, getDataLength());
-		return(-1);
-    }
+    int start = m_curParamOffset;
+    const char* p;
+    int numStrs = getParamArrayView(p);
+    if (numStrs < 0) return(-1);
+    int len = m_curParamOffset - start - 1;
     
     // Allocate space.
     *strArray = (char**) mlMalloc(sizeof(char*) * (numStrs+1));
 
     // get data.
-    p = ((char*) m_msgData) + m_curParamOffset;
 	int i;
     for (i=0; *p; p+=strlen(p)+1, i++)
 	{
@@ -430,25 +642,25 @@ void AtkWireMsg::print(char *headerMsg)
 void *
 AtkWireMsg::operator new(size_t tSize)
 {
-	void *p = mlMalloc(tSize);
+	void *p = AtkWirePool::alloc(tSize);
 	return p;
 }
 
 void
 AtkWireMsg::operator delete(void *p)
 {
-	mlFree(p);
+	AtkWirePool::release(p);
 }
 
 void*
 AtkWireMsg::operator new[](size_t tSize)
 {
-    void* p = mlMalloc(tSize);
+    void* p = AtkWirePool::alloc(tSize);
     return p;
 }
 
 void
 AtkWireMsg::operator delete[](void* p)
 {
-    mlFree(p);
+    AtkWirePool::release(p);
 }
@@ -0,0 +1,106 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireMsgQueue.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that provides a
+ * lock-free queue for handing messages from one thread to another.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWireMsg.h"
+#include "mle/AtkWireMsgQueue.h"
+
+
+AtkWireMsgQueue::AtkWireMsgQueue(int capacity)
+{
+    int size = 2;
+    while (size < capacity) size <<= 1;
+
+    m_slots = (AtkWireMsg**) mlMalloc(size * sizeof(AtkWireMsg*));
+    m_mask = size - 1;
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+}
+
+AtkWireMsgQueue::~AtkWireMsgQueue()
+{
+    AtkWireMsg* msg;
+    while ((msg = pop()) != NULL) delete msg;
+    mlFree(m_slots);
+}
+
+int
+AtkWireMsgQueue::push(AtkWireMsg* msg)
+{
+    unsigned int tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > (unsigned int) m_mask)
+		return(-1);
+
+    // Publish the slot before the index that makes it visible.
+    m_slots[tail & m_mask] = msg;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return(0);
+}
+
+AtkWireMsg*
+AtkWireMsgQueue::pop()
+{
+    unsigned int head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) return(NULL);
+
+    // Take the message before handing the slot back to the producer.
+    AtkWireMsg* msg = m_slots[head & m_mask];
+    m_head.store(head + 1, std::memory_order_release);
+    return(msg);
+}
+
+void *
+AtkWireMsgQueue::operator new(size_t tSize)
+{
+	void *p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkWireMsgQueue::operator delete(void *p)
+{
+	mlFree(p);
+}
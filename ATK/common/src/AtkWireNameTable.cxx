@@ -0,0 +1,188 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireNameTable.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that maps message
+ * names to compact numeric IDs.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <string.h>
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWireNameTable.h"
+
+// The initial number of names a table has room for.
+#define ATK_NAME_TABLE_INITIAL_SIZE 64
+
+
+unsigned int
+atkHashString(const char* s)
+{
+    unsigned int hash = 2166136261u;
+    for (; *s; s++)
+	{
+		hash ^= (unsigned char) *s;
+		hash *= 16777619u;
+    }
+    return(hash);
+}
+
+AtkWireNameTable::AtkWireNameTable()
+{
+    m_names = NULL;
+    m_numNames = 0;
+    m_maxNames = 0;
+    m_slots = NULL;
+    m_slotMask = -1;
+}
+
+AtkWireNameTable::~AtkWireNameTable()
+{
+    if (m_names) mlFree(m_names);
+    if (m_slots) mlFree(m_slots);
+}
+
+void
+AtkWireNameTable::clear()
+{
+    m_numNames = 0;
+    if (m_slots) memset(m_slots, 0, (m_slotMask + 1) * sizeof(unsigned short));
+}
+
+int
+AtkWireNameTable::findSlot(const char* name, unsigned int hash)
+{
+    // Linear probing; the table is never more than half full.
+    int slot = hash & m_slotMask;
+    while (m_slots[slot] && strcmp(m_names[m_slots[slot] - 1], name))
+		slot = (slot + 1) & m_slotMask;
+    return(slot);
+}
+
+void
+AtkWireNameTable::rehash(int count)
+{
+    int size = 2 * ATK_NAME_TABLE_INITIAL_SIZE;
+    while (size < 2 * count) size <<= 1;
+
+    if (m_slots) mlFree(m_slots);
+    m_slots = (unsigned short*) mlMalloc(size * sizeof(unsigned short));
+    memset(m_slots, 0, size * sizeof(unsigned short));
+    m_slotMask = size - 1;
+
+    for (int id = 1; id <= m_numNames; id++)
+		if (m_names[id - 1][0])
+			m_slots[findSlot(m_names[id - 1], atkHashString(m_names[id - 1]))] = id;
+}
+
+int
+AtkWireNameTable::find(const char* name)
+{
+    if (!m_slots) return(0);
+    return(m_slots[findSlot(name, atkHashString(name))]);
+}
+
+int
+AtkWireNameTable::intern(const char* name, int* added)
+{
+    if (added) *added = 0;
+    if (!m_slots) rehash(0);
+
+    unsigned int hash = atkHashString(name);
+    int slot = findSlot(name, hash);
+    if (m_slots[slot]) return(m_slots[slot]);
+    if (m_numNames >= ATK_WIRE_MAX_NAME_ID) return(0);
+
+    // Give the name the next ID.
+    if (m_numNames == m_maxNames)
+	{
+		int size = m_maxNames ? 2 * m_maxNames : ATK_NAME_TABLE_INITIAL_SIZE;
+		m_names = (char (*)[MAX_MSG_NAME_LEN]) mlRealloc(m_names, size * MAX_MSG_NAME_LEN);
+		m_maxNames = size;
+    }
+    strncpy(m_names[m_numNames], name, MAX_MSG_NAME_LEN - 1);
+    m_names[m_numNames][MAX_MSG_NAME_LEN - 1] = 0;
+    int id = ++m_numNames;
+
+    if (2 * m_numNames > m_slotMask + 1) rehash(m_numNames);
+    else m_slots[slot] = id;
+
+    if (added) *added = 1;
+    return(id);
+}
+
+int
+AtkWireNameTable::define(int id, const char* name)
+{
+    if (id <= 0 || id > ATK_WIRE_MAX_NAME_ID) return(-1);
+
+    if (id > m_maxNames)
+	{
+		int size = m_maxNames ? m_maxNames : ATK_NAME_TABLE_INITIAL_SIZE;
+		while (size < id) size *= 2;
+		if (size > ATK_WIRE_MAX_NAME_ID) size = ATK_WIRE_MAX_NAME_ID;
+		m_names = (char (*)[MAX_MSG_NAME_LEN]) mlRealloc(m_names, size * MAX_MSG_NAME_LEN);
+		m_maxNames = size;
+    }
+
+    // IDs the other side skipped stay undefined.
+    for (; m_numNames < id; m_numNames++) m_names[m_numNames][0] = 0;
+    strncpy(m_names[id - 1], name, MAX_MSG_NAME_LEN - 1);
+    m_names[id - 1][MAX_MSG_NAME_LEN - 1] = 0;
+
+    if (!m_slots || 2 * m_numNames > m_slotMask + 1) rehash(m_numNames);
+    else m_slots[findSlot(m_names[id - 1], atkHashString(m_names[id - 1]))] = id;
+    return(0);
+}
+
+void *
+AtkWireNameTable::operator new(size_t tSize)
+{
+	void *p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkWireNameTable::operator delete(void *p)
+{
+	mlFree(p);
+}
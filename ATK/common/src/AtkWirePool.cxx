@@ -0,0 +1,236 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWirePool.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a size-classed pool for wire
+ * messages and their payload buffers.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWirePool.h"
+
+// The size of the smallest class of block.
+#define ATK_WIRE_POOL_MIN_BLOCK 32
+
+// Blocks are led by a header this large, which keeps them aligned.
+#define ATK_WIRE_POOL_HEADER_SIZE 16
+
+// The header in front of every block.
+struct AtkWirePoolHeader
+{
+    // The number of bytes the block has room for.
+    size_t m_capacity;
+    // The size class of the block, or -1 if it is not kept when released.
+    int m_class;
+};
+
+// The free blocks of one size class, linked through their first bytes.
+struct AtkWirePoolClass
+{
+    std::atomic<int> m_lock;
+    AtkWirePoolHeader* m_free;
+    int m_numFree;
+};
+
+// Everything here is zero-initialized before any constructor runs, so the
+// pool works for objects created during static initialization too.
+static AtkWirePoolClass g_atkPoolClasses[ATK_WIRE_POOL_NUM_CLASSES];
+static std::atomic<long long> g_atkPoolAllocs;
+static std::atomic<long long> g_atkPoolReused;
+static std::atomic<long long> g_atkPoolHeapAllocs;
+
+
+// Find the smallest size class that holds a size; -1 if none does.
+static int atkPoolClass(size_t size)
+{
+    if (size > ATK_WIRE_POOL_MAX_BLOCK) return(-1);
+    int c = 0;
+    while ((size_t) (ATK_WIRE_POOL_MIN_BLOCK << c) < size) c++;
+    return(c);
+}
+
+static void atkPoolLock(AtkWirePoolClass* c)
+{
+    while (c->m_lock.exchange(1, std::memory_order_acquire))
+		std::this_thread::yield();
+}
+
+static void atkPoolUnlock(AtkWirePoolClass* c)
+{
+    c->m_lock.store(0, std::memory_order_release);
+}
+
+static AtkWirePoolHeader** atkPoolLink(AtkWirePoolHeader* header)
+{
+    return((AtkWirePoolHeader**) (((char*) header) + ATK_WIRE_POOL_HEADER_SIZE));
+}
+
+void*
+AtkWirePool::alloc(size_t size)
+{
+    g_atkPoolAllocs.fetch_add(1, std::memory_order_relaxed);
+
+    int c = atkPoolClass(size);
+    AtkWirePoolHeader* header = NULL;
+    if (c >= 0)
+	{
+		AtkWirePoolClass* pool = &g_atkPoolClasses[c];
+		atkPoolLock(pool);
+		header = pool->m_free;
+		if (header)
+		{
+			pool->m_free = *atkPoolLink(header);
+			pool->m_numFree--;
+		}
+		atkPoolUnlock(pool);
+
+		if (header)
+		{
+			g_atkPoolReused.fetch_add(1, std::memory_order_relaxed);
+			return(((char*) header) + ATK_WIRE_POOL_HEADER_SIZE);
+		}
+		size = ATK_WIRE_POOL_MIN_BLOCK << c;
+    }
+
+    g_atkPoolHeapAllocs.fetch_add(1, std::memory_order_relaxed);
+    header = (AtkWirePoolHeader*) mlMalloc(ATK_WIRE_POOL_HEADER_SIZE + size);
+    header->m_capacity = size;
+    header->m_class = c;
+    return(((char*) header) + ATK_WIRE_POOL_HEADER_SIZE);
+}
+
+void
+AtkWirePool::release(void* p)
+{
+    if (!p) return;
+    AtkWirePoolHeader* header =
+		(AtkWirePoolHeader*) (((char*) p) - ATK_WIRE_POOL_HEADER_SIZE);
+
+    if (header->m_class >= 0)
+	{
+		AtkWirePoolClass* pool = &g_atkPoolClasses[header->m_class];
+		int kept = 0;
+		atkPoolLock(pool);
+		if ((pool->m_numFree + 1) * header->m_capacity <= ATK_WIRE_POOL_CLASS_BYTES)
+		{
+			*atkPoolLink(header) = pool->m_free;
+			pool->m_free = header;
+			pool->m_numFree++;
+			kept = 1;
+		}
+		atkPoolUnlock(pool);
+		if (kept) return;
+    }
+    mlFree(header);
+}
+
+void*
+AtkWirePool::resize(void* p, size_t size)
+{
+    if (!p) return(alloc(size));
+
+    size_t capacity = getCapacity(p);
+    if (capacity >= size) return(p);
+
+    // Blocks too large for the pool are grown in place where possible.
+    AtkWirePoolHeader* header =
+		(AtkWirePoolHeader*) (((char*) p) - ATK_WIRE_POOL_HEADER_SIZE);
+    if (header->m_class < 0)
+	{
+		header = (AtkWirePoolHeader*) mlRealloc(header, ATK_WIRE_POOL_HEADER_SIZE + size);
+		header->m_capacity = size;
+		return(((char*) header) + ATK_WIRE_POOL_HEADER_SIZE);
+    }
+
+    void* block = alloc(size);
+    memcpy(block, p, capacity);
+    release(p);
+    return(block);
+}
+
+size_t
+AtkWirePool::getCapacity(void* p)
+{
+    if (!p) return(0);
+    return(((AtkWirePoolHeader*) (((char*) p) - ATK_WIRE_POOL_HEADER_SIZE))->m_capacity);
+}
+
+void
+AtkWirePool::trim()
+{
+    for (int c = 0; c < ATK_WIRE_POOL_NUM_CLASSES; c++)
+	{
+		AtkWirePoolClass* pool = &g_atkPoolClasses[c];
+		atkPoolLock(pool);
+		AtkWirePoolHeader* header = pool->m_free;
+		pool->m_free = NULL;
+		pool->m_numFree = 0;
+		atkPoolUnlock(pool);
+
+		while (header)
+		{
+			AtkWirePoolHeader* next = *atkPoolLink(header);
+			mlFree(header);
+			header = next;
+		}
+    }
+}
+
+void
+AtkWirePool::getStats(AtkWirePoolStats* stats)
+{
+    stats->m_allocs = g_atkPoolAllocs.load(std::memory_order_relaxed);
+    stats->m_reused = g_atkPoolReused.load(std::memory_order_relaxed);
+    stats->m_heapAllocs = g_atkPoolHeapAllocs.load(std::memory_order_relaxed);
+    stats->m_freeBytes = 0;
+    for (int c = 0; c < ATK_WIRE_POOL_NUM_CLASSES; c++)
+	{
+		AtkWirePoolClass* pool = &g_atkPoolClasses[c];
+		atkPoolLock(pool);
+		stats->m_freeBytes += (long long) pool->m_numFree * (ATK_WIRE_POOL_MIN_BLOCK << c);
+		atkPoolUnlock(pool);
+    }
+}
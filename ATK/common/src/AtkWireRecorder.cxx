@@ -0,0 +1,172 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireRecorder.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that records the
+ * messages crossing a wire to a log, for replay.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <errno.h>
+#include <string.h>
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWireMsg.h"
+#include "mle/AtkWireRecorder.h"
+
+/** The size of the log's stdio buffer, in bytes. */
+#define ATK_WIRE_LOG_BUFFER_SIZE 65536
+
+
+AtkWireRecorder::AtkWireRecorder(FILE* fp)
+{
+    m_fp = fp;
+    m_startTime = std::chrono::steady_clock::now();
+    m_numRecords = 0;
+    m_failed = 0;
+}
+
+AtkWireRecorder::~AtkWireRecorder()
+{
+    if (m_fp) fclose(m_fp);
+}
+
+AtkWireRecorder*
+AtkWireRecorder::open(const char* filename)
+{
+    FILE* fp = fopen(filename, "wb");
+    if (!fp)
+	{
+		printf("WIRE: Could not create wire log %s.  Errno: %d\n", filename, errno);
+		return(NULL);
+    }
+    setvbuf(fp, NULL, _IOFBF, ATK_WIRE_LOG_BUFFER_SIZE);
+
+    AtkWireLogHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.m_magic, ATK_WIRE_LOG_MAGIC, sizeof(header.m_magic));
+    header.m_version = ATK_WIRE_LOG_VERSION;
+    if (fwrite(&header, sizeof(header), 1, fp) != 1)
+	{
+		printf("WIRE: Could not write wire log %s.  Errno: %d\n", filename, errno);
+		fclose(fp);
+		return(NULL);
+    }
+
+    return(new AtkWireRecorder(fp));
+}
+
+int
+AtkWireRecorder::record(int direction, AtkWireMsg* msg,
+	const AtkWireBuffer* buffers, int numBuffers)
+{
+    // Stamp the record before waiting for the lock.
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - m_startTime).count();
+
+    AtkWireLogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.m_time = now;
+    record.m_destObj = (uint64_t) (uintptr_t) msg->m_destObj;
+    record.m_direction = (unsigned char) direction;
+    record.m_sync = msg->isSyncMsg() ? 1 : 0;
+    int nameLen = (int) strlen(msg->m_msgName);
+    if (nameLen > MAX_MSG_NAME_LEN - 1) nameLen = MAX_MSG_NAME_LEN - 1;
+    record.m_nameLength = (unsigned char) nameLen;
+    for (int i = 0; i < numBuffers; i++)
+		if (buffers[i].m_data && buffers[i].m_length > 0)
+			record.m_dataLength += buffers[i].m_length;
+
+    static const char padding[8] = { 0 };
+    int padLen = ATK_WIRE_LOG_RECORD_LENGTH(nameLen, record.m_dataLength) -
+		((int) sizeof(record) + nameLen + record.m_dataLength);
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_failed) return(-1);
+
+    int ok = (fwrite(&record, sizeof(record), 1, m_fp) == 1);
+    if (ok && nameLen > 0) ok = (fwrite(msg->m_msgName, nameLen, 1, m_fp) == 1);
+    for (int i = 0; ok && i < numBuffers; i++)
+	{
+		if (!buffers[i].m_data || buffers[i].m_length <= 0) continue;
+		ok = (fwrite(buffers[i].m_data, buffers[i].m_length, 1, m_fp) == 1);
+    }
+    if (ok && padLen > 0) ok = (fwrite(padding, padLen, 1, m_fp) == 1);
+    if (!ok)
+	{
+		// A torn record would spoil the rest of the log.
+		printf("WIRE: Could not write wire log; recording stopped.  Errno: %d\n", errno);
+		m_failed = 1;
+		return(-1);
+    }
+
+    m_numRecords++;
+    return(0);
+}
+
+int
+AtkWireRecorder::record(int direction, AtkWireMsg* msg)
+{
+    AtkWireBuffer buffer;
+    buffer.m_data = msg->m_msgData;
+    buffer.m_length = msg->getDataLength();
+    return(record(direction, msg, &buffer, 1));
+}
+
+int
+AtkWireRecorder::flush()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return((fflush(m_fp) == 0) ? 0 : -1);
+}
+
+void *
+AtkWireRecorder::operator new(size_t tSize)
+{
+	void *p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkWireRecorder::operator delete(void *p)
+{
+	mlFree(p);
+}
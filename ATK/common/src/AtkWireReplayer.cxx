@@ -0,0 +1,288 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireReplayer.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that replays a wire
+ * log to a wired object, timing how long each message takes to handle.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWire.h"
+#include "mle/AtkWired.h"
+#include "mle/AtkWireRecorder.h"
+#include "mle/AtkWireReplayer.h"
+
+
+AtkWireReplayer::AtkWireReplayer(char* log, long logLength, int mapped)
+{
+    m_log = log;
+    m_logLength = logLength;
+    m_mapped = mapped;
+    m_stats = NULL;
+    m_numStats = 0;
+    m_maxStats = 0;
+    m_numDelivered = 0;
+    m_elapsedTime = 0;
+    m_maxLag = 0;
+}
+
+AtkWireReplayer::~AtkWireReplayer()
+{
+#if defined(__linux__) || defined(__APPLE__)
+    if (m_mapped)
+		munmap(m_log, m_logLength);
+    else
+#endif
+    mlFree(m_log);
+    if (m_stats) mlFree(m_stats);
+}
+
+AtkWireReplayer*
+AtkWireReplayer::open(const char* filename)
+{
+    char* log = NULL;
+    long logLength = 0;
+    int mapped = 0;
+
+#if defined(__linux__) || defined(__APPLE__)
+    // Map the log; a private mapping lets handlers parse it in place.
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+	{
+		printf("WIRE: Could not open wire log %s.  Errno: %d\n", filename, errno);
+		return(NULL);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(AtkWireLogHeader))
+	{
+		logLength = (long) st.st_size;
+		void* addr = mmap(NULL, logLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED)
+		{
+			log = (char*) addr;
+			mapped = 1;
+		}
+    }
+    close(fd);
+#endif /* __linux__ || __APPLE__ */
+
+    if (!log)
+	{
+		FILE* fp = fopen(filename, "rb");
+		if (!fp)
+		{
+			printf("WIRE: Could not open wire log %s.  Errno: %d\n", filename, errno);
+			return(NULL);
+		}
+		fseek(fp, 0, SEEK_END);
+		logLength = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		log = (char*) mlMalloc(logLength > 0 ? logLength : 1);
+		if (logLength < 0 || fread(log, 1, logLength, fp) != (size_t) logLength)
+		{
+			printf("WIRE: Could not read wire log %s\n", filename);
+			mlFree(log);
+			fclose(fp);
+			return(NULL);
+		}
+		fclose(fp);
+    }
+
+    AtkWireReplayer* replayer = new AtkWireReplayer(log, logLength, mapped);
+    AtkWireLogHeader* header = (AtkWireLogHeader*) log;
+    if (logLength < (long) sizeof(AtkWireLogHeader) ||
+		strncmp(header->m_magic, ATK_WIRE_LOG_MAGIC, sizeof(header->m_magic)) ||
+		header->m_version != ATK_WIRE_LOG_VERSION)
+	{
+		printf("WIRE: %s is not a wire log\n", filename);
+		delete replayer;
+		return(NULL);
+    }
+    return(replayer);
+}
+
+AtkWireReplayStats*
+AtkWireReplayer::findStats(const char* msgName)
+{
+    int added;
+    int id = m_statNames.intern(msgName, &added);
+    if (!id) return(NULL);
+
+    if (added)
+	{
+		if (id > m_maxStats)
+		{
+			m_maxStats = m_maxStats ? 2 * m_maxStats : 64;
+			m_stats = (AtkWireReplayStats*) mlRealloc(m_stats,
+				m_maxStats * sizeof(AtkWireReplayStats));
+		}
+		AtkWireReplayStats* stats = &m_stats[id - 1];
+		memset(stats, 0, sizeof(AtkWireReplayStats));
+		strncpy(stats->m_msgName, msgName, MAX_MSG_NAME_LEN - 1);
+		m_numStats = id;
+    }
+    return(&m_stats[id - 1]);
+}
+
+int
+AtkWireReplayer::replay(AtkWired* wired, int speed)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    m_numDelivered = 0;
+    m_elapsedTime = 0;
+    m_maxLag = 0;
+    m_statNames.clear();
+    m_numStats = 0;
+
+    Clock::time_point start = Clock::now();
+    int64_t firstTime = -1;
+    int status = 0;
+
+    long offset = sizeof(AtkWireLogHeader);
+    while (offset < m_logLength)
+	{
+		// Check that the whole record is there before using any of it.
+		AtkWireLogRecord* record = (AtkWireLogRecord*) (m_log + offset);
+		if (m_logLength - offset < (long) sizeof(AtkWireLogRecord) ||
+			record->m_dataLength < 0 || record->m_nameLength >= MAX_MSG_NAME_LEN ||
+			m_logLength - offset < (long) ATK_WIRE_LOG_RECORD_LENGTH(
+				record->m_nameLength, record->m_dataLength))
+		{
+			printf("WIRE: Wire log is corrupt at offset %ld\n", offset);
+			status = -1;
+			break;
+		}
+		char* name = (char*) (record + 1);
+		char* data = name + record->m_nameLength;
+		offset += ATK_WIRE_LOG_RECORD_LENGTH(record->m_nameLength, record->m_dataLength);
+
+		char msgName[MAX_MSG_NAME_LEN];
+		memcpy(msgName, name, record->m_nameLength);
+		msgName[record->m_nameLength] = 0;
+		if (record->m_direction != ATK_WIRE_LOG_RECV ||
+			!strcmp(msgName, ATK_WIRE_OPTIONS_MSG_NAME) ||
+			!strcmp(msgName, ATK_WIRE_FRAMING_MSG_NAME))
+			continue;
+
+		// Keep to the recorded spacing, measured from the first message.
+		if (firstTime < 0) firstTime = record->m_time;
+		if (speed == ATK_WIRE_REPLAY_ORIGINAL)
+		{
+			Clock::time_point due = start +
+				std::chrono::nanoseconds(record->m_time - firstTime);
+			Clock::time_point now = Clock::now();
+			if (now < due) std::this_thread::sleep_until(due);
+			int64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				Clock::now() - due).count();
+			if (lag > m_maxLag) m_maxLag = lag;
+		}
+
+		// The destination was an address in the recording process, so the
+		// message goes straight to the wired object.
+		AtkWireMsg* msg = new AtkWireMsg(NULL, msgName, record->m_sync);
+		msg->setMsgDataRef(data, record->m_dataLength);
+
+		Clock::time_point before = Clock::now();
+		wired->deliverMsg(msg);
+		int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			Clock::now() - before).count();
+		delete msg;
+
+		AtkWireReplayStats* stats = findStats(msgName);
+		if (stats)
+		{
+			if (!stats->m_count || elapsed < stats->m_minTime) stats->m_minTime = elapsed;
+			if (elapsed > stats->m_maxTime) stats->m_maxTime = elapsed;
+			stats->m_totalTime += elapsed;
+			stats->m_count++;
+		}
+		m_numDelivered++;
+    }
+
+    m_elapsedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		Clock::now() - start).count();
+    return((status < 0) ? status : m_numDelivered);
+}
+
+void
+AtkWireReplayer::printStats()
+{
+    double seconds = m_elapsedTime / 1e9;
+    printf("REPLAY: %d msgs in %.3f s (%.0f msgs/s), max lag %.3f ms\n",
+		m_numDelivered, seconds, (seconds > 0) ? m_numDelivered / seconds : 0.0,
+		m_maxLag / 1e6);
+    printf("REPLAY: %-31s %8s %10s %10s %10s\n", "msg", "count", "mean us",
+		"min us", "max us");
+    for (int i = 0; i < m_numStats; i++)
+	{
+		AtkWireReplayStats* stats = &m_stats[i];
+		printf("REPLAY: %-31s %8d %10.2f %10.2f %10.2f\n", stats->m_msgName,
+			stats->m_count, stats->m_totalTime / 1e3 / stats->m_count,
+			stats->m_minTime / 1e3, stats->m_maxTime / 1e3);
+    }
+}
+
+void *
+AtkWireReplayer::operator new(size_t tSize)
+{
+	void *p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkWireReplayer::operator delete(void *p)
+{
+	mlFree(p);
+}
@@ -0,0 +1,338 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireStats.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that keeps per
+ * message counters and latency histograms for a wire.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWireStats.h"
+
+// The stats to print at exit.
+static AtkWireStats* g_atExitHead = NULL;
+static std::mutex g_atExitLock;
+static int g_atExitRegistered = 0;
+
+
+AtkWireStats::AtkWireStats()
+{
+    m_entries = NULL;
+    m_maxEntries = 0;
+    m_exitFile = NULL;
+    m_nextAtExit = NULL;
+}
+
+// Print stats to a file, appending; "-" is standard output.
+static void
+atkPrintStatsTo(AtkWireStats* stats, const char* filename)
+{
+    if (!strcmp(filename, "-"))
+	{
+		stats->print(stdout);
+		fflush(stdout);
+		return;
+    }
+
+    FILE* fp = fopen(filename, "a");
+    if (!fp)
+	{
+		printf("STATS: Could not open %s\n", filename);
+		return;
+    }
+    stats->print(fp);
+    fclose(fp);
+}
+
+void
+AtkWireStats::printAllAtExit()
+{
+    std::lock_guard<std::mutex> guard(g_atExitLock);
+    for (AtkWireStats* stats = g_atExitHead; stats; )
+	{
+		AtkWireStats* next = stats->m_nextAtExit;
+		atkPrintStatsTo(stats, stats->m_exitFile);
+		free(stats->m_exitFile);
+		stats->m_exitFile = NULL;
+		stats->m_nextAtExit = NULL;
+		stats = next;
+    }
+    g_atExitHead = NULL;
+}
+
+AtkWireStats::~AtkWireStats()
+{
+    // Print now, since the process won't find us at exit.
+    if (m_exitFile)
+	{
+		std::lock_guard<std::mutex> guard(g_atExitLock);
+		AtkWireStats** link = &g_atExitHead;
+		while (*link && *link != this) link = &(*link)->m_nextAtExit;
+		if (*link) *link = m_nextAtExit;
+		atkPrintStatsTo(this, m_exitFile);
+		free(m_exitFile);
+    }
+    if (m_entries) mlFree(m_entries);
+}
+
+void
+AtkWireStats::printAtExit(const char* filename)
+{
+    std::lock_guard<std::mutex> guard(g_atExitLock);
+    if (!g_atExitRegistered)
+	{
+		atexit(printAllAtExit);
+		g_atExitRegistered = 1;
+    }
+
+    if (m_exitFile) free(m_exitFile);
+    else
+	{
+		m_nextAtExit = g_atExitHead;
+		g_atExitHead = this;
+    }
+    m_exitFile = strdup(filename);
+}
+
+long long
+AtkWireStats::now()
+{
+    return(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+int
+AtkWireStats::getBucket(long long time)
+{
+    long long us = time / 1000;
+    int bucket = 0;
+    while (us > 0 && bucket < ATK_WIRE_STATS_BUCKETS - 1)
+	{
+		us >>= 1;
+		bucket++;
+    }
+    return(bucket);
+}
+
+AtkWireMsgStats*
+AtkWireStats::lookup(const char* msgName)
+{
+    int id = m_names.intern(msgName, NULL);
+    if (id == 0) return(NULL);
+
+    if (id > m_maxEntries)
+	{
+		int size = m_maxEntries ? 2 * m_maxEntries : 32;
+		while (size < id) size *= 2;
+		m_entries = (AtkWireMsgStats*) mlRealloc(m_entries, size * sizeof(AtkWireMsgStats));
+		memset(m_entries + m_maxEntries, 0, (size - m_maxEntries) * sizeof(AtkWireMsgStats));
+		m_maxEntries = size;
+    }
+
+    AtkWireMsgStats* entry = &m_entries[id - 1];
+    if (!entry->m_msgName[0])
+	{
+		strncpy(entry->m_msgName, msgName, MAX_MSG_NAME_LEN - 1);
+		entry->m_msgName[MAX_MSG_NAME_LEN - 1] = 0;
+    }
+    return(entry);
+}
+
+void
+AtkWireStats::recordRecv(const char* msgName, int bytes)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    AtkWireMsgStats* entry = lookup(msgName);
+    if (!entry) return;
+    entry->m_recvMsgs++;
+    entry->m_recvBytes += bytes;
+}
+
+void
+AtkWireStats::recordSend(const char* msgName, int bytes)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    AtkWireMsgStats* entry = lookup(msgName);
+    if (!entry) return;
+    entry->m_sentMsgs++;
+    entry->m_sentBytes += bytes;
+}
+
+void
+AtkWireStats::recordHandled(const char* msgName, long long waitTime, long long handlerTime)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    AtkWireMsgStats* entry = lookup(msgName);
+    if (!entry) return;
+
+    entry->m_handledMsgs++;
+    entry->m_handlerTime += handlerTime;
+    if (handlerTime > entry->m_maxHandlerTime) entry->m_maxHandlerTime = handlerTime;
+    entry->m_handlerHistogram[getBucket(handlerTime)]++;
+
+    // Messages that didn't come off the wire have no wait time.
+    if (waitTime < 0) return;
+    entry->m_waitTime += waitTime;
+    if (waitTime > entry->m_maxWaitTime) entry->m_maxWaitTime = waitTime;
+    entry->m_waitHistogram[getBucket(waitTime)]++;
+}
+
+int
+AtkWireStats::getNumEntries()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return(m_names.getCount());
+}
+
+int
+AtkWireStats::getEntry(int index, AtkWireMsgStats* stats)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (index < 0 || index >= m_names.getCount()) return(-1);
+    *stats = m_entries[index];
+    return(0);
+}
+
+void
+AtkWireStats::reset()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_names.clear();
+    if (m_entries) memset(m_entries, 0, m_maxEntries * sizeof(AtkWireMsgStats));
+}
+
+void
+AtkWireStats::addParams(AtkWireMsg* msg)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    int count = m_names.getCount();
+    msg->addParam(count);
+    for (int i = 0; i < count; i++)
+		msg->addParam(&m_entries[i], sizeof(AtkWireMsgStats));
+}
+
+int
+AtkWireStats::getParams(AtkWireMsg* msg, AtkWireMsgStats* stats, int maxEntries)
+{
+    int count;
+    if (msg->getParam(count) < 0 || count < 0) return(-1);
+    for (int i = 0; i < count; i++)
+	{
+		void* data;
+		int len;
+		int status = msg->getParam(data, len);
+		if (status < 0 || len != (int) sizeof(AtkWireMsgStats))
+		{
+			if (data) mlFree(data);
+			return(-1);
+		}
+		if (i < maxEntries) memcpy(&stats[i], data, sizeof(AtkWireMsgStats));
+		mlFree(data);
+    }
+    return(count);
+}
+
+// Estimate a percentile of a histogram, in microseconds, as the upper
+// bound of the bucket it falls in; the last bucket is bounded by the max.
+static double
+atkPercentile(const long long* histogram, long long count, double fraction,
+	long long maxTime)
+{
+    long long target = (long long) (count * fraction);
+    long long seen = 0;
+    for (int i = 0; i < ATK_WIRE_STATS_BUCKETS - 1; i++)
+	{
+		seen += histogram[i];
+		if (seen > target)
+		{
+			double bound = (double) (1LL << i);
+			return((bound < maxTime / 1e3) ? bound : maxTime / 1e3);
+		}
+    }
+    return(maxTime / 1e3);
+}
+
+void
+AtkWireStats::print(FILE* fp)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    int count = m_names.getCount();
+    fprintf(fp, "STATS: %d msg names\n", count);
+    fprintf(fp, "STATS: %-31s %8s %10s %8s %10s %8s %9s %9s %9s %9s %9s\n",
+		"msg", "recv", "recv B", "sent", "sent B", "handled", "mean us",
+		"p50 us", "p99 us", "max us", "wait p99");
+    for (int i = 0; i < count; i++)
+	{
+		AtkWireMsgStats* entry = &m_entries[i];
+		long long handled = entry->m_handledMsgs;
+		long long waited = 0;
+		for (int b = 0; b < ATK_WIRE_STATS_BUCKETS; b++) waited += entry->m_waitHistogram[b];
+		fprintf(fp, "STATS: %-31s %8lld %10lld %8lld %10lld %8lld %9.2f %9.0f %9.0f %9.2f %9.0f\n",
+			entry->m_msgName, entry->m_recvMsgs, entry->m_recvBytes,
+			entry->m_sentMsgs, entry->m_sentBytes, handled,
+			handled ? entry->m_handlerTime / 1e3 / handled : 0.0,
+			handled ? atkPercentile(entry->m_handlerHistogram, handled, 0.5,
+				entry->m_maxHandlerTime) : 0.0,
+			handled ? atkPercentile(entry->m_handlerHistogram, handled, 0.99,
+				entry->m_maxHandlerTime) : 0.0,
+			entry->m_maxHandlerTime / 1e3,
+			waited ? atkPercentile(entry->m_waitHistogram, waited, 0.99,
+				entry->m_maxWaitTime) : 0.0);
+    }
+}
+
+void *
+AtkWireStats::operator new(size_t tSize)
+{
+	void *p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkWireStats::operator delete(void *p)
+{
+	mlFree(p);
+}
@@ -0,0 +1,327 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file AtkWireWorkers.cxx
+ * @ingroup MleATK
+ *
+ * This file contains the implementation of a class that delivers
+ * messages on a pool of worker threads and sends their replies in order.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Include Magic Lantern header files.
+#include <mle/mlMalloc.h>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWireWorkers.h"
+#include "mle/AtkWire.h"
+#include "mle/AtkWired.h"
+#include "mle/AtkWireMsg.h"
+#include "mle/AtkWireBatch.h"
+
+// A message submitted to the pool.
+struct AtkWireJob
+{
+    // The wired to deliver the message to.
+    AtkWired* m_wired;
+    // The copy of the message; NULL once it has been delivered.
+    AtkWireMsg* m_msg;
+    // What the worker sent while delivering it.
+    AtkWireBatch* m_sent;
+    // The ID its replies echo.
+    unsigned int m_correlationID;
+    // Whether it has been delivered.
+    int m_done;
+    AtkWireJob* m_next;
+};
+
+// A declared affinity.
+struct AtkWireAffinity
+{
+    char* m_name;
+    int m_affinity;
+};
+
+// Whether the calling thread is a worker.
+static thread_local int g_isWorkerThread = 0;
+
+
+AtkWireWorkers::AtkWireWorkers(int numThreads)
+{
+    m_head = m_tail = m_next = NULL;
+    m_numPending = 0;
+    m_numUndelivered = 0;
+    m_stop = 0;
+
+    m_notifyFD[0] = m_notifyFD[1] = -1;
+#if defined(__linux__) || defined(__APPLE__)
+    if (pipe(m_notifyFD) < 0)
+	{
+		printf("WORKERS: Could not create notify pipe.  Errno: %d\n", errno);
+		m_notifyFD[0] = m_notifyFD[1] = -1;
+    } else
+	{
+		for (int i = 0; i < 2; i++)
+			fcntl(m_notifyFD[i], F_SETFL, fcntl(m_notifyFD[i], F_GETFL, 0) | O_NONBLOCK);
+    }
+#endif /* __linux__ || __APPLE__ */
+
+    m_numThreads = (numThreads > 0) ? numThreads : 0;
+    m_threads = m_numThreads ?
+		(std::thread**) mlMalloc(m_numThreads * sizeof(std::thread*)) : NULL;
+    for (int i = 0; i < m_numThreads; i++)
+		m_threads[i] = new std::thread(&AtkWireWorkers::workerLoop, this);
+}
+
+AtkWireWorkers::~AtkWireWorkers()
+{
+    barrier();
+
+    {
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_stop = 1;
+    }
+    m_ready.notify_all();
+    for (int i = 0; i < m_numThreads; i++)
+	{
+		m_threads[i]->join();
+		delete m_threads[i];
+    }
+    if (m_threads) mlFree(m_threads);
+
+#if defined(__linux__) || defined(__APPLE__)
+    for (int i = 0; i < 2; i++)
+		if (m_notifyFD[i] >= 0) close(m_notifyFD[i]);
+#endif /* __linux__ || __APPLE__ */
+
+    for (int i = 0; i < m_affinities.getNumSlots(); i++)
+	{
+		AtkWireAffinity* affinity = (AtkWireAffinity*) m_affinities.getValue(i);
+		if (!affinity) continue;
+		free(affinity->m_name);
+		delete affinity;
+    }
+}
+
+void
+AtkWireWorkers::setAffinity(const char* msgName, int affinity)
+{
+    unsigned int hash = atkHashString(msgName);
+    AtkWireAffinity* entry = (AtkWireAffinity*) m_affinities.find(msgName, hash);
+    if (!entry)
+	{
+		entry = new AtkWireAffinity;
+#if defined(_WINDOWS)
+		entry->m_name = _strdup(msgName);
+#else
+		entry->m_name = strdup(msgName);
+#endif
+		m_affinities.set(entry->m_name, hash, entry);
+    }
+    entry->m_affinity = affinity;
+}
+
+int
+AtkWireWorkers::getAffinity(const char* msgName)
+{
+    AtkWireAffinity* entry =
+		(AtkWireAffinity*) m_affinities.find(msgName, atkHashString(msgName));
+    return(entry ? entry->m_affinity : ATK_WIRE_AFFINITY_MAIN);
+}
+
+int
+AtkWireWorkers::submit(AtkWired* wired, AtkWireMsg* msg)
+{
+    if (!m_numThreads) return(-1);
+
+    // The message is copied, since the caller may delete it at once.
+    AtkWireMsg* copy = new AtkWireMsg(msg->m_destObj, msg->m_msgName, msg->isSyncMsg());
+    int dataLen = msg->getDataLength();
+    if (dataLen > 0) copy->setMsgData(msg->m_msgData, dataLen);
+    copy->setCorrelationID(msg->getCorrelationID());
+    copy->setRecvTime(msg->getRecvTime());
+
+    AtkWireJob* job = new AtkWireJob;
+    job->m_wired = wired;
+    job->m_msg = copy;
+    job->m_sent = new AtkWireBatch(wired->getObjID(), REPLY_MSG_NAME);
+    job->m_correlationID = msg->getCorrelationID();
+    job->m_done = 0;
+    job->m_next = NULL;
+
+    {
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (m_tail) m_tail->m_next = job;
+		else m_head = job;
+		m_tail = job;
+		if (!m_next) m_next = job;
+		m_numPending++;
+		m_numUndelivered++;
+    }
+    m_ready.notify_one();
+    return(0);
+}
+
+void
+AtkWireWorkers::workerLoop()
+{
+    g_isWorkerThread = 1;
+    for (;;)
+	{
+		// What was submitted before a stop is still delivered.
+		AtkWireJob* job;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			while (!m_stop && !m_next) m_ready.wait(lock);
+			if (!m_next) break;
+			job = m_next;
+			m_next = job->m_next;
+		}
+
+		AtkWireBatch* capture = AtkWire::setThreadCapture(job->m_sent);
+		job->m_wired->deliverMsg(job->m_msg);
+		AtkWire::setThreadCapture(capture);
+		delete job->m_msg;
+		job->m_msg = NULL;
+
+		// Only the oldest message finishing lets anything be flushed.
+		int first;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			job->m_done = 1;
+			m_numUndelivered--;
+			first = (job == m_head);
+		}
+		m_done.notify_all();
+		if (first) notify();
+    }
+}
+
+void
+AtkWireWorkers::notify()
+{
+#if defined(__linux__) || defined(__APPLE__)
+    char c = 0;
+    if (m_notifyFD[1] >= 0 && write(m_notifyFD[1], &c, 1) < 0 && errno != EAGAIN)
+		printf("WORKERS: Could not notify.  Errno: %d\n", errno);
+#endif /* __linux__ || __APPLE__ */
+}
+
+int
+AtkWireWorkers::flush()
+{
+#if defined(__linux__) || defined(__APPLE__)
+    char drain[64];
+    if (m_notifyFD[0] >= 0)
+		while (read(m_notifyFD[0], drain, sizeof(drain)) > 0) ;
+#endif /* __linux__ || __APPLE__ */
+
+    int count = 0;
+    AtkWireMsg* msg = NULL;
+    for (;;)
+	{
+		AtkWireJob* job;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			job = m_head;
+			if (!job || !job->m_done) break;
+			m_head = job->m_next;
+			if (!m_head) m_tail = NULL;
+			m_numPending--;
+		}
+
+		// Replies echo the ID of the request they answer.
+		if (!msg) msg = new AtkWireMsg();
+		AtkWire* wire = job->m_wired->getWire();
+		while (AtkWireBatch::getNext(job->m_sent->getMsg(), msg) > 0)
+		{
+			if (msg->isReplyMsg()) msg->setCorrelationID(job->m_correlationID);
+			if (wire && wire->sendMsg(msg) >= 0) count++;
+		}
+		delete job->m_sent;
+		delete job;
+    }
+    if (msg) delete msg;
+    return(count);
+}
+
+int
+AtkWireWorkers::barrier()
+{
+    // A worker waiting for itself would never finish.
+    if (g_isWorkerThread) return(0);
+
+    {
+		std::unique_lock<std::mutex> lock(m_lock);
+		while (m_numUndelivered > 0) m_done.wait(lock);
+    }
+    return(flush());
+}
+
+int
+AtkWireWorkers::getNumPending()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return(m_numPending);
+}
+
+int
+AtkWireWorkers::isWorkerThread()
+{
+    return(g_isWorkerThread);
+}
+
+void *
+AtkWireWorkers::operator new(size_t tSize)
+{
+	void *p = mlMalloc(tSize);
+	return p;
+}
+
+void
+AtkWireWorkers::operator delete(void *p)
+{
+	mlFree(p);
+}
@@ -42,20 +42,85 @@
 // COPYRIGHT_END
 
 // Include system header files.
+#include <stdint.h>
 #include <string.h>
+#include <mutex>
 
 // Include Magic Lantern header files.
 #include <mle/mlAssert.h>
 #include <mle/mlDebug.h>
+#include <mle/mlMalloc.h>
 
 // Include Authoring Toolkit header files.
 #include "mle/AtkWired.h"
 #include "mle/AtkWire.h"
 #include "mle/AtkWireMsg.h"
+#include "mle/AtkWireBatch.h"
 #include "mle/AtkWireFunc.h"
 
 static AtkWired* g_firstWired = 0;
 
+// The initial number of slots for wireds.
+#define ATK_WIRED_INITIAL_SLOTS 16
+
+// A slot for a registered wired; free slots are linked by m_nextFree.
+struct AtkWiredSlot
+{
+    AtkWired* m_wired;
+    unsigned int m_generation;
+    int m_nextFree;
+};
+
+// The slots, with slot 0 unused so that no handle is 0.  Messages are
+// delivered on reader and worker threads too, so the slots are locked.
+static std::mutex g_wiredLock;
+static AtkWiredSlot* g_wiredSlots = NULL;
+static int g_numWiredSlots = 0;
+static int g_maxWiredSlots = 0;
+static int g_freeWiredSlot = -1;
+
+// Give a wired a slot and return its handle; 0 if there is no slot left.
+static unsigned int
+atkRegisterWired(AtkWired* wired)
+{
+    std::lock_guard<std::mutex> guard(g_wiredLock);
+    int index = g_freeWiredSlot;
+    if (index > 0)
+		g_freeWiredSlot = g_wiredSlots[index].m_nextFree;
+    else
+	{
+		if (!g_numWiredSlots) g_numWiredSlots = 1;
+		if (g_numWiredSlots > (int) ATK_WIRED_HANDLE_INDEX_MASK) return(0);
+		if (g_numWiredSlots == g_maxWiredSlots || !g_wiredSlots)
+		{
+			int size = g_maxWiredSlots ? 2 * g_maxWiredSlots : ATK_WIRED_INITIAL_SLOTS;
+			g_wiredSlots = (AtkWiredSlot*) mlRealloc(g_wiredSlots, size * sizeof(AtkWiredSlot));
+			g_maxWiredSlots = size;
+		}
+		index = g_numWiredSlots++;
+		g_wiredSlots[index].m_generation = 1;
+    }
+
+    g_wiredSlots[index].m_wired = wired;
+    g_wiredSlots[index].m_nextFree = -1;
+    return((g_wiredSlots[index].m_generation << ATK_WIRED_HANDLE_INDEX_BITS) | index);
+}
+
+// Free a wired's slot, making its handle stale.
+static void
+atkReleaseWired(unsigned int handle)
+{
+    if (!handle) return;
+    std::lock_guard<std::mutex> guard(g_wiredLock);
+    int index = (int) (handle & ATK_WIRED_HANDLE_INDEX_MASK);
+    AtkWiredSlot* slot = &g_wiredSlots[index];
+    slot->m_wired = NULL;
+    slot->m_generation = (slot->m_generation + 1) & (0xFFFFFFFFu >> ATK_WIRED_HANDLE_INDEX_BITS);
+    if (!slot->m_generation) slot->m_generation = 1;
+    slot->m_nextFree = g_freeWiredSlot;
+    g_freeWiredSlot = index;
+}
+
 AtkWired::AtkWired(const char* name, AtkWire* wire, void* objID)
 {
     this->m_wire = wire;
@@ -69,12 +134,46 @@ AtkWired::AtkWired(const char* name, AtkWire* wire, void* objID)
     m_userData2 = m_userData = 0;
     m_parentData = 0;
     m_windowData = 0;
+    m_missingGeneration = AtkWireFunc::getGeneration();
+    m_handle = atkRegisterWired(this);
+    if (!m_handle) printf("WIRED (%s): Could not register - too many wireds\n", m_name);
     g_firstWired = this;
 }
 
 AtkWired::~AtkWired()
 {
+    atkReleaseWired(m_handle);
+    if (g_firstWired == this) g_firstWired = 0;
     if (m_wire) delete m_wire;
+
+    for (int i = 0; i < m_createdWireFuncs.getLength(); i++)
+		delete m_createdWireFuncs[i];
+    clearMissing();
+    mlFree(m_name); // Allocated in strdup.
+}
+
+void
+AtkWired::clearMissing()
+{
+    // The missing names were allocated in strdup.
+    for (int i = 0; i < m_missingWireFuncs.getNumSlots(); i++)
+		if (m_missingWireFuncs.getValue(i)) mlFree(m_missingWireFuncs.getValue(i));
+    for (int i = 0; i < m_missingRecvWireFuncs.getNumSlots(); i++)
+		if (m_missingRecvWireFuncs.getValue(i)) mlFree(m_missingRecvWireFuncs.getValue(i));
+    m_missingWireFuncs.clear();
+    m_missingRecvWireFuncs.clear();
+}
+
+AtkWired*
+AtkWired::lookup(unsigned int handle)
+{
+    int index = (int) (handle & ATK_WIRED_HANDLE_INDEX_MASK);
+    unsigned int generation = handle >> ATK_WIRED_HANDLE_INDEX_BITS;
+
+    std::lock_guard<std::mutex> guard(g_wiredLock);
+    if (!index || index >= g_numWiredSlots) return(NULL);
+    if (g_wiredSlots[index].m_generation != generation) return(NULL);
+    return(g_wiredSlots[index].m_wired);
 }
 
 AtkWireMsg*
@@ -87,24 +186,117 @@ AtkWired::recvAndDeliverMsg()
     // Error - recvMsg failed.
     if (!msg) return(0);
 
+    return(routeMsg(msg));
+}
+
+int
+AtkWired::deliverPendingMsgs(int maxMsgs)
+{
+    // With a reader thread on the wire this only drains its queue.
+    int count = 0;
+    while (m_wire && (maxMsgs <= 0 || count < maxMsgs) && m_wire->getNumMsgs() > 0)
+	{
+		AtkWireMsg* msg = m_wire->recvMsg();
+		if (!msg) break;
+
+		routeMsg(msg);
+		count++;
+    }
+
+    // Write what was held back while the other side was behind.
+    if (m_wire && m_wire->hasPendingOutput()) m_wire->flush(0);
+    return(count);
+}
+
+AtkWireMsg*
+AtkWired::routeMsg(AtkWireMsg* msg)
+{
     //
-    AtkWired* w = (AtkWired*) msg->m_destObj;
+    unsigned int handle = msg->getDestHandle();
 
 	MLE_DEBUG_CAT("ATK",
-		printf("WIRED (%s): delivering %s msg to %d obj\n", m_name,
-		   msg->m_msgName ? msg->m_msgName : "UNKNOWN", w);
+		printf("WIRED (%s): delivering %s msg to %x obj\n", m_name,
+		   msg->m_msgName ? msg->m_msgName : "UNKNOWN", handle);
 	);
 
     // If no id - deliver to itself - otherwise deliver to.
-    if (!w) return(deliverMsg(msg));
+    if (!handle) return(deliverMsg(msg));
+    AtkWired* w = lookup(handle);
+    if (!w)
+	{
+		printf("WIRED (%s): Dropping %s msg for stale object %x\n", m_name, msg->m_msgName, handle);
+
+		// The sender is waiting on a sync msg, so answer it anyway.
+		if (msg->isSyncMsg() && m_wire)
+		{
+			AtkWireMsg reply(NULL, REPLY_MSG_NAME);
+			reply.setCorrelationID(msg->getCorrelationID());
+			m_wire->sendMsg(&reply);
+		}
+
+		// Nothing else will see the msg.
+		delete msg;
+		return(0);
+    }
     return(w->deliverMsg(msg));
+}
 
+int
+AtkWired::deliverBatch(AtkWireMsg* batch)
+{
+    // The replies to the members make up the reply to the batch. Whether
+    // a member waits is part of the batch's payload, so it is what decides
+    // whether the batch is answered.
+    AtkWire* wire = m_wire;
+    AtkWireBatch* replies = NULL;
+    AtkWireBatch* outerReplies = NULL;
+
+    // Each member borrows its payload from the batch.
+    AtkWireMsg* msg = new AtkWireMsg();
+    int count = 0;
+    int status;
+    while ((status = AtkWireBatch::getNext(batch, msg)) > 0)
+	{
+		int sync = msg->isSyncMsg();
+		if (sync && !replies && wire)
+		{
+			replies = new AtkWireBatch(m_objID, REPLY_MSG_NAME);
+			outerReplies = wire->setReplyBatch(replies);
+		}
+		int numReplies = replies ? replies->getNumMsgs() : 0;
+		deliverMsg(msg);
+
+		// A member that wasn't answered gets an empty reply, so that the
+		// replies line up with the members that wait for them.
+		if (replies && sync && replies->getNumMsgs() == numReplies)
+			replies->add(REPLY_MSG_NAME, NULL, 0);
+		count++;
+    }
+    delete msg;
 
+    if (status < 0)
+		printf("WIRED (%s): Error in deliverBatch - bad member after %d msgs\n", m_name, count);
+
+    if (replies)
+	{
+		wire->setReplyBatch(outerReplies);
+		replies->getMsg()->setCorrelationID(batch->getCorrelationID());
+		wire->sendMsg(replies->getMsg());
+		delete replies;
+    }
+    return((status < 0) ? -1 : count);
 }
 
 AtkWireMsg*
 AtkWired::deliverMsg(AtkWireMsg* msg)
 {
+    // A batch is taken apart and its members delivered one by one.
+    if (!strcmp(msg->m_msgName, ATK_WIRE_BATCH_MSG_NAME))
+	{
+		deliverBatch(msg);
+		return(0);
+    }
+
 	// XXX - Until Player is fixed.
 	if (!strcmp(m_name, "Player"))
 	{
@@ -116,7 +308,7 @@ AtkWired::deliverMsg(AtkWireMsg* msg)
 			if (ret < 0) {
 				printf("WIRED (%s): Error in deliverMsg - could not get ID param\n", m_name);
 			}
-			m_objID = (void*) id;
+			m_objID = (void*) (uintptr_t) (unsigned int) id;
 			return(0);
 		} 
 
@@ -145,8 +337,8 @@ AtkWired::getFD()
 void
 AtkWired::sendID()
 {
-    void* test = this;
-    m_wire->sendMsg(m_objID, "ID", &test, sizeof(AtkWired*));
+    unsigned int handle = m_handle;
+    m_wire->sendMsg(m_objID, "ID", &handle, sizeof(handle));
 }
 
 int 
@@ -162,8 +354,32 @@ AtkWired::find(const char* name, int recv)
     AtkWireFunc* wf = findInArray(name, recv);
     if (wf) return(wf);
 
-    // Next go to wire funcs and see if it is there.
-    wf = AtkWireFunc::find(name, recv);
+    // Don't look again for a name that has no wire func; looking means
+    // trying to load a DSO for it.  Anything registered since the names
+    // were missed may be one of them, so then they are all forgotten.
+    unsigned int generation = AtkWireFunc::getGeneration();
+    if (generation != m_missingGeneration)
+	{
+		clearMissing();
+		m_missingGeneration = generation;
+    }
+    AtkWireFuncTable& missing = (recv) ? m_missingRecvWireFuncs : m_missingWireFuncs;
+    unsigned int hash = atkHashString(name);
+    if (missing.find(name, hash)) return(NULL);
+
+    // Next go to wire funcs and make our own instance.
+    wf = AtkWireFunc::create(name, recv);
+    if (!wf)
+	{
+#if defined(_WINDOWS)
+		char* copy = _strdup(name);
+#else
+		char* copy = strdup(name);
+#endif
+		missing.set(copy, hash, copy);
+		return(NULL);
+    }
+    m_createdWireFuncs.add(wf);
     if (recv)
 	{
 		addToRecvArray(wf);
@@ -184,17 +400,8 @@ AtkWireFunc*
 AtkWired::findInArray(const char* name, int recv)
 {
     MLE_ASSERT(name);
-    int len = (recv) ? m_recvWireFuncs.getLength() : m_wireFuncs.getLength();
-    for (int i=0; i<len; i++)
-	{
-       AtkWireFunc* wf = (recv) ? m_recvWireFuncs[i]: m_wireFuncs[i];
-//printf("WF name: %s\n", wf->getName());
-       if (!strcmp(wf->getName(), name))
-	   {
-		return(wf);
-       }
-    }
-    return(NULL);
+    AtkWireFuncTable& table = (recv) ? m_recvWireFuncTable : m_wireFuncTable;
+    return((AtkWireFunc*) table.find(name, atkHashString(name)));
 }
 
 void
@@ -204,6 +411,7 @@ AtkWired::addToArray(AtkWireFunc* wf)
 //printf("Wired:  Adding %s to wirefuncs array\n", wf->getName());
 	MLE_ASSERT(wf->getName());
     m_wireFuncs.add(wf);
+    m_wireFuncTable.set(wf->getName(), atkHashString(wf->getName()), wf);
 }
 
 void
@@ -213,6 +421,7 @@ AtkWired::addToRecvArray(AtkWireFunc* wf)
 //printf("Wired:  Adding %s to recvwirefuncs array\n", wf->getName());
 	MLE_ASSERT(wf->getName());
     m_recvWireFuncs.add(wf);
+    m_recvWireFuncTable.set(wf->getName(), atkHashString(wf->getName()), wf);
 }
 
 void
@@ -46,12 +46,15 @@
 
 // Declare classes.
 class AtkWire;
+class AtkWireWorkers;
+class MlePageCursor;
 
 class MleDwpGroup;
 class MleDwpScene;
 class MleDwpActor;
 class MleDwpSet;
 class MleDwpMediaRef;
+class MleDwpItem;
 
 class MleActor;
 class MleGroup;
@@ -84,6 +87,7 @@ class MlTransform;
 // Include Authoring Toolkit header files.
 #include "mle/AtkBasicArray.h"
 #include "mle/AtkWired.h"
+#include "mle/AtkWireReplayer.h"
 
 
 typedef struct 
@@ -111,6 +115,30 @@ class MLE_ATK_API MlePlayer : public AtkWired
     // Delivering messages.
     virtual AtkWireMsg* deliverMsg(AtkWireMsg* msg);
 
+    // Delivering the messages that have arrived, handing queries among
+    // them to the query workers; it waits for the queries and sends their
+    // replies before returning.
+    virtual int deliverPendingMsgs(int maxMsgs = 0);
+
+    virtual AtkWireMsg* routeMsg(AtkWireMsg* msg);
+
+    // Replaying a wire log, recorded by setting MLE_ATK_RECORD, and
+    // printing how long each message took.  Replies go nowhere.
+    virtual int replay(const char* filename, int speed = ATK_WIRE_REPLAY_ORIGINAL);
+
+    // Handling the queries that only read the player's state, such as
+    // GetActorPropertyNames and GetFunctions, on numThreads workers; 0
+    // handles everything on the main thread.  Queries go to the workers
+    // only while deliverPendingMsgs() drains the wire, so that nothing
+    // else on the main thread runs while they read.  Other messages wait
+    // for the queries before them, and replies go out in the order the
+    // messages came in.  MLE_ATK_QUERY_THREADS sets this for a created
+    // player.
+    virtual void setNumQueryThreads(int numThreads);
+
+    // The workers queries are handled on; NULL if there are none.
+    AtkWireWorkers* getQueryWorkers() { return m_queryWorkers; }
+
     /**************************************************************************
     *  Interface to player object - Recv
     **************************************************************************/
@@ -136,6 +164,14 @@ class MLE_ATK_API MlePlayer : public AtkWired
     virtual void recvGetActorPropertyNames(const char *actorName,
 		const char *propDataSet);
 
+    // Paged replies list names a page at a time.  A request passes 0 as
+    // the token for the first page, and the token the reply returned for
+    // each page after; the last page returns 0.  A token is good for the
+    // next page only, and a stale one, or a name too long for a page,
+    // gets an empty reply.
+    virtual void recvGetActorPropertyNamesPage(const char *actorName,
+		const char *propDataSet, int token);
+
     virtual void recvGetActorProperty(const char* actorClass, 
 		const char* actorName, 
 		const char* propName);
@@ -159,6 +195,9 @@ class MLE_ATK_API MlePlayer : public AtkWired
     // Finding objects.
     virtual void recvFind(MleDwpType t, const char* name, int findAll);
 
+    // Finding actors a page at a time; an empty name finds them all.
+    virtual void recvFindPage(const char* name, int token);
+
     // Picking.
     virtual void recvPick(char* setName, int x, int y);
 
@@ -222,6 +261,13 @@ class MLE_ATK_API MlePlayer : public AtkWired
 
     virtual void recvEndStats();
 
+    // Per message counters, kept by the wire; starting them resets them.
+    virtual void recvStartMsgStats();
+
+    virtual void recvEndMsgStats();
+
+    virtual int recvGetMsgStats();
+
     // Register for actor editor property change updates.
     virtual void recvRegisterProperty(char* actorName, char *propName);
 
@@ -304,6 +350,8 @@ class MLE_ATK_API MlePlayer : public AtkWired
     // Getting a set from x,y.
     virtual void recvGetSets(int x, int y);
 
+    virtual void recvGetSetsPage(int x, int y, int token);
+
     // Reparenting a window.
 #if defined(__linux__) || defined(__APPLE__)
 #ifdef Q_OS_UNIX
@@ -366,6 +414,12 @@ class MLE_ATK_API MlePlayer : public AtkWired
     // Getting a set.
     virtual MleDwpSet* sendGetWorkprintSet(const char* setName);
 
+    // Getting several workprint items in one round trip; msgName is one of
+    // "GetGroup", "GetScene", "GetSet" or "GetMediaRef". Returns the number
+    // of items read; items that could not be read are left NULL.
+    virtual int sendGetWorkprintItems(const char* msgName, const char** ids,
+		int numIDs, MleDwpItem** items);
+
     // Sending title stats.
     virtual int sendStats(int time);
 
@@ -478,6 +532,9 @@ class MLE_ATK_API MlePlayer : public AtkWired
 
   protected:
 
+    // Handling a delivered message.
+    virtual AtkWireMsg* dispatchMsg(AtkWireMsg* msg);
+
     // Placement mode values.
     // XXX - how can we share this enum with playerMgr?
     enum MlePlacementState { ON_BACKGROUND, FLOATING };
@@ -512,6 +569,30 @@ class MLE_ATK_API MlePlayer : public AtkWired
 
     MlePropArray m_propArray;
 
+    // The message manip and property change notifications are built in;
+    // it is reset for each one so its buffer is reused.
+    AtkWireMsg* m_notifyMsg;
+
+    // The workers read-only queries are handled on; NULL if there are none.
+    AtkWireWorkers* m_queryWorkers;
+
+    // Set while deliverPendingMsgs() is draining the wire.
+    int m_draining;
+
+    // The actor and set listings being paged through, and the last page
+    // token handed out.
+    MlePageCursor* m_findCursor;
+    MlePageCursor* m_setsCursor;
+    int m_lastPageToken;
+
+    // Add the next page of a listing of a registry's keys, or of the
+    // names of its sets, to a paged reply.  Returns the number of names
+    // added, or -1 if the token isn't the one the last page handed out,
+    // the listing's place in the registry is gone, or a name doesn't fit
+    // on a page.
+    int fillPage(MlePageCursor* cursor, MleDwpStrKeyDict* registry,
+		int setNames, int token, AtkWireMsg* reply);
+
     int getPropInfo(MleActor *actor, const char *property, void **data,
 		    int &length) const;
 
@@ -0,0 +1,415 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file atkbench.cxx
+ * @ingroup MleATK
+ *
+ * This file contains a microbenchmark suite for the ATK wire layer. Each
+ * result is written as one line of JSON so that runs can be compared
+ * across releases.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWire.h"
+#include "mle/AtkWired.h"
+#include "mle/AtkWireFunc.h"
+#include "mle/AtkWireMsg.h"
+
+// The message names the benchmarks use.
+#define BENCH_MSG_NAME "Bench"
+#define BENCH_PING_NAME "Ping"
+#define BENCH_QUIT_NAME "Quit"
+
+// The payload sizes the throughput benchmark is run with.
+static const int g_payloadSizes[] = { 0, 16, 64, 256, 1024, 4096, 16384, 65536 };
+
+// The registry sizes the lookup benchmark is run with.
+static const int g_registrySizes[] = { 1, 10, 100, 1000 };
+
+// Where results go, and a divisor used to shorten every run.
+static FILE* g_out = NULL;
+static int g_scale = 1;
+
+
+/**
+ * A receive wire func that does nothing; it is only used to
+ * fill the registry of a wired object.
+ */
+class BenchWireFunc final : public AtkWireFunc
+{
+  public:
+
+    BenchWireFunc(const char* name) { m_name = strdup(name); }
+
+    ~BenchWireFunc() { free(m_name); }
+};
+
+
+static double
+elapsedSeconds(std::chrono::steady_clock::time_point start)
+{
+    return(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+/**
+ * Create two wires connected to each other by a pair of sockets.
+ *
+ * @return Upon success, <b>0</b> will be returned. Otherwise a
+ * negative value will be returned.
+ */
+static int
+connectWires(AtkWire** client, AtkWire** server)
+{
+    int toServer[2], toClient[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, toServer) < 0)
+	{
+		perror("atkbench: socketpair");
+		return(-1);
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, toClient) < 0)
+	{
+		perror("atkbench: socketpair");
+		close(toServer[0]);
+		close(toServer[1]);
+		return(-1);
+    }
+    *client = new AtkWire(toClient[0], toServer[0]);
+    *server = new AtkWire(toServer[1], toClient[1]);
+    return(0);
+}
+
+/**
+ * Measure how many messages per second go from one wire to another
+ * with sendMsg() and recvMsg(), for each payload size.
+ */
+static int
+benchThroughput()
+{
+    int maxSize = g_payloadSizes[sizeof(g_payloadSizes) / sizeof(int) - 1];
+    char* payload = (char*) malloc(maxSize);
+    for (int i = 0; i < maxSize; i++) payload[i] = (char) (i * 13);
+
+    for (unsigned int s = 0; s < sizeof(g_payloadSizes) / sizeof(int); s++)
+	{
+		AtkWire* client;
+		AtkWire* server;
+		if (connectWires(&client, &server) < 0)
+		{
+			free(payload);
+			return(-1);
+		}
+
+		// Move about 256MB per size, within reason.
+		int size = g_payloadSizes[s];
+		long count = (256L << 20) / (size + AtkWireMsg::getFrameHeaderLength());
+		count = std::min(std::max(count, 2000L), 500000L) / g_scale;
+
+		int failed = 0;
+		std::thread sender([&]() {
+			for (long i = 0; i < count; i++)
+				if (client->sendMsg(NULL, BENCH_MSG_NAME, payload, size) < 0)
+				{
+					failed = 1;
+					break;
+				}
+		});
+
+		long received = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (; received < count; received++)
+		{
+			AtkWireMsg* msg = server->recvMsg();
+			if (!msg) break;
+			delete msg;
+		}
+		double seconds = elapsedSeconds(start);
+		sender.join();
+
+		if (failed || received != count)
+			fprintf(stderr, "atkbench: throughput run for %d bytes lost messages\n", size);
+		fprintf(g_out, "{\"bench\": \"throughput\", \"protocol\": %d, \"payload\": %d, "
+			"\"msgs\": %ld, \"seconds\": %.6f, \"msgs_per_sec\": %.1f, \"mb_per_sec\": %.2f}\n",
+			ATK_WIRE_PROTOCOL_VERSION, size, received, seconds, received / seconds,
+			(double) received * size / seconds / 1e6);
+
+		delete client;
+		delete server;
+    }
+
+    free(payload);
+    return(0);
+}
+
+/**
+ * Measure the round trip latency of sendSyncMsg() against a peer that
+ * replies as soon as it has the message, and report its percentiles.
+ */
+static int
+benchLatency()
+{
+    AtkWire* client;
+    AtkWire* server;
+    if (connectWires(&client, &server) < 0) return(-1);
+
+    std::thread replier([server]() {
+		AtkWireMsg* msg;
+		while ((msg = server->recvMsg()) != NULL)
+		{
+			if (!strcmp(msg->m_msgName, BENCH_QUIT_NAME))
+			{
+				delete msg;
+				break;
+			}
+			int value = 0;
+			msg->getParam(value);
+			server->sendMsg(NULL, REPLY_MSG_NAME, &value, sizeof(int));
+			delete msg;
+		}
+    });
+
+    AtkWired wired("atkbench", client, NULL);
+    int count = 100000 / g_scale, wrong = 0;
+    std::vector<double> samples;
+    samples.reserve(count);
+
+    // Warm up the connection before timing anything.
+    for (int i = 0; i < 1000 / g_scale; i++)
+		delete client->sendSyncMsg(&wired, NULL, BENCH_PING_NAME, &i, sizeof(int));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+	{
+		auto sent = std::chrono::steady_clock::now();
+		AtkWireMsg* reply = client->sendSyncMsg(&wired, NULL, BENCH_PING_NAME, &i, sizeof(int));
+		samples.push_back(std::chrono::duration<double, std::micro>(
+			std::chrono::steady_clock::now() - sent).count());
+		int value = -1;
+		if (!reply || reply->getParam(value) < 0 || value != i) wrong++;
+		delete reply;
+    }
+    double seconds = elapsedSeconds(start);
+
+    client->sendMsg(NULL, BENCH_QUIT_NAME);
+    replier.join();
+    wired.setWire(NULL);
+    delete client;
+    delete server;
+
+    if (wrong) fprintf(stderr, "atkbench: %d of %d replies were wrong\n", wrong, count);
+    std::sort(samples.begin(), samples.end());
+    int n = (int) samples.size();
+    fprintf(g_out, "{\"bench\": \"sync_latency\", \"protocol\": %d, \"msgs\": %d, "
+		"\"seconds\": %.6f, \"mean_us\": %.2f, \"p50_us\": %.2f, \"p90_us\": %.2f, "
+		"\"p99_us\": %.2f, \"p999_us\": %.2f, \"max_us\": %.2f}\n",
+		ATK_WIRE_PROTOCOL_VERSION, n, seconds, seconds * 1e6 / n,
+		samples[n / 2], samples[n * 90 / 100], samples[n * 99 / 100],
+		samples[n * 999 / 1000], samples[n - 1]);
+    return(0);
+}
+
+/**
+ * Measure how fast a typical message can be built with addParam() and
+ * taken apart again with getParam().
+ */
+static int
+benchParams()
+{
+    static const float position[3] = { 1.0f, 2.0f, 3.0f };
+    char blob[64];
+    memset(blob, 7, sizeof(blob));
+
+    long count = 2000000L / g_scale;
+    long bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; i++)
+	{
+		AtkWireMsg msg(NULL, BENCH_MSG_NAME);
+		msg.addParam((int) i);
+		msg.addParam("actor.position");
+		msg.addParam(position);
+		msg.addParam(blob, sizeof(blob));
+		bytes += msg.getDataLength();
+    }
+    double encodeSeconds = elapsedSeconds(start);
+
+    AtkWireMsg msg(NULL, BENCH_MSG_NAME);
+    msg.addParam(1);
+    msg.addParam("actor.position");
+    msg.addParam(position);
+    msg.addParam(blob, sizeof(blob));
+
+    int errors = 0;
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; i++)
+	{
+		int value;
+		char name[MAX_MSG_NAME_LEN];
+		float f[3];
+		msg.resetParam();
+		if (msg.getParam(value) < 0) errors++;
+		if (msg.getParam(name) < 0) errors++;
+		if (msg.getParam(f) < 0) errors++;
+		if (msg.getParam((void*) blob) < 0) errors++;
+    }
+    double decodeSeconds = elapsedSeconds(start);
+
+    if (errors) fprintf(stderr, "atkbench: %d getParam() calls failed\n", errors);
+    fprintf(g_out, "{\"bench\": \"params\", \"protocol\": %d, \"msgs\": %ld, \"params_per_msg\": 4, "
+		"\"payload\": %ld, \"encode_msgs_per_sec\": %.1f, \"decode_msgs_per_sec\": %.1f}\n",
+		ATK_WIRE_PROTOCOL_VERSION, count, bytes / count,
+		count / encodeSeconds, count / decodeSeconds);
+    return(0);
+}
+
+/**
+ * Measure the cost of AtkWired::findRecv() as the number of registered
+ * receive wire funcs grows.
+ */
+static int
+benchLookup()
+{
+    for (unsigned int s = 0; s < sizeof(g_registrySizes) / sizeof(int); s++)
+	{
+		int size = g_registrySizes[s];
+		AtkWired wired("atkbench", NULL, NULL);
+		std::vector<BenchWireFunc*> funcs;
+		char name[MAX_MSG_NAME_LEN];
+		for (int i = 0; i < size; i++)
+		{
+			snprintf(name, sizeof(name), "BenchFunc%d", i);
+			funcs.push_back(new BenchWireFunc(name));
+			wired.addToRecvArray(funcs.back());
+		}
+
+		// Look up every registered name in turn.
+		long count = 4000000L / g_scale, misses = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (long i = 0; i < count; i++)
+			if (!wired.findRecv(funcs[i % size]->getName())) misses++;
+		double seconds = elapsedSeconds(start);
+
+		if (misses) fprintf(stderr, "atkbench: %ld lookups missed\n", misses);
+		fprintf(g_out, "{\"bench\": \"find_recv\", \"protocol\": %d, \"registry\": %d, "
+			"\"lookups\": %ld, \"ns_per_lookup\": %.2f}\n",
+			ATK_WIRE_PROTOCOL_VERSION, size, count, seconds * 1e9 / count);
+
+		for (int i = 0; i < size; i++) delete funcs[i];
+    }
+    return(0);
+}
+
+static void
+usage(const char* program)
+{
+    fprintf(stderr, "usage: %s [-o file] [-s scale] [throughput|latency|params|lookup ...]\n", program);
+    fprintf(stderr, "  -o file   append the results to file instead of standard output\n");
+    fprintf(stderr, "  -s scale  divide the length of every run by scale\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+    g_out = stdout;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:s:h")) != -1)
+	{
+		switch (opt)
+		{
+		  case 'o':
+			if ((g_out = fopen(optarg, "a")) == NULL)
+			{
+				perror(optarg);
+				return(1);
+			}
+			break;
+		  case 's':
+			if ((g_scale = atoi(optarg)) < 1) g_scale = 1;
+			break;
+		  default:
+			usage(argv[0]);
+			return(opt == 'h' ? 0 : 1);
+		}
+    }
+
+    struct {
+		const char* name;
+		int (*run)();
+    } benches[] = {
+		{ "throughput", benchThroughput },
+		{ "latency", benchLatency },
+		{ "params", benchParams },
+		{ "lookup", benchLookup }
+    };
+    int numBenches = sizeof(benches) / sizeof(benches[0]);
+
+    // With no names given, every benchmark is run.
+    int status = 0;
+    for (int i = 0; i < numBenches; i++)
+	{
+		int selected = (optind == argc);
+		for (int j = optind; j < argc; j++)
+			if (!strcmp(argv[j], benches[i].name)) selected = 1;
+		if (selected && benches[i].run() < 0) status = 1;
+		fflush(g_out);
+    }
+
+    for (int j = optind; j < argc; j++)
+	{
+		int known = 0;
+		for (int i = 0; i < numBenches; i++)
+			if (!strcmp(argv[j], benches[i].name)) known = 1;
+		if (!known)
+		{
+			fprintf(stderr, "atkbench: unknown benchmark %s\n", argv[j]);
+			status = 1;
+		}
+    }
+
+    if (g_out != stdout) fclose(g_out);
+    return(status);
+}
@@ -0,0 +1,633 @@
+/** @defgroup MleATK Magic Lantern Authoring Toolkit */
+
+/**
+ * @file atktest.cxx
+ * @ingroup MleATK
+ *
+ * This file contains behavior tests for the ATK wire layer and the
+ * player's paged replies. Each test runs over a pair of sockets and
+ * prints PASS or FAIL; the exit status is non-zero if any fails.
+ */
+
+// COPYRIGHT_BEGIN
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015-2025 Wizzer Works
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//  For information concerning this source code, contact Mark S. Millard,
+//  of Wizzer Works at msm@wizzerworks.com.
+//
+//  More information concerning Wizzer Works may be found at
+//
+//      http://www.wizzerworks.com
+//
+// COPYRIGHT_END
+
+// Include system header files.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <set>
+#include <string>
+#include <thread>
+
+// Include Authoring Toolkit header files.
+#include "mle/AtkWire.h"
+#include "mle/AtkWired.h"
+#include "mle/AtkWireMsg.h"
+#include "mle/AtkMsgSchema.h"
+#include "mle/MlePlayer.h"
+
+// Include Magic Lantern header files.
+#include "mle/DwpStrKeyDict.h"
+#include "mle/MleActor.h"
+
+// The layouts of the paged find request and its reply, as the tools
+// see them.
+ATK_MSG_SCHEMA(TestFindPageMsg, "FindPage", const char*, int);
+ATK_MSG_SCHEMA(TestPageReplyMsg, REPLY_MSG_NAME, int, int);
+ATK_MSG_SCHEMA(TestPageEntryMsg, REPLY_MSG_NAME, AtkMsgBlob);
+
+// Fail the running test, saying where, if a condition doesn't hold.
+#define TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "atktest: %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			return(-1); \
+		} \
+	} while (0)
+
+
+/**
+ * Create two wires connected to each other by a pair of sockets.
+ *
+ * @return Upon success, <b>0</b> will be returned. Otherwise a
+ * negative value will be returned.
+ */
+static int
+connectWires(AtkWire** client, AtkWire** server)
+{
+    int toServer[2], toClient[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, toServer) < 0)
+	{
+		perror("atktest: socketpair");
+		return(-1);
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, toClient) < 0)
+	{
+		perror("atktest: socketpair");
+		close(toServer[0]);
+		close(toServer[1]);
+		return(-1);
+    }
+    *client = new AtkWire(toClient[0], toServer[0]);
+    *server = new AtkWire(toServer[1], toClient[1]);
+    return(0);
+}
+
+/**
+ * Make one request of the server and answer it, so that each side has
+ * told the other what it can do.
+ *
+ * @return Upon success, <b>0</b> will be returned. Otherwise a
+ * negative value will be returned.
+ */
+static int
+negotiate(AtkWire* client, AtkWire* server)
+{
+    unsigned int id = client->sendRequest(NULL, "Hello", (void*) NULL, 0);
+    TEST_CHECK(id != 0);
+    AtkWireMsg* msg = server->recvMsg();
+    TEST_CHECK(msg && !strcmp(msg->m_msgName, "Hello"));
+    delete msg;
+    TEST_CHECK(server->sendMsg(NULL, REPLY_MSG_NAME, (void*) NULL, 0) >= 0);
+    msg = client->waitForReply(NULL, id);
+    TEST_CHECK(msg && msg->isReplyMsg());
+    delete msg;
+    return(0);
+}
+
+/**
+ * Send a message through the original and the compact headers, and
+ * read a frame laid out as the original code wrote it.
+ */
+static int
+testHeaders()
+{
+    for (int compact = 0; compact < 2; compact++)
+	{
+		AtkWire* client;
+		AtkWire* server;
+		if (connectWires(&client, &server) < 0) return(-1);
+		client->setCompactHeaders(compact);
+		server->setCompactHeaders(compact);
+		TEST_CHECK(negotiate(client, server) == 0);
+
+		// A long name, a destination handle and the sync flag all survive.
+		// Compact headers are switched to by the first of these.
+		const char* name = "ABCDEFGHIJKLMNOPQRSTUVWXYZ01234";
+		for (int i = 0; i < 3; i++)
+		{
+			AtkWireMsg msg((void*) (uintptr_t) (0x10002 + i), (i == 1) ? "Short" : name, i == 2);
+			msg.addParam(1000 + i);
+			TEST_CHECK(client->sendMsg(&msg) >= 0);
+		}
+		TEST_CHECK(client->isSendingCompactHeaders() == compact);
+		for (int i = 0; i < 3; i++)
+		{
+			AtkWireMsg* msg = server->recvMsg();
+			TEST_CHECK(msg);
+			TEST_CHECK(!strcmp(msg->m_msgName, (i == 1) ? "Short" : name));
+			TEST_CHECK(msg->getDestHandle() == (unsigned int) (0x10002 + i));
+			TEST_CHECK(msg->isSyncMsg() == (i == 2));
+			int value = 0;
+			TEST_CHECK(msg->getParam(value) >= 0 && value == 1000 + i);
+			delete msg;
+		}
+		delete client;
+		delete server;
+    }
+
+    // The original header keeps a pointer-wide destination, so frames from
+    // peers built before handles still read.
+    int fds[2];
+    TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    AtkWire* wire = new AtkWire(fds[1], fds[1]);
+    char frame[128];
+    memset(frame, 0, sizeof(frame));
+    int payload = 1234;
+    int total = (int) (sizeof(int) + MAX_MSG_NAME_LEN + sizeof(void*) + 1 + sizeof(payload));
+    void* dest = (void*) 7;
+    int len = 0;
+    memcpy(frame + len, &total, sizeof(int));
+    len += sizeof(int);
+    strcpy(frame + len, "Old");
+    len += MAX_MSG_NAME_LEN;
+    memcpy(frame + len, &dest, sizeof(void*));
+    len += sizeof(void*);
+    frame[len++] = 0;
+    memcpy(frame + len, &payload, sizeof(payload));
+    TEST_CHECK(AtkWireMsg::getFrameHeaderLength() == total - (int) sizeof(payload));
+    TEST_CHECK(write(fds[0], frame, total) == total);
+    AtkWireMsg* msg = wire->recvMsg();
+    TEST_CHECK(msg && !strcmp(msg->m_msgName, "Old") && msg->getDestHandle() == 7);
+    int value = 0;
+    TEST_CHECK(msg->getParam(value) >= 0 && value == payload);
+    delete msg;
+    delete wire;
+    close(fds[0]);
+    return(0);
+}
+
+/**
+ * Send payloads above and below the compression threshold, and check
+ * that only the large one was compressed and both arrive intact.
+ */
+static int
+testCompression()
+{
+    AtkWire* client;
+    AtkWire* server;
+    if (connectWires(&client, &server) < 0) return(-1);
+    client->setCompressionThreshold(1024);
+    TEST_CHECK(negotiate(client, server) == 0);
+
+    static char large[65536];
+    for (int i = 0; i < (int) sizeof(large); i++) large[i] = "atk wire "[i % 9];
+    char small[64];
+    for (int i = 0; i < (int) sizeof(small); i++) small[i] = (char) i;
+    TEST_CHECK(client->sendMsg(NULL, "Large", large, sizeof(large)) >= 0);
+    TEST_CHECK(client->sendMsg(NULL, "Small", small, sizeof(small)) >= 0);
+
+    AtkWireMsg* msg = server->recvMsg();
+    TEST_CHECK(msg && !strcmp(msg->m_msgName, "Large"));
+    TEST_CHECK(msg->getDataLength() == (int) sizeof(large));
+    TEST_CHECK(!memcmp(msg->m_msgData, large, sizeof(large)));
+    delete msg;
+    msg = server->recvMsg();
+    TEST_CHECK(msg && !strcmp(msg->m_msgName, "Small"));
+    TEST_CHECK(msg->getDataLength() == (int) sizeof(small));
+    TEST_CHECK(!memcmp(msg->m_msgData, small, sizeof(small)));
+    delete msg;
+
+    const AtkWireCompressionStats& stats = server->getCompressionStats();
+    TEST_CHECK(stats.m_recvMsgs == 1);
+    TEST_CHECK(stats.m_recvWireBytes < stats.m_recvRawBytes);
+
+    delete client;
+    delete server;
+    return(0);
+}
+
+/**
+ * Send a message on the bulk lane with interactive messages around it,
+ * and check that it is put back together from its fragments.
+ */
+static int
+testBulk()
+{
+    AtkWire* client;
+    AtkWire* server;
+    if (connectWires(&client, &server) < 0) return(-1);
+    client->setBulkThreshold(4096, 1024);
+    TEST_CHECK(negotiate(client, server) == 0);
+
+    const int size = 100000;
+    char* bulk = (char*) malloc(size);
+    for (int i = 0; i < size; i++) bulk[i] = (char) (i * 7);
+
+    int failed = 0;
+    std::thread sender([&]() {
+		for (int i = 0; i < 10; i++)
+		{
+			if (client->sendMsg(NULL, "Small", &i, sizeof(i)) < 0) failed = 1;
+			if (i == 2 && client->sendMsg(NULL, "Bulk", bulk, size) < 0) failed = 1;
+		}
+		if (client->flush(1) < 0) failed = 1;
+    });
+
+    // The small messages keep their order; the bulk one may be overtaken.
+    int numSmall = 0;
+    int numBulk = 0;
+    int bad = 0;
+    while (numSmall < 10 || numBulk < 1)
+	{
+		AtkWireMsg* msg = server->recvMsg();
+		if (!msg) break;
+		if (!strcmp(msg->m_msgName, "Bulk"))
+		{
+			if (msg->getDataLength() != size || memcmp(msg->m_msgData, bulk, size)) bad++;
+			numBulk++;
+		} else
+		{
+			int value = -1;
+			msg->getParam(value);
+			if (value != numSmall) bad++;
+			numSmall++;
+		}
+		delete msg;
+    }
+    sender.join();
+    free(bulk);
+    TEST_CHECK(!failed && !bad && numSmall == 10 && numBulk == 1);
+
+    delete client;
+    delete server;
+    return(0);
+}
+
+/**
+ * Send several requests, have them answered out of order, and wait for
+ * each reply by its correlation ID.
+ */
+static int
+testRequests()
+{
+    AtkWire* client;
+    AtkWire* server;
+    if (connectWires(&client, &server) < 0) return(-1);
+    TEST_CHECK(negotiate(client, server) == 0);
+    TEST_CHECK(client->getPeerCapabilities() & ATK_WIRE_CAP_CORRELATE);
+
+    const int numRequests = 10;
+    unsigned int ids[numRequests];
+    for (int i = 0; i < numRequests; i++)
+	{
+		ids[i] = client->sendRequest(NULL, "Square", &i, sizeof(i));
+		TEST_CHECK(ids[i] != 0);
+    }
+
+    // Answer the last request first.
+    AtkWireMsg* requests[numRequests];
+    for (int i = 0; i < numRequests; i++)
+	{
+		requests[i] = server->recvMsg();
+		TEST_CHECK(requests[i] && requests[i]->isSyncMsg());
+    }
+    for (int i = numRequests - 1; i >= 0; i--)
+	{
+		int value = 0;
+		requests[i]->getParam(value);
+		AtkWireMsg reply(NULL, REPLY_MSG_NAME);
+		reply.addParam(value * value);
+		reply.setCorrelationID(requests[i]->getCorrelationID());
+		TEST_CHECK(server->sendMsg(&reply) >= 0);
+		delete requests[i];
+    }
+
+    for (int i = 0; i < numRequests; i++)
+	{
+		AtkWireMsg* reply = client->waitForReply(NULL, ids[i]);
+		TEST_CHECK(reply && reply->isReplyMsg());
+		int value = -1;
+		TEST_CHECK(reply->getParam(value) >= 0 && value == i * i);
+		delete reply;
+    }
+    TEST_CHECK(client->getNumPendingRequests() == 0);
+
+    delete client;
+    delete server;
+    return(0);
+}
+
+/**
+ * Count the messages delivered to a wired, and answer the sync ones.
+ * Like any receiver, it owns the messages delivered to it.
+ */
+class TestWired : public AtkWired
+{
+  public:
+
+    TestWired(AtkWire* wire) : AtkWired("test", wire, NULL), m_numDelivered(0) {}
+
+    virtual AtkWireMsg* deliverMsg(AtkWireMsg* msg)
+    {
+		m_numDelivered++;
+		if (msg->isSyncMsg()) m_wire->sendMsg(NULL, REPLY_MSG_NAME, (void*) NULL, 0);
+		delete msg;
+		return(NULL);
+    }
+
+    int m_numDelivered;
+};
+
+/**
+ * Send a sync message to a wired that has gone away, and check that
+ * the sender still gets an answer instead of waiting for ever.
+ */
+static int
+testStaleHandle()
+{
+    AtkWire* client;
+    AtkWire* server;
+    if (connectWires(&client, &server) < 0) return(-1);
+    TestWired* root = new TestWired(server);
+    TestWired* gone = new TestWired(NULL);
+    unsigned int handle = gone->getHandle();
+    TEST_CHECK(handle != 0 && AtkWired::lookup(handle) == gone);
+    delete gone;
+    TEST_CHECK(AtkWired::lookup(handle) == NULL);
+
+    // A new wired may take the slot, but not the handle.
+    TestWired* other = new TestWired(NULL);
+    TEST_CHECK(other->getHandle() != handle);
+
+    AtkWired* tool = new AtkWired("tool", client, NULL);
+    std::thread receiver([root]() { root->recvAndDeliverMsg(); });
+    AtkWireMsg request((void*) (uintptr_t) handle, "Stale", 1);
+    AtkWireMsg* reply = client->sendSyncMsg(tool, &request);
+    receiver.join();
+    TEST_CHECK(reply && reply->isReplyMsg() && reply->getDataLength() == 0);
+    TEST_CHECK(root->m_numDelivered == 0 && other->m_numDelivered == 0);
+    delete reply;
+
+    tool->setWire(NULL);
+    root->setWire(NULL);
+    delete tool;
+    delete root;
+    delete other;
+    delete client;
+    delete server;
+    return(0);
+}
+
+/**
+ * A tool that, asked for something, has to ask back before it answers.
+ */
+class TestAsker : public AtkWired
+{
+  public:
+
+    TestAsker(AtkWire* wire) : AtkWired("asker", wire, NULL), m_numAsks(0) {}
+
+    virtual AtkWireMsg* deliverMsg(AtkWireMsg* msg)
+    {
+		int ask = !strcmp(msg->m_msgName, "Ask");
+		delete msg;
+		if (!ask) return(NULL);
+		m_numAsks++;
+		AtkWireMsg* inner = m_wire->sendSyncMsg(this, NULL, "Inner", (void*) NULL, 0);
+		if (inner) delete inner;
+		m_wire->sendMsg(NULL, REPLY_MSG_NAME, &m_numAsks, sizeof(m_numAsks));
+		return(NULL);
+    }
+
+    int m_numAsks;
+};
+
+/**
+ * Queue sync messages on a wire, then have it wait for a reply of its
+ * own; they are handled while it waits, even though handling them
+ * waits for replies in turn.
+ */
+static int
+testSyncWhileWaiting()
+{
+    AtkWire* client;
+    AtkWire* server;
+    if (connectWires(&client, &server) < 0) return(-1);
+    TestAsker* asker = new TestAsker(client);
+    TEST_CHECK(negotiate(client, server) == 0);
+
+    for (int i = 0; i < 2; i++)
+	{
+		AtkWireMsg ask(NULL, "Ask", 1);
+		ask.addParam(i);
+		TEST_CHECK(server->sendMsg(&ask) >= 0);
+    }
+    server->flush(1);
+
+    // Let both arrive before the client waits.
+    for (int i = 0; i < 100 && client->getNumMsgs() < 2; i++)
+	{
+		usleep(1000);
+		client->setNonBlocking(1);
+		client->pollMsgs();
+		client->setNonBlocking(0);
+    }
+    TEST_CHECK(client->getNumMsgs() == 2);
+
+    int numInner = 0;
+    int numReplies = 0;
+    std::thread peer([&]() {
+		int sawRequest = 0;
+		while (!sawRequest || numReplies < 2)
+		{
+			AtkWireMsg* msg = server->recvMsg();
+			if (!msg) break;
+			if (msg->isReplyMsg()) numReplies++;
+			else if (!strcmp(msg->m_msgName, "Inner"))
+			{
+				numInner++;
+				server->sendMsg(NULL, REPLY_MSG_NAME, (void*) NULL, 0);
+			}
+			else if (!strcmp(msg->m_msgName, "Request")) sawRequest = 1;
+			delete msg;
+		}
+		server->sendMsg(NULL, REPLY_MSG_NAME, (void*) NULL, 0);
+    });
+    AtkWireMsg* reply = client->sendSyncMsg(asker, NULL, "Request", (void*) NULL, 0);
+    peer.join();
+    TEST_CHECK(reply && reply->isReplyMsg());
+    TEST_CHECK(asker->m_numAsks == 2 && numInner == 2 && numReplies == 2);
+    delete reply;
+
+    asker->setWire(NULL);
+    delete asker;
+    delete client;
+    delete server;
+    return(0);
+}
+
+/**
+ * Ask a player for a page of a find, and read back its names.
+ *
+ * @return The token of the next page, 0 if there is none, or a negative
+ * value if the reply is the empty one that reports an error.
+ */
+static int
+findPage(AtkWire* tool, MlePlayer* player, const char* name, int token,
+	std::set<std::string>& names)
+{
+    AtkWireMsg request(NULL, "FindPage");
+    TestFindPageMsg::pack(&request, name, token);
+    unsigned int id = tool->sendRequest(&request);
+    if (!id) return(-2);
+    player->recvAndDeliverMsg();
+    AtkWireMsg* reply = tool->waitForReply(NULL, id);
+    if (!reply) return(-2);
+    if (reply->getDataLength() == 0)
+	{
+		delete reply;
+		return(-1);
+    }
+
+    int next, count;
+    if (TestPageReplyMsg::unpack(reply, next, count) < 0) next = -2;
+    for (int i = 0; i < count && next >= 0; i++)
+	{
+		AtkMsgBlob entry;
+		if (TestPageEntryMsg::unpack(reply, entry) < 0) next = -2;
+		else names.insert((const char*) entry.m_data);
+    }
+    delete reply;
+    return(next);
+}
+
+/**
+ * Page through more actor names than fit on one page, and ask for one
+ * whose name is too long for a page on its own.
+ */
+static int
+testPaging()
+{
+    AtkWire* tool;
+    AtkWire* wire;
+    if (connectWires(&tool, &wire) < 0) return(-1);
+    MlePlayer* player = new MlePlayer(wire, NULL);
+    MleDwpStrKeyDict* actors = MleActor::getInstanceRegistry();
+
+    // About 50 bytes a name puts over a thousand on each page.
+    const int numActors = 5000;
+    char name[64];
+    static int value;
+    for (int i = 0; i < numActors; i++)
+	{
+		snprintf(name, sizeof(name), "atktest-actor-with-a-fairly-long-name-%05d", i);
+		actors->set(name, &value);
+    }
+
+    std::set<std::string> names;
+    int token = 0;
+    int numPages = 0;
+    do
+	{
+		token = findPage(tool, player, "", token, names);
+		TEST_CHECK(token >= 0);
+		numPages++;
+    } while (token > 0);
+    TEST_CHECK(numPages > 1);
+    for (int i = 0; i < numActors; i++)
+	{
+		snprintf(name, sizeof(name), "atktest-actor-with-a-fairly-long-name-%05d", i);
+		TEST_CHECK(names.count(name) == 1);
+    }
+
+    // A token that was never handed out gets the empty reply.
+    TEST_CHECK(findPage(tool, player, "", 12345, names) == -1);
+
+    // So does a name that can't fit on a page, rather than a page that
+    // looks like the end of the listing.
+    std::string huge(70000, 'x');
+    actors->set(huge.c_str(), &value);
+    TEST_CHECK(findPage(tool, player, huge.c_str(), 0, names) == -1);
+    actors->remove(huge.c_str());
+
+    for (int i = 0; i < numActors; i++)
+	{
+		snprintf(name, sizeof(name), "atktest-actor-with-a-fairly-long-name-%05d", i);
+		actors->remove(name);
+    }
+    player->setWire(NULL);
+    delete player;
+    delete wire;
+    delete tool;
+    return(0);
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct {
+		const char* name;
+		int (*run)();
+    } tests[] = {
+		{ "headers", testHeaders },
+		{ "compression", testCompression },
+		{ "bulk", testBulk },
+		{ "requests", testRequests },
+		{ "stale", testStaleHandle },
+		{ "sync", testSyncWhileWaiting },
+		{ "paging", testPaging }
+    };
+    int numTests = sizeof(tests) / sizeof(tests[0]);
+
+    // With no names given, every test is run.
+    int status = 0;
+    for (int i = 0; i < numTests; i++)
+	{
+		int selected = (argc == 1);
+		for (int j = 1; j < argc; j++)
+			if (!strcmp(argv[j], tests[i].name)) selected = 1;
+		if (!selected) continue;
+
+		int result = tests[i].run();
+		printf("%s: %s\n", (result < 0) ? "FAIL" : "PASS", tests[i].name);
+		fflush(stdout);
+		if (result < 0) status = 1;
+    }
+    return(status);
+}
@@ -41,7 +41,9 @@
 //
 // COPYRIGHT_END
 
+#include <stdlib.h>
 #if defined(__linux__) || defined (__APPLE__)
+#include <fcntl.h>
 #include <signal.h>
 #if defined(MLE_QT)
 #include <QWindow>
@@ -51,7 +53,14 @@
 #include "mle/MlePlayer.h"
 
 #include "mle/AtkWire.h"
+#include "mle/AtkShmWire.h"
 #include "mle/AtkWireMsg.h"
+#include "mle/AtkWireBatch.h"
+#include "mle/AtkWireFunc.h"
+#include "mle/AtkWireWorkers.h"
+#include "mle/AtkMsgSchema.h"
+#include "mle/AtkWireRecorder.h"
+#include "mle/AtkWireReplayer.h"
 #include "mle/AtkCommonStructs.h"
 
 #include <mle/mlFileio.h>
@@ -99,6 +108,153 @@
 
 #define MAX_NAME_LENGTH 200
 
+// The layouts of the messages exchanged most often with the tools.
+ATK_MSG_SCHEMA(AtkSetTransformMsg, "SetTransform", const char*, MlTransform);
+ATK_MSG_SCHEMA(AtkGetTransformMsg, "GetTransform", const char*);
+ATK_MSG_SCHEMA(AtkPickRequestMsg, "Pick", int, int, const char*);
+ATK_MSG_SCHEMA(AtkSetPositionMsg, "SetPosition", const char*, const char*, int, int);
+ATK_MSG_SCHEMA(AtkGetCameraPositionMsg, "GetCameraPosition", const char*);
+ATK_MSG_SCHEMA(AtkSetCameraPositionMsg, "SetCameraPosition", const char*, MlTransform);
+ATK_MSG_SCHEMA(AtkTransformReplyMsg, REPLY_MSG_NAME, MlTransform);
+ATK_MSG_SCHEMA(AtkPickMsg, "Pick", const char*, const char*);
+ATK_MSG_SCHEMA(AtkUnpickMsg, "Unpick", const char*, const char*);
+ATK_MSG_SCHEMA(AtkPropertyChangeMsg, "PropertyChange", const char*, const char*, AtkMsgBlob);
+ATK_MSG_SCHEMA(AtkDoubleClickMsg, "DoubleClick", const char*, int);
+ATK_MSG_SCHEMA(AtkFindPageMsg, "FindPage", const char*, int);
+ATK_MSG_SCHEMA(AtkGetSetsPageMsg, "GetSetsPage", int, int, int);
+ATK_MSG_SCHEMA(AtkGetPropertyNamesPageMsg, "GetActorPropertyNamesPage",
+	const char*, const char*, int);
+
+// A paged reply holds the token of the next page and the number of names
+// on the page, followed by each name as a length-prefixed string whose
+// length counts its terminator.
+ATK_MSG_SCHEMA(AtkPageReplyMsg, REPLY_MSG_NAME, int, int);
+ATK_MSG_SCHEMA(AtkPageEntryMsg, REPLY_MSG_NAME, AtkMsgBlob);
+
+// A paged reply ends its page once it holds this many bytes.
+#define MLE_PLAYER_PAGE_BYTES (64 * 1024)
+
+// Add a name to a paged reply; returns 0 if the page is full.
+static int
+mlePageAdd(AtkWireMsg* reply, const char* name)
+{
+    AtkMsgBlob entry = { name, (int) strlen(name) + 1 };
+    if (reply->getDataLength() + AtkPageEntryMsg::getSize(entry) > MLE_PLAYER_PAGE_BYTES)
+		return(0);
+    AtkPageEntryMsg::pack(reply, entry);
+    return(1);
+}
+
+// Fill in the head of a paged reply once its names have been added.
+static void
+mlePageEnd(AtkWireMsg* reply, int nextToken, int count)
+{
+    char* head = (char*) reply->m_msgData;
+    memcpy(head, &nextToken, sizeof(int));
+    memcpy(head + sizeof(int), &count, sizeof(int));
+}
+
+// A listing being paged through.  The cursor keeps its place in the
+// registry between pages, so each page resumes where the last one ended
+// without walking the registry again or copying more than the key it
+// stopped at.  The place is only good while the entry it is on stays in
+// the registry, so that is checked before each page after the first.
+class MlePageCursor
+{
+  public:
+
+    MlePageCursor() : m_registry(NULL), m_iter(NULL), m_key(NULL), m_value(NULL),
+		m_setNames(0), m_token(0) {}
+
+    ~MlePageCursor() { clear(); }
+
+    // Drop the listing.
+    void clear();
+
+    // Start a listing of a registry's keys, or, with setNames, of the
+    // names of the sets it holds.
+    void start(MleDwpStrKeyDict* registry, int setNames);
+
+    // Whether the place the last page stopped at is still in the registry.
+    int isValid();
+
+    // Add names to a paged reply from where the last page ended; returns
+    // the number added, or -1 if the next name doesn't fit on a page.
+    int fill(AtkWireMsg* reply);
+
+    int isDone() { return (!m_iter || !m_iter->getKey()); }
+
+    MleDwpStrKeyDict* m_registry;
+    MleDwpDictIter* m_iter;
+    // A copy of the key, and the value, of the entry the next page
+    // starts with.
+    char* m_key;
+    void* m_value;
+    int m_setNames;
+    // The token the last page handed out; 0 before the first page.
+    int m_token;
+};
+
+void
+MlePageCursor::clear()
+{
+    delete m_iter;
+    m_iter = NULL;
+    if (m_key) mlFree(m_key); // Allocated in strdup.
+    m_key = NULL;
+    m_value = NULL;
+    m_registry = NULL;
+    m_token = 0;
+}
+
+void
+MlePageCursor::start(MleDwpStrKeyDict* registry, int setNames)
+{
+    clear();
+    m_registry = registry;
+    m_iter = new MleDwpDictIter(*registry);
+    m_setNames = setNames;
+}
+
+int
+MlePageCursor::isValid()
+{
+    if (!m_iter) return(0);
+    if (!m_key) return(1);
+    return(m_registry->find(m_key) == m_value);
+}
+
+int
+MlePageCursor::fill(AtkWireMsg* reply)
+{
+    if (m_key) mlFree(m_key); // Allocated in strdup.
+    m_key = NULL;
+    m_value = NULL;
+
+    int count = 0;
+    for (; m_iter->getKey(); m_iter->next())
+	{
+		const char* name = (const char*) m_iter->getKey();
+		if (m_setNames)
+		{
+			MleSet* set = (MleSet *) m_iter->getValue();
+			MLE_ASSERT(set != NULL);
+			name = set->getName();
+		}
+		if (!mlePageAdd(reply, name ? name : ""))
+		{
+			if (!count) return(-1);
+
+			// Remember where the next page starts.
+			m_key = strdup((const char*) m_iter->getKey());
+			m_value = m_iter->getValue();
+			break;
+		}
+		count++;
+    }
+    return(count);
+}
+
 /*****************************************************************************
 * Constructor, destructor, creation
 *****************************************************************************/
@@ -129,6 +285,13 @@ MlePlayer::MlePlayer(AtkWire* wire, void* objID)
 
     m_sendStats = 0;
 
+    m_notifyMsg = new AtkWireMsg();
+    m_queryWorkers = NULL;
+    m_draining = 0;
+    m_findCursor = new MlePageCursor();
+    m_setsCursor = new MlePageCursor();
+    m_lastPageToken = 0;
+
     // Trap fatal signals to fflush diagnostic (stdout, stderr) pipes to tools.
 #if defined(__linux__) || defined(__APPLE__)
     signal(SIGBUS, (SIG_PF) signalHandler);
@@ -161,6 +324,10 @@ MlePlayer::~MlePlayer()
 		mlFree(current->m_data);
 		delete current;
     }
+    delete m_queryWorkers;
+    delete m_findCursor;
+    delete m_setsCursor;
+    delete m_notifyMsg;
 }
 
 #if defined(_WINDOWS)
@@ -199,13 +366,51 @@ MlePlayer::create(int argc, char* argv[])
 		printf("ObjID = %d\n", m_objID);
 	);
 
-    // Create wire.
-    AtkWire* wire = new AtkWire(readFD, writeFD);
+    // Create wire.  "-shm memFD recvEventFD sendEventFD" after the
+    // object id selects the shared memory transport; the pipes remain the
+    // fallback if the region can't be attached.
+    AtkWire* wire = NULL;
+#if defined(__linux__)
+    if (argc >= 9 && !strcmp(argv[5], "-shm"))
+	{
+		int memFD = -1;
+		int recvEventFD = -1;
+		int sendEventFD = -1;
+		sscanf(argv[6], "%d", &memFD);
+		sscanf(argv[7], "%d", &recvEventFD);
+		sscanf(argv[8], "%d", &sendEventFD);
+		MLE_DEBUG_CAT("ATK",
+			printf("Shared memory FD = %d, events = %d, %d\n", memFD,
+				recvEventFD, sendEventFD);
+		);
+		wire = AtkShmWire::attach(memFD, recvEventFD, sendEventFD);
+		if (!wire) printf("Player Error: Could not attach shared memory wire\n");
+    }
+#endif /* __linux__ */
+    if (!wire) wire = new AtkWire(readFD, writeFD);
+
+    // Record the session for replay, if asked to.
+    const char* recordFile = getenv("MLE_ATK_RECORD");
+    if (recordFile && *recordFile)
+	{
+		AtkWireRecorder* recorder = AtkWireRecorder::open(recordFile);
+		if (recorder) wire->setRecorder(recorder);
+		else printf("Player Error: Could not record to %s\n", recordFile);
+    }
+
+    // Load the wire funcs in the background now rather than on first
+    // use; "1" selects the index in the wire func directory.
+    const char* preloadIndex = getenv("MLE_ATK_WIREFUNC_PRELOAD");
+    if (preloadIndex && *preloadIndex)
+		AtkWireFunc::preload(strcmp(preloadIndex, "1") ? preloadIndex : NULL);
 
     // Create a player and set up callbacks.
     MlePlayer* player = new MlePlayer(wire, m_objID);
     player->setErrorFD(errorFD);
 
+    const char* queryThreads = getenv("MLE_ATK_QUERY_THREADS");
+    if (queryThreads && *queryThreads) player->setNumQueryThreads(atoi(queryThreads));
+
     // dup off error FD to stdin and stderr.
     if (dup2(errorFD, STDOUT_FILENO) != STDOUT_FILENO)
 	{
@@ -220,6 +425,92 @@ MlePlayer::create(int argc, char* argv[])
     return(player);
 }
 
+/*****************************************************************************
+* Replaying a wire log
+*****************************************************************************/
+int
+MlePlayer::replay(const char* filename, int speed)
+{
+    AtkWireReplayer* replayer = AtkWireReplayer::open(filename);
+    if (!replayer)
+	{
+		printf("Player Error: Could not replay %s\n", filename);
+		return(-1);
+    }
+
+    // Replies to the replayed requests must not reach the tools; the
+    // stand-in wire closes the sink when it is deleted.
+    if (m_queryWorkers) m_queryWorkers->barrier();
+    AtkWire* wire = m_wire;
+    m_wire = new AtkWire(-1, open("/dev/null", O_WRONLY));
+
+    int count = replayer->replay(this, speed);
+    if (m_queryWorkers) m_queryWorkers->barrier();
+    replayer->printStats();
+
+    delete m_wire;
+    m_wire = wire;
+    delete replayer;
+    return(count);
+}
+
+/*****************************************************************************
+* Handling queries on workers
+*****************************************************************************/
+
+// The messages that only read the player's state.  FindPage isn't one;
+// it keeps the cursor of the listing it pages through.
+static const char* g_queryMsgNames[] =
+{
+    "GetActorPropertyNames",
+    "GetActorPropertyNamesPage",
+    "GetActorIsA",
+    "GetFunctions",
+    "GetFunctionAttributes",
+    NULL
+};
+
+void
+MlePlayer::setNumQueryThreads(int numThreads)
+{
+    // The old workers finish what they have first.
+    delete m_queryWorkers;
+    m_queryWorkers = NULL;
+    if (numThreads <= 0) return;
+
+    m_queryWorkers = new AtkWireWorkers(numThreads);
+    for (int i = 0; g_queryMsgNames[i]; i++)
+		m_queryWorkers->setAffinity(g_queryMsgNames[i], ATK_WIRE_AFFINITY_WORKER);
+}
+
+int
+MlePlayer::deliverPendingMsgs(int maxMsgs)
+{
+    // While draining, the main thread only reads messages and waits for
+    // the queries, so the actors and sets they read can't change.  They
+    // are all answered before the main loop gets control back.
+    int draining = m_draining;
+    m_draining = 1;
+    int count = AtkWired::deliverPendingMsgs(maxMsgs);
+    m_draining = draining;
+
+    if (m_queryWorkers)
+	{
+		m_queryWorkers->barrier();
+		if (m_wire && m_wire->hasPendingOutput()) m_wire->flush(0);
+    }
+    return(count);
+}
+
+AtkWireMsg*
+MlePlayer::routeMsg(AtkWireMsg* msg)
+{
+    // A message for another wired may change what the queries read.
+    unsigned int handle = msg ? msg->getDestHandle() : 0;
+    if (m_queryWorkers && handle && handle != m_handle) m_queryWorkers->barrier();
+    return(AtkWired::routeMsg(msg));
+}
+
 /*****************************************************************************
 * Delivering msgs
 *****************************************************************************/
@@ -229,10 +520,53 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
     // Check for errors.
     if (!msg) return(0);
 
+    // Queries go to the workers while the wire is drained, unless their
+    // replies must be sent before this returns; deliverPendingMsgs() waits
+    // for them.  Anything else waits for the queries in flight, so that it
+    // neither changes what they read nor overtakes their replies.
+    if (m_queryWorkers && !AtkWireWorkers::isWorkerThread())
+	{
+		if (m_draining && m_wire && !m_wire->getReplyBatch() &&
+			!m_wire->isDeliveringSyncMsg() &&
+			m_queryWorkers->getAffinity(msg->m_msgName) == ATK_WIRE_AFFINITY_WORKER &&
+			m_queryWorkers->submit(this, msg) == 0)
+		{
+			m_queryWorkers->flush();
+			return(0);
+		}
+		m_queryWorkers->barrier();
+    }
+
+    if (!m_wire || !m_wire->isStatsEnabled()) return(dispatchMsg(msg));
+
+    // Count how long the message waited and how long it took; the handler
+    // may consume it, so hold on to the name.
+    char msgName[MAX_MSG_NAME_LEN];
+    strcpy(msgName, msg->m_msgName);
+    long long start = AtkWireStats::now();
+    long long waitTime = msg->getRecvTime() ? start - msg->getRecvTime() : -1;
+
+    AtkWireMsg* reply = dispatchMsg(msg);
+
+    // The handler may have swapped the wire.
+    if (m_wire)
+		m_wire->getStats()->recordHandled(msgName, waitTime, AtkWireStats::now() - start);
+    return(reply);
+}
+
+AtkWireMsg*
+MlePlayer::dispatchMsg(AtkWireMsg* msg)
+{
+
     // XXX - shouldn't all these strings be constants instead? Why not
     // include the header files from authoring/wirefuncs?
 
-    if (!strcmp("Init", msg->m_msgName))
+    if (!strcmp(ATK_WIRE_BATCH_MSG_NAME, msg->m_msgName))
+	{
+		// Each member goes through deliverMsg() in turn.
+		deliverBatch(msg);
+
+    } else if (!strcmp("Init", msg->m_msgName))
 	{
 		int w, h;
 		int ret = msg->getParam(w);
@@ -291,16 +625,29 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 		// Call find.
 		recvFindActor((char*) msg->m_msgData);
 
+    } else if (!strcmp("FindPage", msg->m_msgName))
+	{
+		const char* name;
+		int token;
+		if (AtkFindPageMsg::unpack(msg, name, token) < 0)
+		{
+			printf("MlePlayer::deliverMsg - FindPage failed\n");
+			m_wire->sendMsg(m_objID, REPLY_MSG_NAME);
+			return(0);
+		}
+
+		recvFindPage(name, token);
+
     } else if (!strcmp("GetActorPropertyNames", msg->m_msgName))
 	{
-		char actorName[MAX_NAME_LENGTH];
-		char propDataset[MAX_NAME_LENGTH];
+		// The names are used in place in the msg.
+		const char* actorName;
+		const char* propDataset;
 		int ret;
 
-        actorName[0] = propDataset[0] = '\0';
-		ret = msg->getParam(actorName);
+		ret = msg->getParamView(actorName);
 		if (ret >= 0)
-			ret = msg->getParam(propDataset);
+			ret = msg->getParamView(propDataset);
 		if (ret < 0)
 		{
 			printf("MlePlayer::deliverMsg - GetActorPropertyNames failed\n");
@@ -310,17 +657,30 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 		// Get all the property names of a property dataset.
 		recvGetActorPropertyNames(actorName, propDataset);
 
+    } else if (!strcmp("GetActorPropertyNamesPage", msg->m_msgName))
+	{
+		const char* actorName;
+		const char* propDataset;
+		int token;
+		if (AtkGetPropertyNamesPageMsg::unpack(msg, actorName, propDataset, token) < 0)
+		{
+			printf("MlePlayer::deliverMsg - GetActorPropertyNamesPage failed\n");
+			m_wire->sendMsg(m_objID, REPLY_MSG_NAME);
+			return(0);
+		}
+
+		recvGetActorPropertyNamesPage(actorName, propDataset, token);
+
     } else if (!strcmp("GetActorProperty", msg->m_msgName))
 	{
-		char actorClass[MAX_NAME_LENGTH];
-		char actorName[MAX_NAME_LENGTH];
-		char propName[MAX_NAME_LENGTH];
-		actorClass[0] = actorName[0] = propName[0] = 0;
+		const char* actorClass;
+		const char* actorName;
+		const char* propName;
 
 		// Get and Check parameters.
-		int ret = msg->getParam(actorClass);
-		if (ret >=0) ret = msg->getParam(actorName);
-		if (ret >=0) ret = msg->getParam(propName);
+		int ret = msg->getParamView(actorClass);
+		if (ret >=0) ret = msg->getParamView(actorName);
+		if (ret >=0) ret = msg->getParamView(propName);
 		if (ret < 0)
 		{
 			// Error could not get data.
@@ -333,18 +693,16 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 
     } else if (!strcmp("SetActorProperty", msg->m_msgName))
 	{
-		char actorClass[MAX_NAME_LENGTH];
-		char actorName[MAX_NAME_LENGTH];
-		char propName[MAX_NAME_LENGTH];
-		void* data = 0;
-		actorClass[0] = actorName[0] = propName[0] = 0;
+		const char* actorClass;
+		const char* actorName;
+		const char* propName;
+		const void* data = 0;
 
 		// Check parameters.
-		int len;
-		int ret = msg->getParam(actorClass);
-		if (ret >=0) ret = msg->getParam(actorName);
-		if (ret >=0) ret = msg->getParam(propName);
-		if (ret >=0) ret = msg->getParam(data, len);
+		int ret = msg->getParamView(actorClass);
+		if (ret >=0) ret = msg->getParamView(actorName);
+		if (ret >=0) ret = msg->getParamView(propName);
+		if (ret >=0) ret = msg->getParamView(data);
 		if (ret < 0)
 		{
 			printf("ERROR MlePlayer::deliverMsg - setActorProperty failed\n");
@@ -355,9 +713,8 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 			printf("Msg %s  Len: %d, AC: %s, AN: %s,  PN: %s\n", msg->m_msgData, msg->getDataLength(), actorClass, actorName, propName);
 		);
 
-		// Set the properties.
-		recvSetActorProperty(actorClass, actorName, propName, data);
-		if (data) mlFree(data);
+		// Set the properties; the value is only read.
+		recvSetActorProperty(actorClass, actorName, propName, const_cast<void*>(data));
 
     } else if (!strcmp("SetActorName", msg->m_msgName))
 	{
@@ -383,14 +740,13 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 
     } else if (!strcmp("GetActorIsA", msg->m_msgName))
 	{
-		char actorName[MAX_NAME_LENGTH];
-		char actorClass[MAX_NAME_LENGTH];
+		const char* actorName;
+		const char* actorClass;
 		int ret;
 
-		actorName[0] = actorClass[0] = 0;
-		ret = msg->getParam(actorName);
+		ret = msg->getParamView(actorName);
 		if(ret >= 0)
-			ret = msg->getParam(actorClass);
+			ret = msg->getParamView(actorClass);
 		if(ret < 0) {
 			printf("MlePlayer::deliverMsg - GetActorIsA failed\n");
 			return 0;
@@ -401,41 +757,37 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 
     } else if (!strcmp("SetTransform", msg->m_msgName))
 	{
-		char actorName[MAX_NAME_LENGTH];
+		const char* actorName;
 		MlTransform t;
 		
-		int ret = msg->getParam(actorName);
-		if (ret >=0) ret = msg->getParam(t);
+		int ret = AtkSetTransformMsg::unpack(msg, actorName, t);
 		if (ret < 0)
 		{
 			printf("ERROR MlePlayer::deliverMsg - SetTransform failed\n");
 			return(0);
 		}
 
-		recvSetTransform(actorName, t);
+		recvSetTransform(const_cast<char*>(actorName), t);
 
     } else if (!strcmp("GetTransform", msg->m_msgName))
 	{
-		char actorName[MAX_NAME_LENGTH];
+		const char* actorName;
 		
-		int ret = msg->getParam(actorName);
+		int ret = AtkGetTransformMsg::unpack(msg, actorName);
 		if (ret < 0)
 		{
 			printf("ERROR MlePlayer::deliverMsg - SetTransform failed\n");
 			return(0);
 		}
 
-		recvGetTransform(actorName);
+		recvGetTransform(const_cast<char*>(actorName));
 
     } else if (!strcmp("Pick", msg->m_msgName))
 	{
 		// Get and check parameters.
 		int x, y;
-		char setName[MAX_NAME_LENGTH];
-		setName[0] = 0;
-		int ret = msg->getParam(x);
-		if (ret >=0) ret = msg->getParam(y);
-		if (ret >=0) ret = msg->getParam(setName);
+		const char* setName;
+		int ret = AtkPickRequestMsg::unpack(msg, x, y, setName);
 		if (ret < 0)
 		{
 			printf("ERROR FWPlayer::deliverMsg - pick params incorrect\n");
@@ -443,7 +795,7 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 		}
 
 		// Pick actors
-		recvPick(setName, x, y);
+		recvPick(const_cast<char*>(setName), x, y);
 
     } else if (!strcmp("Refresh", msg->m_msgName))
 	{
@@ -541,21 +893,16 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 	{
 		// Get and check parameters.
 		int x, y;
-		char actorName[MAX_NAME_LENGTH];
-		char setName[MAX_NAME_LENGTH];
-		actorName[0] = 0;
-		setName[0] = 0;
-		int ret = msg->getParam(setName);
-		if (ret >=0) ret = msg->getParam(actorName);
-		if (ret >=0) ret = msg->getParam(x);
-		if (ret >=0) ret = msg->getParam(y);
+		const char* actorName;
+		const char* setName;
+		int ret = AtkSetPositionMsg::unpack(msg, setName, actorName, x, y);
 		if (ret < 0)
 		{
 			printf("ERROR MlePlayer::deliverMsg - setPositions params incorrect\n");
 			return(0);
 		}
 
-		recvSetPosition(setName, actorName, x, y);
+		recvSetPosition(const_cast<char*>(setName), const_cast<char*>(actorName), x, y);
 
     } else if (!strcmp("ResolveEdit", msg->m_msgName))
 	{
@@ -589,32 +936,29 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
     } else if (!strcmp("GetCameraPosition", msg->m_msgName))
 	{
 		// Get and check parameters.
-		char setName[MAX_NAME_LENGTH];
-		setName[0] = 0;
-		int ret = msg->getParam(setName);
+		const char* setName;
+		int ret = AtkGetCameraPositionMsg::unpack(msg, setName);
 		if (ret < 0)
 		{
 			printf("ERROR MlePlayer::deliverMsg - getCameraPosition params incorrect\n");
 			return(0);
 		}
 
-		recvGetCameraPosition(setName);
+		recvGetCameraPosition(const_cast<char*>(setName));
 
     } else if (!strcmp("SetCameraPosition", msg->m_msgName))
 	{
 		// Get and check parameters.
-		char setName[MAX_NAME_LENGTH];
-		setName[0] = 0;
+		const char* setName;
 		MlTransform t;
 		
-		int ret = msg->getParam(setName);
-		if (ret >=0) ret = msg->getParam(t);
+		int ret = AtkSetCameraPositionMsg::unpack(msg, setName, t);
 		if (ret < 0) {
 			printf("ERROR MlePlayer::deliverMsg - setCameraPosition params incorrect\n");
 			return(0);
 		}
 
-		recvSetCameraPosition(setName, &t);
+		recvSetCameraPosition(const_cast<char*>(setName), &t);
 
     } else if (!strcmp("StartStats", msg->m_msgName))
 	{
@@ -624,6 +968,18 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 	{
 		recvEndStats();
 
+    } else if (!strcmp(ATK_WIRE_START_STATS_MSG_NAME, msg->m_msgName))
+	{
+		recvStartMsgStats();
+
+    } else if (!strcmp(ATK_WIRE_END_STATS_MSG_NAME, msg->m_msgName))
+	{
+		recvEndMsgStats();
+
+    } else if (!strcmp(ATK_WIRE_GET_STATS_MSG_NAME, msg->m_msgName))
+	{
+		recvGetMsgStats();
+
     } else if (!strcmp("RegisterProp", msg->m_msgName))
 	{
 		char actorName[MAX_NAME_LENGTH];
@@ -1041,6 +1397,18 @@ MlePlayer::deliverMsg(AtkWireMsg* msg)
 		// Go get the functions.
 		recvGetSets(x, y);
 
+    } else if (!strcmp("GetSetsPage", msg->m_msgName))
+	{
+		int x, y, token;
+		if (AtkGetSetsPageMsg::unpack(msg, x, y, token) < 0)
+		{
+			printf("ERROR MlePlayer::deliverMsg - GetSetsPage failed\n");
+			m_wire->sendMsg(m_objID, REPLY_MSG_NAME);
+			return(0);
+		}
+
+		recvGetSetsPage(x, y, token);
+
     } else if (!strcmp("LoadSet", msg->m_msgName))
 	{
         char setName[256];
@@ -1213,7 +1581,6 @@ void
 MlePlayer::recvGetActorPropertyNames(const char *actorName,
 	const char *propDataset)
 {
-    char **propName;
     int i, numPropName;
     MleDwpStrKeyDict *actorInstanceReg;
     MleActor *actor;
@@ -1228,15 +1595,15 @@ MlePlayer::recvGetActorPropertyNames(const char *actorName,
 		propNameArray = actor->getPropNames(propDataset);
 		numPropName = propNameArray->getSize();
 
-		// Note the addParam() call expects propName to have a terminator
-		// string with NULL in it.
-		propName = new char *[numPropName + 1];
-		for(i = 0; i < numPropName; i++)
-			propName[i] = (char *) ((*propNameArray)[i]);
-        propName[i] = const_cast<char *>("");
-
+		// The names are laid out as addParam(const char**) lays them out,
+		// ending with an empty one, but are added as they are found.
 		retMsg = new AtkWireMsg(m_objID, REPLY_MSG_NAME);
-		retMsg->addParam((const char**)propName);
+		for(i = 0; i < numPropName; i++)
+		{
+			const char* name = (const char *) ((*propNameArray)[i]);
+			if (name && *name) retMsg->addParam(name);
+		}
+		retMsg->addParam("");
 
 		// Send a list of property names for the property dataset back to
 		// the tool side.
@@ -1247,7 +1614,6 @@ MlePlayer::recvGetActorPropertyNames(const char *actorName,
 		}
 
 		delete retMsg;
-		delete [] propName;
 
 	} else
 	{
@@ -1257,6 +1623,55 @@ MlePlayer::recvGetActorPropertyNames(const char *actorName,
     }
 }
 
+void
+MlePlayer::recvGetActorPropertyNamesPage(const char *actorName,
+	const char *propDataset, int token)
+{
+    MleActor* actor = (MleActor *) MleActor::getInstanceRegistry()->find(actorName);
+    if (!actor)
+	{
+		m_wire->sendMsg(m_objID, REPLY_MSG_NAME);
+		printf("PLAYER ERROR:  cound not find actor '%s'\n",
+			   (actorName) ? actorName : "");
+		return;
+    }
+
+    MlePtrArray* propNameArray = actor->getPropNames(propDataset);
+    int numPropName = propNameArray->getSize();
+
+    AtkWireMsg* reply = AtkPageReplyMsg::create(m_objID, 0, 0);
+    int count = 0;
+    int next = 0;
+    int full = 0;
+    // The property names of a class don't change, so the token is simply
+    // the index of the name the page starts with.
+    for (int i = (token > 0) ? token : 0; i < numPropName; i++)
+	{
+		const char* name = (const char *) ((*propNameArray)[i]);
+		if (!mlePageAdd(reply, name ? name : ""))
+		{
+			next = i;
+			full = 1;
+			break;
+		}
+		count++;
+    }
+    if (full && !count)
+	{
+		delete reply;
+		m_wire->sendMsg(m_objID, REPLY_MSG_NAME);
+		printf("PLAYER ERROR: property name too long for a page, actor '%s'\n",
+			   (actorName) ? actorName : "");
+		return;
+    }
+    mlePageEnd(reply, next, count);
+
+    if (m_wire->sendMsg(reply) < 0)
+		printf("PLAYER ERROR: problem sending property names,actor '%s'\n",
+		   (actorName) ? actorName : "");
+    delete reply;
+}
+
 /*****************************************************************************
 * Getting/setting properties
 *****************************************************************************/
@@ -1506,8 +1921,7 @@ int MlePlayer::recvGetTransform(char *actorName)
 		MlTransform t;
 		actor->getPropDataset(MLE_PROP_DATASET_TRANSFORM, &t);
 
-		AtkWireMsg* m = new AtkWireMsg(m_objID, REPLY_MSG_NAME);
-		m->addParam(t);
+		AtkWireMsg* m = AtkTransformReplyMsg::create(m_objID, t);
 		if (m_wire->sendMsg(m) < 0) 
 		{
 			printf("PLAYER ERROR: sending transform, actor '%s'\n", 
@@ -1535,32 +1949,22 @@ void
 MlePlayer::recvFind(MleDwpType /*t*/, const char* name, int findAll)
 {
     // XXX - Currently, we can only find actors - we are ignoring t.
-    // Now find actor
-    char* data=0;
-    int dataLen = 0;
-
-    // Loop through actors.
+    // The names are appended to the reply as they are found, and end
+    // with an empty one.
+    AtkWireMsg* reply = new AtkWireMsg(m_objID, REPLY_MSG_NAME);
     MleDwpStrKeyDict* actorInstances = MleActor::getInstanceRegistry();
-    for (MleDwpDictIter iter(*actorInstances); iter.getValue(); iter.next())
+    if (name)
 	{
-		// Compare name with key.
-		char* key = (char*) iter.getKey();
-		if (!key) continue;
-
-		// If a match, alloc space and copy.
-		if (!name || !strcmp(key, name) )
+		// Actor names are unique, so only the one can match.
+		if (actorInstances->find(name)) reply->addParam(name);
+    } else
+	{
+		// Loop through actors.
+		for (MleDwpDictIter iter(*actorInstances); iter.getValue(); iter.next())
 		{
-			if (!data)
-			{
-				data = (char*) mlMalloc(strlen(key));
-			} else
-			{
-				data = (char*) mlRealloc(data, dataLen+strlen(key)+1);
-			}
-			strcpy(data+dataLen, key);
-
-			// Keep a running count of data len; 
-			dataLen += strlen(key) + 1;
+			const char* key = (const char*) iter.getKey();
+			if (!key) continue;
+			reply->addParam(key);
 
 			// If we only want first item, pass that back
 			if (!findAll) break;
@@ -1568,16 +1972,78 @@ MlePlayer::recvFind(MleDwpType /*t*/, const char* name, int findAll)
     }
 
     // Send back data.
-    if (data)
+    if (reply->getDataLength() > 0) reply->addParam("");
+    m_wire->sendMsg(reply);
+    delete reply;
+}
+
+void
+MlePlayer::recvFindPage(const char* name, int token)
+{
+    // XXX - Currently, we can only find actors.
+    AtkWireMsg* reply = AtkPageReplyMsg::create(m_objID, 0, 0);
+    MleDwpStrKeyDict* actorInstances = MleActor::getInstanceRegistry();
+    int status;
+    if (name && *name)
 	{
-		data = (char*) mlRealloc(data, ++dataLen);
-		data[dataLen-1] = 0;
-		m_wire->sendMsg(m_objID, REPLY_MSG_NAME, data, dataLen);
+		// Actor names are unique, so only the one can match.
+		int count = 0;
+		status = 0;
+		if (actorInstances->find(name))
+		{
+			if (mlePageAdd(reply, name)) count++;
+			else status = -1;
+		}
+		mlePageEnd(reply, 0, count);
     } else
 	{
+		status = fillPage(m_findCursor, actorInstances, 0, token, reply);
+    }
+    if (status < 0)
+	{
+		delete reply;
 		m_wire->sendMsg(m_objID, REPLY_MSG_NAME);
+		printf("PLAYER ERROR: could not find page %d\n", token);
+		return;
     }
-    return;
+
+    if (m_wire->sendMsg(reply) < 0)
+		printf("PLAYER ERROR: sending find page %d\n", token);
+    delete reply;
+}
+
+int
+MlePlayer::fillPage(MlePageCursor* cursor, MleDwpStrKeyDict* registry,
+	int setNames, int token, AtkWireMsg* reply)
+{
+    if (token != cursor->m_token) return(-1);
+    if (token == 0) cursor->start(registry, setNames);
+    else if (!cursor->isValid())
+	{
+		// The entry the page starts with is gone; start over.
+		cursor->clear();
+		return(-1);
+    }
+
+    int count = cursor->fill(reply);
+    if (count < 0)
+	{
+		cursor->clear();
+		return(-1);
+    }
+
+    int next = 0;
+    if (cursor->isDone())
+	{
+		cursor->clear();
+    } else
+	{
+		// Only the newest token is good, so a stale one is caught.
+		if (++m_lastPageToken <= 0) m_lastPageToken = 1;
+		next = cursor->m_token = m_lastPageToken;
+    }
+    mlePageEnd(reply, next, count);
+    return(count);
 }
 
 /*****************************************************************************
@@ -2147,6 +2613,36 @@ MlePlayer::recvEndStats()
     m_sendStats = 0;
 }
 
+/*****************************************************************************
+* Message stats
+*****************************************************************************/
+void
+MlePlayer::recvStartMsgStats()
+{
+    m_wire->getStats()->reset();
+    m_wire->setStatsEnabled(1);
+}
+
+void
+MlePlayer::recvEndMsgStats()
+{
+    m_wire->setStatsEnabled(0);
+}
+
+int
+MlePlayer::recvGetMsgStats()
+{
+    // Reply with the counters as they stand, whether or not they are
+    // still being collected.
+    AtkWireMsg* retMsg = new AtkWireMsg(m_objID, REPLY_MSG_NAME);
+    m_wire->getStats()->addParams(retMsg);
+
+    int ret = m_wire->sendMsg(retMsg);
+    if (ret < 0) printf("PLAYER ERROR: sending msg stats\n");
+    delete retMsg;
+    return(ret);
+}
+
 /*****************************************************************************
 * Stage input mode
 *****************************************************************************/
@@ -2311,8 +2807,7 @@ MlePlayer::recvGetCameraPosition(char* setName)
     MlTransform t;
 	// Mle3dCameraDelegate::getTransform(set, &t);
     set->getCameraTransform(&t);
-    AtkWireMsg* m = new AtkWireMsg(m_objID, REPLY_MSG_NAME);
-    m->addParam(t);
+    AtkWireMsg* m = AtkTransformReplyMsg::create(m_objID, t);
 
     m_wire->sendMsg(m);
     delete m;
@@ -2857,33 +3352,46 @@ void
 MlePlayer::recvGetSets(int /*x*/, int /*y*/)
 {
     MleDwpStrKeyDict * setRegistry;
-    MleDwpDictIter * iterator;
     MleSet * set;
-    char ** setNames;
-    unsigned int	i;
+
+    // The names are laid out as addParam(const char**) lays them out,
+    // ending with an empty one, but are added as they are found.
+    AtkWireMsg* msg = new AtkWireMsg(m_objID, REPLY_MSG_NAME);
 
     // Iterate set registry searching for hits on sets.
     setRegistry = MleSet::getInstanceRegistry();
-    setNames = new char*[100 /*setRegistry->getLength()*/];
-    iterator = new MleDwpDictIter(*setRegistry);
-    for (i = 0; iterator->getKey() != NULL; iterator->next(), i++)
+    for (MleDwpDictIter iter(*setRegistry); iter.getKey() != NULL; iter.next())
 	{
-        set = ((MleSet *) iterator->getValue());
+        set = ((MleSet *) iter.getValue());
 		MLE_ASSERT(set != NULL);
 
 		// XXX - should compare X-Y location to set dimensions, but
 		// XXX - coordinate system for set dimensions not yet defined
 		// XXX - just return all sets for now
-		setNames[i] = set->getName();
+		const char* name = set->getName();
+		if (name && *name) msg->addParam(name);
     }
-    setNames[i] = (char *)""; // Terminator needed?
-    delete iterator;
+    msg->addParam("");
 
-    AtkWireMsg* msg = new AtkWireMsg(m_objID, REPLY_MSG_NAME);
-    msg->addParam((const char**)setNames);
     m_wire->sendMsg(msg);
     delete msg;
-    delete setNames;
+}
+
+void
+MlePlayer::recvGetSetsPage(int /*x*/, int /*y*/, int token)
+{
+    // XXX - just return all sets for now, as recvGetSets() does.
+    AtkWireMsg* reply = AtkPageReplyMsg::create(m_objID, 0, 0);
+    if (fillPage(m_setsCursor, MleSet::getInstanceRegistry(), 1, token, reply) < 0)
+	{
+		delete reply;
+		m_wire->sendMsg(m_objID, REPLY_MSG_NAME);
+		printf("PLAYER ERROR: could not get sets page %d\n", token);
+		return;
+    }
+
+    m_wire->sendMsg(reply);
+    delete reply;
 }
 
 /*****************************************************************************
@@ -3235,9 +3743,7 @@ MlePlayer::sendPick(char* setName, char* actorName)
 		printf("PLAYER sendPick()\n");
 	);
 
-    AtkWireMsg* msg = new AtkWireMsg(m_objID, "Pick");
-    msg->addParam(setName ? setName: "");
-    msg->addParam(actorName);
+    AtkWireMsg* msg = AtkPickMsg::create(m_objID, setName, actorName);
 
     if (m_wire->sendMsg(msg) < 0)
 	{
@@ -3256,9 +3762,7 @@ MlePlayer::sendPick(char* setName, char* actorName)
 int
 MlePlayer::sendUnpick(char* setName, char* actorName)
 {
-    AtkWireMsg* msg = new AtkWireMsg(m_objID, "Unpick");
-    msg->addParam(setName ? setName: "");
-    msg->addParam(actorName);
+    AtkWireMsg* msg = AtkUnpickMsg::create(m_objID, setName, actorName);
 
     if (m_wire->sendMsg(msg) < 0)
 	{
@@ -3280,7 +3784,8 @@ MlePlayer::sendUnpick(char* setName, char* actorName)
 int MlePlayer::sendManip(char *manipTypeStr, char* actorName, 
 	MlTransform *t, int is3d)
 {
-    AtkWireMsg* msg = new AtkWireMsg(m_objID, manipTypeStr);
+    AtkWireMsg* msg = m_notifyMsg;
+    msg->reset(m_objID, manipTypeStr);
     msg->addParam(actorName);
     msg->addParam(*t);
     msg->addParam(is3d);
@@ -3290,14 +3795,19 @@ int MlePlayer::sendManip(char *manipTypeStr, char* actorName,
 
 	//msg->print("MlePlayer::sendManip()");
 
-    if (m_wire->sendMsg(msg) < 0) 
+    // Only the latest transform of a manip in progress matters, so one
+    // the tools haven't taken yet is replaced rather than queued behind.
+    int status;
+    if (actorName && !strcmp(manipTypeStr, "Manip"))
+		status = m_wire->sendCoalescedMsg(msg, actorName);
+    else
+		status = m_wire->sendMsg(msg);
+    if (status < 0) 
     {
 		fprintf(stderr, "PLAYER ERROR: sending %s actor:%s\n",
 			manipTypeStr, actorName);
-		delete msg;
 		return(-1);
     }
-    delete msg;
     return(0);
 }
 
@@ -3319,20 +3829,19 @@ MlePlayer::sendPropertyChange(MleActor* actor, char* propName)
 		if (am)
 		{
 			// Send back message.
-			AtkWireMsg* msg = new AtkWireMsg(m_objID, "PropertyChange");
-			msg->addParam(actor->getName());
-			msg->addParam(propName);
 			// XXX - we are assuming no string properties.
 			//msg->addParam(((char*) actor) + am->getOffset(), am->getType()->getSize());
 			MlePropertyEntry *entry = am->getEntry();
 			char *value;
 			entry->getProperty(actor, entry->name, (unsigned char **)&value);
-			msg->addParam(value, am->getType()->getSize());
+			AtkMsgBlob blob = { value, (int) am->getType()->getSize() };
 
-			m_wire->sendMsg(msg);
+			AtkWireMsg* msg = m_notifyMsg;
+			AtkPropertyChangeMsg::reset(msg, m_objID, actor->getName(), propName, blob);
 
-			delete msg;
-			return(0);;
+			// Likewise, only the latest value of the property matters.
+			m_wire->sendCoalescedMsg(msg, actor->getName(), propName);
+			return(0);
 		}
     }
     return(-1);
@@ -3348,9 +3857,7 @@ MlePlayer::sendDoubleClick(MleActor* actor, int keymask)
     if (!actor) return(-1);
 
     // Send message.
-    AtkWireMsg* msg = new AtkWireMsg(m_objID, "DoubleClick");
-    msg->addParam(actor->getName());
-    msg->addParam(keymask);
+    AtkWireMsg* msg = AtkDoubleClickMsg::create(m_objID, actor->getName(), keymask);
 
     if (m_wire->sendMsg(msg) < 0)
 	{
@@ -3397,6 +3904,61 @@ MlePlayer::sendGetWorkprintSet(const char* setName)
     return((MleDwpSet*) item);
 }
 
+/*****************************************************************************
+* Getting several workprint items at once
+*****************************************************************************/
+
+int
+MlePlayer::sendGetWorkprintItems(const char* msgName, const char** ids,
+	int numIDs, MleDwpItem** items)
+{
+    if (!msgName || !ids || !items || numIDs <= 0) return(0);
+
+    // Send every request before waiting on any, so that the tools answer
+    // them back to back instead of one round trip at a time.
+    unsigned int* requests = (unsigned int*) mlMalloc(numIDs * sizeof(unsigned int));
+    for (int i = 0; i < numIDs; i++)
+	{
+		items[i] = NULL;
+		requests[i] = 0;
+		if (!ids[i]) continue;
+
+		requests[i] = m_wire->sendRequest(m_objID, msgName, (void*) ids[i],
+			strlen(ids[i])+1);
+		if (!requests[i])
+			printf("PLAYER ERROR: could not request workprint item %s\n", ids[i]);
+    }
+
+    // Read each item as its reply arrives.
+    int count = 0;
+    for (int i = 0; i < numIDs; i++)
+	{
+		if (!requests[i]) continue;
+
+		AtkWireMsg* msg = m_wire->waitForReply(this, requests[i]);
+		if (!msg || !msg->m_msgData)
+		{
+			printf("PLAYER ERROR: could not get workprint item %s\n", ids[i]);
+			if (msg) delete msg;
+			continue;
+		}
+
+		MleDwpInput* in = new MleDwpInput;
+		in->setBuffer((char*) msg->m_msgData);
+		items[i] = MleDwpItem::readAll(in);
+		if (items[i])
+			count++;
+		else
+			printf("PLAYER: null item in sendGetWorkprintItems - name: %s\n", ids[i]);
+
+		delete in;
+		delete msg;
+    }
+
+    mlFree(requests);
+    return(count);
+}
+
 /*****************************************************************************
 * Stats
 *****************************************************************************/
@@ -3834,6 +4396,11 @@ MlePlayer::createLoadGroupRetMsg(AtkWireMsg* msg, MleDwpGroup* wpGroup, MleGroup
     actorFinder.find(wpGroup);
     MleDwpActor** actors = (MleDwpActor**) actorFinder.getItems();
 
+    // Room for the error count and a typical name per failed actor, so
+    // the reply isn't regrown for every name.
+    msg->reserveMsgData(msg->getDataLength() + sizeof(int) +
+		(actorFinder.getNumItems() - group->getSize()) * MAX_MSG_NAME_LEN);
+
     // Set up number of errors as first param
     msg->addParam(actorFinder.getNumItems() - group->getSize());
 	//printf("CLDGRM:  Num Errors: %d\n", actorFinder.getNumItems() - group->getSize());
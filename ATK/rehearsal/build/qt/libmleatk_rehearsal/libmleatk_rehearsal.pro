@@ -35,10 +35,21 @@ DEFINES += \
 
 SOURCES += \
     $$PWD/../../../../common/src/AtkBasicArray.cxx \
+    $$PWD/../../../../common/src/AtkReactor.cxx \
+    $$PWD/../../../../common/src/AtkShmWire.cxx \
     $$PWD/../../../../common/src/AtkWire.cxx \
+    $$PWD/../../../../common/src/AtkWireCompressor.cxx \
     $$PWD/../../../../common/src/AtkWired.cxx \
     $$PWD/../../../../common/src/AtkWireFunc.cxx \
     $$PWD/../../../../common/src/AtkWireMsg.cxx \
+    $$PWD/../../../../common/src/AtkWireMsgQueue.cxx \
+    $$PWD/../../../../common/src/AtkWireBatch.cxx \
+    $$PWD/../../../../common/src/AtkWireNameTable.cxx \
+    $$PWD/../../../../common/src/AtkWirePool.cxx \
+    $$PWD/../../../../common/src/AtkWireRecorder.cxx \
+    $$PWD/../../../../common/src/AtkWireReplayer.cxx \
+    $$PWD/../../../../common/src/AtkWireStats.cxx \
+    $$PWD/../../../../common/src/AtkWireWorkers.cxx \
     $$PWD/../../../../linux/src/MlePlayer.cxx
 
 
@@ -49,6 +60,18 @@ HEADERS += \
     $$PWD/../../../../common/include/mle/AtkWireFunc.h \
     $$PWD/../../../../common/include/mle/AtkWire.h \
     $$PWD/../../../../common/include/mle/AtkBasicArray.h \
+    $$PWD/../../../../common/include/mle/AtkMsgSchema.h \
+    $$PWD/../../../../common/include/mle/AtkReactor.h \
+    $$PWD/../../../../common/include/mle/AtkShmWire.h \
+    $$PWD/../../../../common/include/mle/AtkWireCompressor.h \
+    $$PWD/../../../../common/include/mle/AtkWireMsgQueue.h \
+    $$PWD/../../../../common/include/mle/AtkWireBatch.h \
+    $$PWD/../../../../common/include/mle/AtkWireNameTable.h \
+    $$PWD/../../../../common/include/mle/AtkWirePool.h \
+    $$PWD/../../../../common/include/mle/AtkWireRecorder.h \
+    $$PWD/../../../../common/include/mle/AtkWireReplayer.h \
+    $$PWD/../../../../common/include/mle/AtkWireStats.h \
+    $$PWD/../../../../common/include/mle/AtkWireWorkers.h \
     $$PWD/../../../../common/include/mle/mleatk_rehearsal.h \
     $$PWD/../../../../linux/include/mle/MlePlayer.h
 